@@ -0,0 +1,160 @@
+/*
+ * Cryptographic API.
+ *
+ * Glue code for the ARMv7 assembler version of the SHA1 Secure Hash
+ * Algorithm.
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the Free
+ * Software Foundation; either version 2 of the License, or (at your option)
+ * any later version.
+ *
+ */
+#include <crypto/internal/hash.h>
+#include <linux/init.h>
+#include <linux/module.h>
+#include <linux/types.h>
+#include <crypto/sha.h>
+#include <asm/byteorder.h>
+
+asmlinkage void sha1_arm_block(u32 *state, const u8 *data,
+			       unsigned int blocks);
+
+static int sha1_init(struct shash_desc *desc)
+{
+	struct sha1_state *sctx = shash_desc_ctx(desc);
+
+	*sctx = (struct sha1_state){
+		.state = { SHA1_H0, SHA1_H1, SHA1_H2, SHA1_H3, SHA1_H4 },
+	};
+
+	return 0;
+}
+
+/*
+ * The assembler loads whole words, so it is only given word aligned
+ * data.  The API hands us that (cra_alignmask), and whole blocks are fed
+ * straight from the caller's buffer, but finishing a partial block can
+ * leave the rest unaligned: then each block is copied to sctx->buffer.
+ */
+static int sha1_update(struct shash_desc *desc, const u8 *data,
+			unsigned int len)
+{
+	struct sha1_state *sctx = shash_desc_ctx(desc);
+	unsigned int partial = sctx->count % SHA1_BLOCK_SIZE;
+	unsigned int blocks;
+
+	sctx->count += len;
+
+	if (partial) {
+		unsigned int fill = SHA1_BLOCK_SIZE - partial;
+
+		if (len < fill) {
+			memcpy(sctx->buffer + partial, data, len);
+			return 0;
+		}
+		memcpy(sctx->buffer + partial, data, fill);
+		sha1_arm_block(sctx->state, sctx->buffer, 1);
+		data += fill;
+		len -= fill;
+	}
+
+	blocks = len / SHA1_BLOCK_SIZE;
+	if (blocks && IS_ALIGNED((unsigned long)data, 4)) {
+		sha1_arm_block(sctx->state, data, blocks);
+		data += blocks * SHA1_BLOCK_SIZE;
+		len -= blocks * SHA1_BLOCK_SIZE;
+	}
+	while (len >= SHA1_BLOCK_SIZE) {
+		memcpy(sctx->buffer, data, SHA1_BLOCK_SIZE);
+		sha1_arm_block(sctx->state, sctx->buffer, 1);
+		data += SHA1_BLOCK_SIZE;
+		len -= SHA1_BLOCK_SIZE;
+	}
+	memcpy(sctx->buffer, data, len);
+
+	return 0;
+}
+
+/* Add padding and return the message digest. */
+static int sha1_final(struct shash_desc *desc, u8 *out)
+{
+	struct sha1_state *sctx = shash_desc_ctx(desc);
+	unsigned int partial = sctx->count % SHA1_BLOCK_SIZE;
+	__be32 *bits = (__be32 *)(sctx->buffer + SHA1_BLOCK_SIZE - 8);
+	__be32 *dst = (__be32 *)out;
+	int i;
+
+	sctx->buffer[partial++] = 0x80;
+	if (partial > SHA1_BLOCK_SIZE - 8) {
+		memset(sctx->buffer + partial, 0, SHA1_BLOCK_SIZE - partial);
+		sha1_arm_block(sctx->state, sctx->buffer, 1);
+		partial = 0;
+	}
+	memset(sctx->buffer + partial, 0, SHA1_BLOCK_SIZE - 8 - partial);
+	bits[0] = cpu_to_be32(sctx->count >> 29);
+	bits[1] = cpu_to_be32(sctx->count << 3);
+	sha1_arm_block(sctx->state, sctx->buffer, 1);
+
+	for (i = 0; i < SHA1_DIGEST_SIZE / 4; i++)
+		dst[i] = cpu_to_be32(sctx->state[i]);
+
+	/* Wipe context */
+	memset(sctx, 0, sizeof(*sctx));
+
+	return 0;
+}
+
+static int sha1_export(struct shash_desc *desc, void *out)
+{
+	struct sha1_state *sctx = shash_desc_ctx(desc);
+
+	memcpy(out, sctx, sizeof(*sctx));
+	return 0;
+}
+
+static int sha1_import(struct shash_desc *desc, const void *in)
+{
+	struct sha1_state *sctx = shash_desc_ctx(desc);
+
+	memcpy(sctx, in, sizeof(*sctx));
+	return 0;
+}
+
+static struct shash_alg alg = {
+	.digestsize	=	SHA1_DIGEST_SIZE,
+	.init		=	sha1_init,
+	.update		=	sha1_update,
+	.final		=	sha1_final,
+	.export		=	sha1_export,
+	.import		=	sha1_import,
+	.descsize	=	sizeof(struct sha1_state),
+	.statesize	=	sizeof(struct sha1_state),
+	.base		=	{
+		.cra_name	=	"sha1",
+		.cra_driver_name=	"sha1-asm",
+		.cra_priority	=	150,
+		.cra_flags	=	CRYPTO_ALG_TYPE_SHASH,
+		.cra_blocksize	=	SHA1_BLOCK_SIZE,
+		.cra_alignmask	=	3,
+		.cra_module	=	THIS_MODULE,
+	}
+};
+
+static int __init sha1_arm_mod_init(void)
+{
+	return crypto_register_shash(&alg);
+}
+
+static void __exit sha1_arm_mod_fini(void)
+{
+	crypto_unregister_shash(&alg);
+}
+
+module_init(sha1_arm_mod_init);
+module_exit(sha1_arm_mod_fini);
+
+MODULE_LICENSE("GPL");
+MODULE_DESCRIPTION("SHA1 Secure Hash Algorithm, ARMv7 asm");
+
+MODULE_ALIAS("sha1");
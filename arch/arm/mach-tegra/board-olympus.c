@@ -385,6 +385,9 @@ static void __init tegra_olympus_init(void)
 	olympus_clks_init();
 
 	//tegra_ram_console_debug_init();
+#ifdef CONFIG_TRACEDUMP_RAM
+	tegra_tracedump_ram_init();
+#endif
 
 	olympus_pinmux_init();
 
@@ -534,6 +537,9 @@ void __init tegra_olympus_reserve(void)
 	tegra_reserve(SZ_128M + SZ_64M, SZ_8M + SZ_1M, SZ_1M);
 	//tegra_reserve(SZ_256M, SZ_16M, SZ_16M);
 	//tegra_ram_console_debug_reserve(SZ_1M);
+#ifdef CONFIG_TRACEDUMP_RAM
+	tegra_tracedump_ram_reserve(SZ_1M);
+#endif
 
 }
 
@@ -999,6 +999,51 @@ void __init tegra_ram_console_debug_init(void)
 	}
 }
 
+static struct resource tracedump_ram_resources[] = {
+	{
+		.flags = IORESOURCE_MEM,
+	},
+};
+
+static struct platform_device tracedump_ram_device = {
+	.name		= "tracedump_ram",
+	.id		= -1,
+	.num_resources	= ARRAY_SIZE(tracedump_ram_resources),
+	.resource	= tracedump_ram_resources,
+};
+
+void __init tegra_tracedump_ram_reserve(unsigned long size)
+{
+	struct resource *res;
+
+	res = platform_get_resource(&tracedump_ram_device, IORESOURCE_MEM, 0);
+	if (!res)
+		goto fail;
+	res->start = memblock_end_of_DRAM() - size;
+	res->end = res->start + size - 1;
+	if (memblock_remove(res->start, size))
+		goto fail;
+
+	return;
+
+fail:
+	tracedump_ram_device.resource = NULL;
+	tracedump_ram_device.num_resources = 0;
+	pr_err("Failed to reserve memory block for tracedump\n");
+}
+
+void __init tegra_tracedump_ram_init(void)
+{
+	int err;
+
+	if (!tracedump_ram_device.num_resources)
+		return;
+	err = platform_device_register(&tracedump_ram_device);
+	if (err)
+		pr_err("%s: tracedump registration failed (%d)!\n",
+		       __func__, err);
+}
+
 void __init tegra_release_bootloader_fb(void)
 {
 	/* Since bootloader fb is reserved in common.c, it is freed here. */
@@ -33,6 +33,8 @@
 #include <linux/jiffies.h>
 #include <linux/timex.h>
 #include <linux/interrupt.h>
+#include <linux/atomic.h>
+#include <linux/slab.h>
 #include "tcrypt.h"
 #include "internal.h"
 
@@ -64,7 +66,7 @@ static char *check[] = {
 	"cast6", "arc4", "michael_mic", "deflate", "crc32c", "tea", "xtea",
 	"khazad", "wp512", "wp384", "wp256", "tnepres", "xeta",  "fcrypt",
 	"camellia", "seed", "salsa20", "rmd128", "rmd160", "rmd256", "rmd320",
-	"lzo", "cts", "zlib", NULL
+	"lzo", "cts", "zlib", "lz4", NULL
 };
 
 static int test_cipher_jiffies(struct blkcipher_desc *desc, int enc,
@@ -719,6 +721,197 @@ out:
 	crypto_free_ahash(tfm);
 }
 
+/*
+ * Multi-request cipher throughput: keep num_req sector sized requests
+ * in flight at a time, the way dm-crypt does, so that asynchronous
+ * implementations such as pcrypt get the chance to work on several of
+ * them at once.  Always timed with jiffies.
+ */
+struct tcrypt_mb_result {
+	struct completion completion;
+	atomic_t pending;
+	int err;
+};
+
+struct tcrypt_mb_request {
+	struct ablkcipher_request *req;
+	struct scatterlist sg;
+	char *buf;
+	char iv[32];
+};
+
+static u32 mb_block_sizes[] = { 512, 4096, 0 };
+
+static void tcrypt_mb_complete(struct crypto_async_request *req, int err)
+{
+	struct tcrypt_mb_result *res = req->data;
+
+	if (err == -EINPROGRESS)
+		return;
+
+	if (err)
+		res->err = err;
+	if (atomic_dec_and_test(&res->pending))
+		complete(&res->completion);
+}
+
+static int test_acipher_mb_batch(struct tcrypt_mb_request *mb,
+				 unsigned int num_req, int enc,
+				 struct tcrypt_mb_result *res)
+{
+	unsigned int i;
+	int ret;
+
+	INIT_COMPLETION(res->completion);
+	atomic_set(&res->pending, num_req);
+	res->err = 0;
+
+	for (i = 0; i < num_req; i++) {
+		if (enc)
+			ret = crypto_ablkcipher_encrypt(mb[i].req);
+		else
+			ret = crypto_ablkcipher_decrypt(mb[i].req);
+
+		/* -EBUSY: backlogged, the callback still follows */
+		if (ret == -EINPROGRESS || ret == -EBUSY)
+			continue;
+
+		if (ret)
+			res->err = ret;
+		if (atomic_dec_and_test(&res->pending))
+			complete(&res->completion);
+	}
+
+	/* not interruptible, the requests reference our buffers */
+	wait_for_completion(&res->completion);
+
+	return res->err;
+}
+
+static void test_acipher_mb_speed(const char *algo, u32 mask, int enc,
+				  unsigned int sec, u8 *keysize,
+				  unsigned int num_req)
+{
+	struct tcrypt_mb_request *mb;
+	struct tcrypt_mb_result res;
+	struct crypto_ablkcipher *tfm;
+	unsigned long start, end;
+	unsigned int i, j, iv_len;
+	int bcount, ret;
+	const char *e;
+	u32 *b_size;
+
+	if (enc == ENCRYPT)
+		e = "encryption";
+	else
+		e = "decryption";
+
+	if (!sec)
+		sec = 1;
+
+	printk(KERN_INFO "\ntesting speed of %s %s, %u requests in flight\n",
+	       algo, e, num_req);
+
+	tfm = crypto_alloc_ablkcipher(algo, 0, mask);
+	if (IS_ERR(tfm)) {
+		pr_err("failed to load transform for %s: %ld\n", algo,
+		       PTR_ERR(tfm));
+		return;
+	}
+
+	mb = kcalloc(num_req, sizeof(*mb), GFP_KERNEL);
+	if (!mb)
+		goto out_free_tfm;
+
+	iv_len = crypto_ablkcipher_ivsize(tfm);
+	if (iv_len > sizeof(mb->iv)) {
+		pr_err("ivsize(%u) > iv buffer(%zu)\n", iv_len, sizeof(mb->iv));
+		goto out_free_mb;
+	}
+
+	init_completion(&res.completion);
+
+	for (j = 0; j < num_req; j++) {
+		mb[j].buf = kmalloc(PAGE_SIZE, GFP_KERNEL);
+		mb[j].req = ablkcipher_request_alloc(tfm, GFP_KERNEL);
+		if (!mb[j].buf || !mb[j].req) {
+			pr_err("multi-request buffer allocation failure\n");
+			goto out_free_reqs;
+		}
+		memset(mb[j].buf, 0xff, PAGE_SIZE);
+		ablkcipher_request_set_callback(mb[j].req,
+						CRYPTO_TFM_REQ_MAY_BACKLOG,
+						tcrypt_mb_complete, &res);
+	}
+
+	memset(tvmem[0], 0xff, PAGE_SIZE);
+
+	i = 0;
+	do {
+		b_size = mb_block_sizes;
+		do {
+			if (*b_size > PAGE_SIZE) {
+				pr_err("template (%u) too big for "
+				       "buffer (%lu)\n", *b_size, PAGE_SIZE);
+				goto out_free_reqs;
+			}
+
+			printk(KERN_INFO "test %u (%d bit key, %d byte "
+			       "blocks): ", i, *keysize * 8, *b_size);
+
+			crypto_ablkcipher_clear_flags(tfm, ~0);
+			ret = crypto_ablkcipher_setkey(tfm, tvmem[0], *keysize);
+			if (ret) {
+				pr_err("setkey() failed flags=%x\n",
+				       crypto_ablkcipher_get_flags(tfm));
+				goto out_free_reqs;
+			}
+
+			for (j = 0; j < num_req; j++) {
+				memset(mb[j].iv, 0xff, iv_len);
+				sg_init_one(&mb[j].sg, mb[j].buf, *b_size);
+				ablkcipher_request_set_crypt(mb[j].req,
+							     &mb[j].sg,
+							     &mb[j].sg,
+							     *b_size,
+							     mb[j].iv);
+			}
+
+			ret = 0;
+			for (start = jiffies, end = start + sec * HZ,
+			     bcount = 0; time_before(jiffies, end);
+			     bcount += num_req) {
+				ret = test_acipher_mb_batch(mb, num_req, enc,
+							    &res);
+				if (ret)
+					break;
+			}
+
+			if (ret) {
+				pr_err("%s() failed ret=%d\n", e, ret);
+				goto out_free_reqs;
+			}
+
+			printk("%d operations in %d seconds (%ld bytes)\n",
+			       bcount, sec, (long)bcount * *b_size);
+
+			b_size++;
+			i++;
+		} while (*b_size);
+		keysize++;
+	} while (*keysize);
+
+out_free_reqs:
+	for (j = 0; j < num_req; j++) {
+		ablkcipher_request_free(mb[j].req);
+		kfree(mb[j].buf);
+	}
+out_free_mb:
+	kfree(mb);
+out_free_tfm:
+	crypto_free_ablkcipher(tfm);
+}
+
 static void test_available(void)
 {
 	char **name = check;
@@ -948,6 +1141,10 @@ static int do_test(int m)
 		ret += tcrypt_test("ofb(aes)");
 		break;
 
+	case 47:
+		ret += tcrypt_test("lz4");
+		break;
+
 	case 100:
 		ret += tcrypt_test("hmac(md5)");
 		break;
@@ -1087,6 +1284,22 @@ static int do_test(int m)
 				  speed_template_16_32);
 		break;
 
+	case 207:
+		/* aes-generic against the arch assembler driver */
+		test_cipher_speed("ecb(aes-generic)", ENCRYPT, sec, NULL, 0,
+				speed_template_16_24_32);
+		test_cipher_speed("ecb(aes-asm)", ENCRYPT, sec, NULL, 0,
+				speed_template_16_24_32);
+		test_cipher_speed("cbc(aes-generic)", ENCRYPT, sec, NULL, 0,
+				speed_template_16_24_32);
+		test_cipher_speed("cbc(aes-asm)", ENCRYPT, sec, NULL, 0,
+				speed_template_16_24_32);
+		test_cipher_speed("cbc(aes-generic)", DECRYPT, sec, NULL, 0,
+				speed_template_16_24_32);
+		test_cipher_speed("cbc(aes-asm)", DECRYPT, sec, NULL, 0,
+				speed_template_16_24_32);
+		break;
+
 	case 300:
 		/* fall through */
 
@@ -1162,6 +1375,18 @@ static int do_test(int m)
 		test_hash_speed("ghash-generic", sec, hash_speed_template_16);
 		if (mode > 300 && mode < 400) break;
 
+	case 319:
+		test_hash_speed("sha1-generic", sec,
+				generic_hash_speed_template);
+		test_hash_speed("sha1-asm", sec, generic_hash_speed_template);
+		if (mode > 300 && mode < 400) break;
+
+	case 320:
+		test_hash_speed("sha256-generic", sec,
+				generic_hash_speed_template);
+		test_hash_speed("sha256-asm", sec, generic_hash_speed_template);
+		if (mode > 300 && mode < 400) break;
+
 	case 399:
 		break;
 
@@ -1239,6 +1464,26 @@ static int do_test(int m)
 	case 499:
 		break;
 
+	case 500:
+		/* fall through */
+
+	case 501:
+		test_acipher_mb_speed("cbc(aes)", CRYPTO_ALG_ASYNC, ENCRYPT,
+				      sec, speed_template_16_32, 64);
+		test_acipher_mb_speed("cbc(aes)", CRYPTO_ALG_ASYNC, DECRYPT,
+				      sec, speed_template_16_32, 64);
+		if (mode > 500 && mode < 600) break;
+
+	case 502:
+		test_acipher_mb_speed("pcrypt(cbc(aes))", 0, ENCRYPT,
+				      sec, speed_template_16_32, 64);
+		test_acipher_mb_speed("pcrypt(cbc(aes))", 0, DECRYPT,
+				      sec, speed_template_16_32, 64);
+		if (mode > 500 && mode < 600) break;
+
+	case 599:
+		break;
+
 	case 1000:
 		test_available();
 		break;
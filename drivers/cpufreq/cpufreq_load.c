@@ -0,0 +1,281 @@
+/*
+ * drivers/cpufreq/cpufreq_load.c
+ *
+ * Shared load-tracking core for sampling cpufreq governors: per-cpu
+ * deferrable sampling timers, idle/iowait accounting, a ring buffer of
+ * recent load samples per cpu, and the speed-change plumbing.  Governors
+ * built on it only decide which frequency each cpu wants.
+ *
+ * This software is licensed under the terms of the GNU General Public
+ * License version 2, as published by the Free Software Foundation, and
+ * may be copied, distributed, and modified under those terms.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ */
+
+#include <linux/kernel.h>
+#include <linux/module.h>
+#include <linux/cpufreq.h>
+#include <linux/jiffies.h>
+#include <linux/kernel_stat.h>
+#include <linux/percpu.h>
+#include <linux/tick.h>
+
+#include "cpufreq_load.h"
+
+static inline cputime64_t get_cpu_idle_time_jiffy(unsigned int cpu,
+						  cputime64_t *wall)
+{
+	cputime64_t idle_time;
+	cputime64_t cur_wall_time;
+	cputime64_t busy_time;
+
+	cur_wall_time = jiffies64_to_cputime64(get_jiffies_64());
+	busy_time = cputime64_add(kstat_cpu(cpu).cpustat.user,
+			kstat_cpu(cpu).cpustat.system);
+
+	busy_time = cputime64_add(busy_time, kstat_cpu(cpu).cpustat.irq);
+	busy_time = cputime64_add(busy_time, kstat_cpu(cpu).cpustat.softirq);
+	busy_time = cputime64_add(busy_time, kstat_cpu(cpu).cpustat.steal);
+	busy_time = cputime64_add(busy_time, kstat_cpu(cpu).cpustat.nice);
+
+	idle_time = cputime64_sub(cur_wall_time, busy_time);
+	if (wall)
+		*wall = (cputime64_t)jiffies_to_usecs(cur_wall_time);
+
+	return (cputime64_t)jiffies_to_usecs(idle_time);
+}
+
+static inline cputime64_t get_cpu_idle_time(unsigned int cpu, cputime64_t *wall)
+{
+	u64 idle_time = get_cpu_idle_time_us(cpu, wall);
+
+	if (idle_time == -1ULL)
+		return get_cpu_idle_time_jiffy(cpu, wall);
+
+	return idle_time;
+}
+
+static inline cputime64_t get_cpu_iowait_time(unsigned int cpu)
+{
+	u64 iowait_time = get_cpu_iowait_time_us(cpu, NULL);
+
+	if (iowait_time == -1ULL)
+		return 0;
+
+	return iowait_time;
+}
+
+static unsigned int cpufreq_load_round(struct cpufreq_load_cpu *lc,
+				       unsigned int freq)
+{
+	struct cpufreq_policy *policy = lc->policy;
+	unsigned int index;
+
+	freq = clamp(freq, policy->min, policy->max);
+	if (!lc->freq_table ||
+	    cpufreq_frequency_table_target(policy, lc->freq_table, freq,
+					   CPUFREQ_RELATION_L, &index))
+		return freq;
+
+	return lc->freq_table[index].frequency;
+}
+
+/* Highest frequency wanted by the cpus of @policy */
+static unsigned int cpufreq_load_policy_target(struct cpufreq_load_governor *gov,
+					       struct cpufreq_policy *policy)
+{
+	unsigned int max_freq = 0;
+	unsigned int j;
+
+	for_each_cpu(j, policy->cpus) {
+		struct cpufreq_load_cpu *lc = per_cpu_ptr(gov->cpus, j);
+
+		if (lc->enabled && lc->target_freq > max_freq)
+			max_freq = lc->target_freq;
+	}
+
+	return max_freq;
+}
+
+static void cpufreq_load_timer(unsigned long data)
+{
+	struct cpufreq_load_cpu *lc = (struct cpufreq_load_cpu *)data;
+	struct cpufreq_load_governor *gov = lc->gov;
+	struct cpufreq_policy *policy = lc->policy;
+	struct cpufreq_load_sample *sample;
+	unsigned int delta_wall, delta_idle, delta_iowait;
+	unsigned int target_freq;
+	u64 now_wall, now_idle, now_iowait;
+
+	smp_rmb();
+
+	if (!lc->enabled)
+		return;
+
+	now_idle = get_cpu_idle_time(lc->cpu, &now_wall);
+	now_iowait = get_cpu_iowait_time(lc->cpu);
+
+	delta_wall = (unsigned int) cputime64_sub(now_wall, lc->prev_wall);
+	delta_idle = (unsigned int) cputime64_sub(now_idle, lc->prev_idle);
+	delta_iowait = (unsigned int) cputime64_sub(now_iowait,
+						    lc->prev_iowait);
+	lc->prev_wall = now_wall;
+	lc->prev_idle = now_idle;
+	lc->prev_iowait = now_iowait;
+
+	if (!delta_wall)
+		goto rearm;
+
+	if (gov->io_is_busy && delta_idle >= delta_iowait)
+		delta_idle -= delta_iowait;
+
+	sample = &lc->history[lc->head];
+	lc->head = (lc->head + 1) & (CPUFREQ_LOAD_HISTORY - 1);
+	if (lc->nr < CPUFREQ_LOAD_HISTORY)
+		lc->nr++;
+
+	if (delta_idle >= delta_wall)
+		sample->load = 0;
+	else
+		sample->load = 100 * (delta_wall - delta_idle) / delta_wall;
+	sample->freq = policy->cur;
+
+	lc->target_freq = cpufreq_load_round(lc, gov->get_target(lc));
+
+	target_freq = cpufreq_load_policy_target(gov, policy);
+	if (target_freq && target_freq != policy->cur)
+		queue_work(gov->wq, &per_cpu_ptr(gov->cpus, policy->cpu)->work);
+
+rearm:
+	mod_timer_pinned(&lc->timer,
+			 jiffies + usecs_to_jiffies(gov->sample_rate));
+}
+
+static void cpufreq_load_work(struct work_struct *work)
+{
+	struct cpufreq_load_cpu *lc =
+		container_of(work, struct cpufreq_load_cpu, work);
+	struct cpufreq_load_governor *gov = lc->gov;
+	unsigned int target_freq;
+
+	mutex_lock(&gov->lock);
+	smp_rmb();
+	if (lc->enabled) {
+		target_freq = cpufreq_load_policy_target(gov, lc->policy);
+		if (target_freq && target_freq != lc->policy->cur)
+			__cpufreq_driver_target(lc->policy, target_freq,
+						CPUFREQ_RELATION_L);
+	}
+	mutex_unlock(&gov->lock);
+}
+
+int cpufreq_load_start(struct cpufreq_load_governor *gov,
+		       struct cpufreq_policy *policy)
+{
+	struct cpufreq_frequency_table *freq_table;
+	unsigned int j;
+
+	if (!cpu_online(policy->cpu))
+		return -EINVAL;
+
+	freq_table = cpufreq_frequency_get_table(policy->cpu);
+
+	for_each_cpu(j, policy->cpus) {
+		struct cpufreq_load_cpu *lc = per_cpu_ptr(gov->cpus, j);
+
+		lc->gov = gov;
+		lc->policy = policy;
+		lc->freq_table = freq_table;
+		lc->cpu = j;
+		lc->prev_idle = get_cpu_idle_time(j, &lc->prev_wall);
+		lc->prev_iowait = get_cpu_iowait_time(j);
+		lc->head = 0;
+		lc->nr = 0;
+		lc->target_freq = policy->cur;
+		lc->enabled = 1;
+		smp_wmb();
+
+		lc->timer.expires = jiffies +
+				    usecs_to_jiffies(gov->sample_rate);
+		add_timer_on(&lc->timer, j);
+	}
+
+	return 0;
+}
+EXPORT_SYMBOL_GPL(cpufreq_load_start);
+
+void cpufreq_load_stop(struct cpufreq_load_governor *gov,
+		       struct cpufreq_policy *policy)
+{
+	unsigned int j;
+
+	for_each_cpu(j, policy->cpus) {
+		struct cpufreq_load_cpu *lc = per_cpu_ptr(gov->cpus, j);
+
+		lc->enabled = 0;
+		smp_wmb();
+		del_timer_sync(&lc->timer);
+	}
+
+	cancel_work_sync(&per_cpu_ptr(gov->cpus, policy->cpu)->work);
+}
+EXPORT_SYMBOL_GPL(cpufreq_load_stop);
+
+void cpufreq_load_limits(struct cpufreq_load_governor *gov,
+			 struct cpufreq_policy *policy)
+{
+	mutex_lock(&gov->lock);
+	if (policy->max < policy->cur)
+		__cpufreq_driver_target(policy, policy->max,
+					CPUFREQ_RELATION_H);
+	else if (policy->min > policy->cur)
+		__cpufreq_driver_target(policy, policy->min,
+					CPUFREQ_RELATION_L);
+	mutex_unlock(&gov->lock);
+}
+EXPORT_SYMBOL_GPL(cpufreq_load_limits);
+
+int cpufreq_load_governor_init(struct cpufreq_load_governor *gov,
+			       const char *name)
+{
+	unsigned int i;
+
+	gov->cpus = alloc_percpu(struct cpufreq_load_cpu);
+	if (!gov->cpus)
+		return -ENOMEM;
+
+	gov->wq = alloc_workqueue(name, WQ_HIGHPRI | WQ_NON_REENTRANT, 1);
+	if (!gov->wq) {
+		free_percpu(gov->cpus);
+		return -ENOMEM;
+	}
+
+	mutex_init(&gov->lock);
+
+	for_each_possible_cpu(i) {
+		struct cpufreq_load_cpu *lc = per_cpu_ptr(gov->cpus, i);
+
+		init_timer_deferrable(&lc->timer);
+		lc->timer.function = cpufreq_load_timer;
+		lc->timer.data = (unsigned long)lc;
+		INIT_WORK(&lc->work, cpufreq_load_work);
+		lc->gov = gov;
+	}
+
+	return 0;
+}
+EXPORT_SYMBOL_GPL(cpufreq_load_governor_init);
+
+void cpufreq_load_governor_exit(struct cpufreq_load_governor *gov)
+{
+	destroy_workqueue(gov->wq);
+	free_percpu(gov->cpus);
+}
+EXPORT_SYMBOL_GPL(cpufreq_load_governor_exit);
+
+MODULE_DESCRIPTION("Shared load-tracking core for cpufreq governors");
+MODULE_LICENSE("GPL");
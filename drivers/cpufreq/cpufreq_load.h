@@ -0,0 +1,81 @@
+/*
+ * drivers/cpufreq/cpufreq_load.h
+ *
+ * Shared load-tracking core for sampling cpufreq governors.
+ *
+ * This software is licensed under the terms of the GNU General Public
+ * License version 2, as published by the Free Software Foundation, and
+ * may be copied, distributed, and modified under those terms.
+ */
+
+#ifndef _CPUFREQ_LOAD_H
+#define _CPUFREQ_LOAD_H
+
+#include <linux/cpufreq.h>
+#include <linux/mutex.h>
+#include <linux/timer.h>
+#include <linux/workqueue.h>
+
+/* Number of load samples kept per cpu: must be a power of two */
+#define CPUFREQ_LOAD_HISTORY	16
+
+struct cpufreq_load_sample {
+	unsigned int load;	/* percentage of the sample spent busy */
+	unsigned int freq;	/* policy->cur during the sample, in kHz */
+};
+
+struct cpufreq_load_governor;
+
+struct cpufreq_load_cpu {
+	struct timer_list timer;
+	struct work_struct work;	/* speed change, used on policy->cpu */
+	struct cpufreq_load_governor *gov;
+	struct cpufreq_policy *policy;
+	struct cpufreq_frequency_table *freq_table;
+	unsigned int cpu;
+	u64 prev_wall;
+	u64 prev_idle;
+	u64 prev_iowait;
+	unsigned int head;		/* slot of the next sample */
+	unsigned int nr;		/* valid samples, up to HISTORY */
+	struct cpufreq_load_sample history[CPUFREQ_LOAD_HISTORY];
+	unsigned int target_freq;	/* last frequency wanted by this cpu */
+	int enabled;
+};
+
+/*
+ * A governor built on the core supplies get_target(), called from the
+ * sampling timer on each cpu just after a new sample has been recorded.
+ * It returns the frequency that cpu wants: the core rounds it to the
+ * frequency table, takes the highest wanted by the cpus of the policy,
+ * and changes speed from a workqueue.
+ */
+struct cpufreq_load_governor {
+	unsigned int (*get_target)(struct cpufreq_load_cpu *lc);
+	unsigned int sample_rate;	/* usecs between samples */
+	unsigned int io_is_busy;	/* count iowait as busy time */
+
+	struct cpufreq_load_cpu __percpu *cpus;
+	struct workqueue_struct *wq;
+	struct mutex lock;		/* serializes speed changes */
+};
+
+int cpufreq_load_governor_init(struct cpufreq_load_governor *gov,
+			       const char *name);
+void cpufreq_load_governor_exit(struct cpufreq_load_governor *gov);
+
+int cpufreq_load_start(struct cpufreq_load_governor *gov,
+		       struct cpufreq_policy *policy);
+void cpufreq_load_stop(struct cpufreq_load_governor *gov,
+		       struct cpufreq_policy *policy);
+void cpufreq_load_limits(struct cpufreq_load_governor *gov,
+			 struct cpufreq_policy *policy);
+
+/* Return the sample @age periods old: 0 is the latest, up to lc->nr - 1 */
+static inline const struct cpufreq_load_sample *
+cpufreq_load_history(const struct cpufreq_load_cpu *lc, unsigned int age)
+{
+	return &lc->history[(lc->head - 1 - age) & (CPUFREQ_LOAD_HISTORY - 1)];
+}
+
+#endif /* _CPUFREQ_LOAD_H */
@@ -0,0 +1,293 @@
+/*
+ * drivers/cpufreq/cpufreq_predictive.c
+ *
+ * 'predictive' - a cpufreq governor which picks the frequency from a
+ * short-horizon forecast of recent cpu demand, built on the shared
+ * load-tracking core in cpufreq_load.c.
+ *
+ * This software is licensed under the terms of the GNU General Public
+ * License version 2, as published by the Free Software Foundation, and
+ * may be copied, distributed, and modified under those terms.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ */
+
+#include <linux/kernel.h>
+#include <linux/module.h>
+#include <linux/cpufreq.h>
+#include <linux/math64.h>
+#include <linux/mutex.h>
+
+#include "cpufreq_load.h"
+
+/* Jump to max speed when the latest sample is at or above this load. */
+#define DEFAULT_UP_THRESHOLD 95
+static unsigned long up_threshold;
+
+/* Load the forecast demand should put on the chosen frequency. */
+#define DEFAULT_TARGET_LOAD 80
+static unsigned long target_load;
+
+/* Number of samples the forecast is fitted to. */
+#define DEFAULT_HISTORY 8
+static unsigned long history;
+
+/* How many sample periods ahead to forecast. */
+#define DEFAULT_HORIZON 2
+static unsigned long horizon;
+
+#define DEFAULT_SAMPLE_RATE 20000
+
+static DEFINE_MUTEX(predictive_mutex);
+static unsigned int predictive_enable;
+
+static struct cpufreq_load_governor predictive_gov;
+
+static int cpufreq_governor_predictive(struct cpufreq_policy *policy,
+		unsigned int event);
+
+#ifndef CONFIG_CPU_FREQ_DEFAULT_GOV_PREDICTIVE
+static
+#endif
+struct cpufreq_governor cpufreq_gov_predictive = {
+	.name = "predictive",
+	.governor = cpufreq_governor_predictive,
+	.max_transition_latency = 10000000,
+	.owner = THIS_MODULE,
+};
+
+/*
+ * Demand is the busy fraction of a sample times the frequency it ran at,
+ * so samples taken at different speeds are comparable.  Fit a least
+ * squares line through the demand of the last n samples, x = 0 being the
+ * oldest, and extrapolate it horizon periods past the latest:
+ *
+ *   pred = (sum_d * denom + slope_num * (n * x_pred - sum_x)) / (n * denom)
+ *
+ * with denom = n * sum_xx - sum_x^2 and slope_num = n * sum_xd - sum_x * sum_d.
+ */
+static unsigned int predictive_get_target(struct cpufreq_load_cpu *lc)
+{
+	struct cpufreq_policy *policy = lc->policy;
+	const struct cpufreq_load_sample *sample;
+	unsigned int n = min_t(unsigned int, lc->nr, history);
+	s64 sum_x, sum_xx, sum_d = 0, sum_xd = 0;
+	s64 denom, slope_num, pred;
+	unsigned int i;
+
+	sample = cpufreq_load_history(lc, 0);
+	if (sample->load >= up_threshold)
+		return policy->max;
+
+	for (i = 0; i < n; i++) {
+		s64 demand;
+
+		sample = cpufreq_load_history(lc, n - 1 - i);
+		demand = div_s64((s64)sample->load * sample->freq, 100);
+		sum_d += demand;
+		sum_xd += demand * i;
+	}
+
+	if (n < 2) {
+		pred = sum_d;
+	} else {
+		sum_x = n * (n - 1) / 2;
+		sum_xx = (n - 1) * n * (2 * n - 1) / 6;
+		denom = n * sum_xx - sum_x * sum_x;
+		slope_num = n * sum_xd - sum_x * sum_d;
+		pred = div64_s64(sum_d * denom +
+				 slope_num * (n * (n - 1 + horizon) - sum_x),
+				 n * denom);
+	}
+
+	if (pred <= 0)
+		return policy->min;
+
+	return min_t(s64, div64_s64(pred * 100, target_load), policy->max);
+}
+
+#define show_one(file_name)						\
+static ssize_t show_##file_name						\
+(struct kobject *kobj, struct attribute *attr, char *buf)		\
+{									\
+	return sprintf(buf, "%lu\n", file_name);			\
+}
+
+#define store_one(file_name, min_val, max_val)				\
+static ssize_t store_##file_name					\
+(struct kobject *kobj, struct attribute *attr,				\
+ const char *buf, size_t count)						\
+{									\
+	unsigned long val;						\
+	int ret;							\
+									\
+	ret = strict_strtoul(buf, 0, &val);				\
+	if (ret < 0)							\
+		return ret;						\
+	if (val < (min_val) || val > (max_val))				\
+		return -EINVAL;						\
+	file_name = val;						\
+	return count;							\
+}									\
+static struct global_attr file_name##_attr = __ATTR(file_name, 0644,	\
+		show_##file_name, store_##file_name)
+
+show_one(up_threshold);
+store_one(up_threshold, 1, 100);
+show_one(target_load);
+store_one(target_load, 1, 100);
+show_one(history);
+store_one(history, 1, CPUFREQ_LOAD_HISTORY);
+show_one(horizon);
+store_one(horizon, 0, CPUFREQ_LOAD_HISTORY);
+
+static ssize_t show_sampling_rate(struct kobject *kobj,
+				  struct attribute *attr, char *buf)
+{
+	return sprintf(buf, "%u\n", predictive_gov.sample_rate);
+}
+
+static ssize_t store_sampling_rate(struct kobject *kobj,
+			struct attribute *attr, const char *buf, size_t count)
+{
+	unsigned long val;
+	int ret;
+
+	ret = strict_strtoul(buf, 0, &val);
+	if (ret < 0)
+		return ret;
+	if (val < jiffies_to_usecs(1) || val > UINT_MAX)
+		return -EINVAL;
+	predictive_gov.sample_rate = val;
+	return count;
+}
+
+static struct global_attr sampling_rate_attr = __ATTR(sampling_rate, 0644,
+		show_sampling_rate, store_sampling_rate);
+
+static ssize_t show_io_is_busy(struct kobject *kobj,
+			       struct attribute *attr, char *buf)
+{
+	return sprintf(buf, "%u\n", predictive_gov.io_is_busy);
+}
+
+static ssize_t store_io_is_busy(struct kobject *kobj,
+			struct attribute *attr, const char *buf, size_t count)
+{
+	unsigned long val;
+	int ret;
+
+	ret = strict_strtoul(buf, 0, &val);
+	if (ret < 0)
+		return ret;
+	predictive_gov.io_is_busy = !!val;
+	return count;
+}
+
+static struct global_attr io_is_busy_attr = __ATTR(io_is_busy, 0644,
+		show_io_is_busy, store_io_is_busy);
+
+static struct attribute *predictive_attributes[] = {
+	&up_threshold_attr.attr,
+	&target_load_attr.attr,
+	&history_attr.attr,
+	&horizon_attr.attr,
+	&sampling_rate_attr.attr,
+	&io_is_busy_attr.attr,
+	NULL,
+};
+
+static struct attribute_group predictive_attr_group = {
+	.attrs = predictive_attributes,
+	.name = "predictive",
+};
+
+static int cpufreq_governor_predictive(struct cpufreq_policy *policy,
+		unsigned int event)
+{
+	int rc;
+
+	switch (event) {
+	case CPUFREQ_GOV_START:
+		mutex_lock(&predictive_mutex);
+		if (!predictive_enable++) {
+			rc = sysfs_create_group(cpufreq_global_kobject,
+						&predictive_attr_group);
+			if (rc) {
+				predictive_enable--;
+				mutex_unlock(&predictive_mutex);
+				return rc;
+			}
+		}
+		mutex_unlock(&predictive_mutex);
+
+		rc = cpufreq_load_start(&predictive_gov, policy);
+		if (rc) {
+			mutex_lock(&predictive_mutex);
+			if (!--predictive_enable)
+				sysfs_remove_group(cpufreq_global_kobject,
+						   &predictive_attr_group);
+			mutex_unlock(&predictive_mutex);
+			return rc;
+		}
+		break;
+
+	case CPUFREQ_GOV_STOP:
+		cpufreq_load_stop(&predictive_gov, policy);
+
+		mutex_lock(&predictive_mutex);
+		if (!--predictive_enable)
+			sysfs_remove_group(cpufreq_global_kobject,
+					   &predictive_attr_group);
+		mutex_unlock(&predictive_mutex);
+		break;
+
+	case CPUFREQ_GOV_LIMITS:
+		cpufreq_load_limits(&predictive_gov, policy);
+		break;
+	}
+	return 0;
+}
+
+static int __init cpufreq_predictive_init(void)
+{
+	int rc;
+
+	up_threshold = DEFAULT_UP_THRESHOLD;
+	target_load = DEFAULT_TARGET_LOAD;
+	history = DEFAULT_HISTORY;
+	horizon = DEFAULT_HORIZON;
+
+	predictive_gov.get_target = predictive_get_target;
+	predictive_gov.sample_rate = DEFAULT_SAMPLE_RATE;
+
+	rc = cpufreq_load_governor_init(&predictive_gov, "kpredictive");
+	if (rc)
+		return rc;
+
+	rc = cpufreq_register_governor(&cpufreq_gov_predictive);
+	if (rc)
+		cpufreq_load_governor_exit(&predictive_gov);
+	return rc;
+}
+
+#ifdef CONFIG_CPU_FREQ_DEFAULT_GOV_PREDICTIVE
+fs_initcall(cpufreq_predictive_init);
+#else
+module_init(cpufreq_predictive_init);
+#endif
+
+static void __exit cpufreq_predictive_exit(void)
+{
+	cpufreq_unregister_governor(&cpufreq_gov_predictive);
+	cpufreq_load_governor_exit(&predictive_gov);
+}
+
+module_exit(cpufreq_predictive_exit);
+
+MODULE_DESCRIPTION("'cpufreq_predictive' - A cpufreq governor driven by "
+	"a forecast of recent cpu demand");
+MODULE_LICENSE("GPL");
@@ -24,17 +24,29 @@
 #include <linux/platform_data/ram_console.h>
 
 #ifdef CONFIG_ANDROID_RAM_CONSOLE_ERROR_CORRECTION
+#include <linux/kernel.h>
+#include <linux/kmsg_dump.h>
 #include <linux/rslib.h>
+#include <linux/workqueue.h>
 #endif
 
 struct ram_console_buffer {
 	uint32_t    sig;
 	uint32_t    start;
 	uint32_t    size;
+#ifdef CONFIG_ANDROID_RAM_CONSOLE_ERROR_CORRECTION
+	/* data from here up to start has no parity yet */
+	uint32_t    ecc_start;
+#endif
 	uint8_t     data[0];
 };
 
+#ifdef CONFIG_ANDROID_RAM_CONSOLE_ERROR_CORRECTION
+/* the header has ecc_start: do not read an old header as this one */
+#define RAM_CONSOLE_SIG (0x45474244) /* DBGE */
+#else
 #define RAM_CONSOLE_SIG (0x43474244) /* DBGC */
+#endif
 
 #ifdef CONFIG_ANDROID_RAM_CONSOLE_EARLY_INIT
 static char __initdata
@@ -50,10 +62,14 @@ static char *ram_console_par_buffer;
 static struct rs_control *ram_console_rs_decoder;
 static int ram_console_corrected_bytes;
 static int ram_console_bad_blocks;
+static int ram_console_unchecked_blocks;
+static size_t ram_console_ecc_dirty;
+static bool ram_console_ecc_batch;
 #define ECC_BLOCK_SIZE CONFIG_ANDROID_RAM_CONSOLE_ERROR_CORRECTION_DATA_SIZE
 #define ECC_SIZE CONFIG_ANDROID_RAM_CONSOLE_ERROR_CORRECTION_ECC_SIZE
 #define ECC_SYMSIZE CONFIG_ANDROID_RAM_CONSOLE_ERROR_CORRECTION_SYMBOL_SIZE
 #define ECC_POLY CONFIG_ANDROID_RAM_CONSOLE_ERROR_CORRECTION_POLYNOMIAL
+#define ECC_DELAY CONFIG_ANDROID_RAM_CONSOLE_ERROR_CORRECTION_DELAY_MS
 #endif
 
 #ifdef CONFIG_ANDROID_RAM_CONSOLE_ERROR_CORRECTION
@@ -82,24 +98,10 @@ static int ram_console_decode_rs8(void *data, size_t len, uint8_t *ecc)
 static void ram_console_update(const char *s, unsigned int count)
 {
 	struct ram_console_buffer *buffer = ram_console_buffer;
-#ifdef CONFIG_ANDROID_RAM_CONSOLE_ERROR_CORRECTION
-	uint8_t *buffer_end = buffer->data + ram_console_buffer_size;
-	uint8_t *block;
-	uint8_t *par;
-	int size = ECC_BLOCK_SIZE;
-#endif
+
 	memcpy(buffer->data + buffer->start, s, count);
 #ifdef CONFIG_ANDROID_RAM_CONSOLE_ERROR_CORRECTION
-	block = buffer->data + (buffer->start & ~(ECC_BLOCK_SIZE - 1));
-	par = ram_console_par_buffer +
-	      (buffer->start / ECC_BLOCK_SIZE) * ECC_SIZE;
-	do {
-		if (block + ECC_BLOCK_SIZE > buffer_end)
-			size = buffer_end - block;
-		ram_console_encode_rs8(block, size, par);
-		block += ECC_BLOCK_SIZE;
-		par += ECC_SIZE;
-	} while (block < buffer->data + buffer->start + count);
+	ram_console_ecc_dirty += count;
 #endif
 }
 
@@ -114,6 +116,108 @@ static void ram_console_update_header(void)
 #endif
 }
 
+#ifdef CONFIG_ANDROID_RAM_CONSOLE_ERROR_CORRECTION
+/*
+ * Console writes only copy the text and extend the span of data without
+ * parity, which starts at buffer->ecc_start and is recorded in the
+ * header, so the next boot does not "correct" it against stale parity.
+ * The parity of the blocks it covers is computed in one go by deferrable
+ * work that polls every ECC_DELAY ms, or at once during an oops or panic
+ * and from the kmsg dumper that runs before any restart, halt or power
+ * off.  Until the work is started by the late initcall, which is after
+ * workqueues are up, every write computes its parity as it used to.  The
+ * console path itself never queues work or arms a timer.  The header is
+ * small and still updated on every write.
+ */
+static void ram_console_encode_block(size_t n)
+{
+	uint8_t *block = ram_console_buffer->data + n * ECC_BLOCK_SIZE;
+	size_t size = min_t(size_t, ECC_BLOCK_SIZE,
+			    ram_console_buffer_size - n * ECC_BLOCK_SIZE);
+
+	ram_console_encode_rs8(block, size,
+			       ram_console_par_buffer + n * ECC_SIZE);
+}
+
+static void ram_console_ecc_flush(void)
+{
+	struct ram_console_buffer *buffer = ram_console_buffer;
+	size_t nblocks = DIV_ROUND_UP(ram_console_buffer_size, ECC_BLOCK_SIZE);
+	size_t first, last, n;
+
+	if (!ram_console_ecc_dirty)
+		return;
+
+	first = buffer->ecc_start / ECC_BLOCK_SIZE;
+	last = (buffer->ecc_start + ram_console_ecc_dirty - 1) / ECC_BLOCK_SIZE;
+	for (n = first; n <= last; n++)
+		ram_console_encode_block(n % nblocks);
+
+	ram_console_ecc_dirty = 0;
+	buffer->ecc_start = buffer->start;
+	ram_console_update_header();
+}
+
+static void ram_console_ecc_work_func(struct work_struct *work);
+static DECLARE_DEFERRED_WORK(ram_console_ecc_work, ram_console_ecc_work_func);
+
+static void ram_console_ecc_work_func(struct work_struct *work)
+{
+	console_lock();
+	ram_console_ecc_flush();
+	console_unlock();
+	schedule_delayed_work(&ram_console_ecc_work,
+			      msecs_to_jiffies(ECC_DELAY));
+}
+
+static void __init ram_console_ecc_start(void)
+{
+	if (!ram_console_buffer || !ECC_DELAY)
+		return;
+	schedule_delayed_work(&ram_console_ecc_work,
+			      msecs_to_jiffies(ECC_DELAY));
+	ram_console_ecc_batch = true;
+}
+
+static void ram_console_ecc_dump(struct kmsg_dumper *dumper,
+	enum kmsg_dump_reason reason, const char *s1, unsigned long l1,
+	const char *s2, unsigned long l2)
+{
+	/*
+	 * Panics and oopses may not get the console lock back, and the
+	 * other cpus are stopped or about to be.  On restart, halt and
+	 * power off they still run, so flush only if printk is not busy
+	 * with the buffer; whatever it is writing stays marked as not
+	 * covered by parity.
+	 */
+	if (oops_in_progress) {
+		ram_console_ecc_flush();
+		return;
+	}
+	if (!console_trylock())
+		return;
+	ram_console_ecc_flush();
+	console_unlock();
+}
+
+static struct kmsg_dumper ram_console_ecc_dumper = {
+	.dump = ram_console_ecc_dump,
+};
+
+/* Does the data at @off, @len bytes, lie in the span without parity? */
+static bool ram_console_ecc_stale(struct ram_console_buffer *buffer,
+				  size_t off, size_t len)
+{
+	size_t from = buffer->ecc_start, to = buffer->start;
+
+	if (from == to || from > ram_console_buffer_size)
+		return false;
+	if (from < to)
+		return off < to && off + len > from;
+	return off < to || off + len > from;
+}
+#endif
+
 static void
 ram_console_write(struct console *console, const char *s, unsigned int count)
 {
@@ -124,6 +228,13 @@ ram_console_write(struct console *console, const char *s, unsigned int count)
 		s += count - ram_console_buffer_size;
 		count = ram_console_buffer_size;
 	}
+#ifdef CONFIG_ANDROID_RAM_CONSOLE_ERROR_CORRECTION
+	/* keep ecc_start == start meaning "nothing without parity" */
+	if (ram_console_ecc_dirty + count >= ram_console_buffer_size)
+		ram_console_ecc_flush();
+	if (!ram_console_ecc_dirty)
+		buffer->ecc_start = buffer->start;
+#endif
 	rem = ram_console_buffer_size - buffer->start;
 	if (rem < count) {
 		ram_console_update(s, rem);
@@ -137,6 +248,12 @@ ram_console_write(struct console *console, const char *s, unsigned int count)
 	buffer->start += count;
 	if (buffer->size < ram_console_buffer_size)
 		buffer->size += count;
+#ifdef CONFIG_ANDROID_RAM_CONSOLE_ERROR_CORRECTION
+	if (oops_in_progress || !ram_console_ecc_batch) {
+		ram_console_ecc_flush();
+		return;
+	}
+#endif
 	ram_console_update_header();
 }
 
@@ -168,7 +285,7 @@ ram_console_save_old(struct ram_console_buffer *buffer, const char *bootinfo,
 #ifdef CONFIG_ANDROID_RAM_CONSOLE_ERROR_CORRECTION
 	uint8_t *block;
 	uint8_t *par;
-	char strbuf[80];
+	char strbuf[128];
 	int strbuf_len = 0;
 
 	block = buffer->data;
@@ -178,6 +295,12 @@ ram_console_save_old(struct ram_console_buffer *buffer, const char *bootinfo,
 		int size = ECC_BLOCK_SIZE;
 		if (block + size > buffer->data + ram_console_buffer_size)
 			size = buffer->data + ram_console_buffer_size - block;
+		if (ram_console_ecc_stale(buffer, block - buffer->data, size)) {
+			ram_console_unchecked_blocks++;
+			block += ECC_BLOCK_SIZE;
+			par += ECC_SIZE;
+			continue;
+		}
 		numerr = ram_console_decode_rs8(block, size, par);
 		if (numerr > 0) {
 #if 0
@@ -202,6 +325,11 @@ ram_console_save_old(struct ram_console_buffer *buffer, const char *bootinfo,
 	else
 		strbuf_len = snprintf(strbuf, sizeof(strbuf),
 				      "\nNo errors detected\n");
+	if (ram_console_unchecked_blocks && strbuf_len < sizeof(strbuf))
+		strbuf_len += snprintf(strbuf + strbuf_len,
+			sizeof(strbuf) - strbuf_len,
+			"%d blocks written after the last parity update\n",
+			ram_console_unchecked_blocks);
 	if (strbuf_len >= sizeof(strbuf))
 		strbuf_len = sizeof(strbuf) - 1;
 	total_size += strbuf_len;
@@ -318,6 +446,12 @@ static int __init ram_console_init(struct ram_console_buffer *buffer,
 	buffer->sig = RAM_CONSOLE_SIG;
 	buffer->start = 0;
 	buffer->size = 0;
+#ifdef CONFIG_ANDROID_RAM_CONSOLE_ERROR_CORRECTION
+	buffer->ecc_start = 0;
+	ram_console_ecc_dirty = 0;
+	if (kmsg_dump_register(&ram_console_ecc_dumper))
+		printk(KERN_ERR "ram_console: failed to register dumper\n");
+#endif
 
 	register_console(&ram_console);
 #ifdef CONFIG_ANDROID_RAM_CONSOLE_ENABLE_VERBOSE
@@ -408,6 +542,9 @@ static int __init ram_console_late_init(void)
 {
 	struct proc_dir_entry *entry;
 
+#ifdef CONFIG_ANDROID_RAM_CONSOLE_ERROR_CORRECTION
+	ram_console_ecc_start();
+#endif
 	if (ram_console_old_log == NULL)
 		return 0;
 #ifdef CONFIG_ANDROID_RAM_CONSOLE_EARLY_INIT
@@ -30,11 +30,46 @@
 #include <linux/highmem.h>
 #include <linux/slab.h>
 #include <linux/lzo.h>
+#include <linux/lz4.h>
 #include <linux/string.h>
 #include <linux/vmalloc.h>
 
 #include "zram_drv.h"
 
+/*
+ * Both compressors return 0 on success and take the output buffer size
+ * in *dst_len; the buffer is the order-1 compress_buffer.
+ */
+#ifdef CONFIG_ZRAM_LZ4
+#define ZRAM_COMP_WORKMEM	LZ4_MEM_COMPRESS
+
+static int zram_compress(const unsigned char *src, unsigned char *dst,
+			 size_t *dst_len, void *wrkmem)
+{
+	return lz4_compress(src, PAGE_SIZE, dst, dst_len, wrkmem);
+}
+
+static int zram_decompress(const unsigned char *src, size_t src_len,
+			   unsigned char *dst, size_t *dst_len)
+{
+	return lz4_decompress_safe(src, src_len, dst, dst_len);
+}
+#else
+#define ZRAM_COMP_WORKMEM	LZO1X_MEM_COMPRESS
+
+static int zram_compress(const unsigned char *src, unsigned char *dst,
+			 size_t *dst_len, void *wrkmem)
+{
+	return lzo1x_1_compress(src, PAGE_SIZE, dst, dst_len, wrkmem);
+}
+
+static int zram_decompress(const unsigned char *src, size_t src_len,
+			   unsigned char *dst, size_t *dst_len)
+{
+	return lzo1x_decompress_safe(src, src_len, dst, dst_len);
+}
+#endif
+
 /* Globals */
 static int zram_major;
 struct zram *devices;
@@ -257,9 +292,9 @@ static int zram_bvec_read(struct zram *zram, struct bio_vec *bvec,
 	cmem = kmap_atomic(zram->table[index].page, KM_USER1) +
 		zram->table[index].offset;
 
-	ret = lzo1x_decompress_safe(cmem + sizeof(*zheader),
-				    xv_get_object_size(cmem) - sizeof(*zheader),
-				    uncmem, &clen);
+	ret = zram_decompress(cmem + sizeof(*zheader),
+			      xv_get_object_size(cmem) - sizeof(*zheader),
+			      uncmem, &clen);
 
 	if (is_partial_io(bvec)) {
 		memcpy(user_mem + bvec->bv_offset, uncmem + offset,
@@ -271,7 +306,7 @@ static int zram_bvec_read(struct zram *zram, struct bio_vec *bvec,
 	kunmap_atomic(user_mem, KM_USER0);
 
 	/* Should NEVER happen. Return bio error if it does. */
-	if (unlikely(ret != LZO_E_OK)) {
+	if (unlikely(ret)) {
 		pr_err("Decompression failed! err=%d, page=%u\n", ret, index);
 		zram_stat64_inc(zram, &zram->stats.failed_reads);
 		return ret;
@@ -305,13 +340,13 @@ static int zram_read_before_write(struct zram *zram, char *mem, u32 index)
 		return 0;
 	}
 
-	ret = lzo1x_decompress_safe(cmem + sizeof(*zheader),
-				    xv_get_object_size(cmem) - sizeof(*zheader),
-				    mem, &clen);
+	ret = zram_decompress(cmem + sizeof(*zheader),
+			      xv_get_object_size(cmem) - sizeof(*zheader),
+			      mem, &clen);
 	kunmap_atomic(cmem, KM_USER0);
 
 	/* Should NEVER happen. Return bio error if it does. */
-	if (unlikely(ret != LZO_E_OK)) {
+	if (unlikely(ret)) {
 		pr_err("Decompression failed! err=%d, page=%u\n", ret, index);
 		zram_stat64_inc(zram, &zram->stats.failed_reads);
 		return ret;
@@ -377,14 +412,14 @@ static int zram_bvec_write(struct zram *zram, struct bio_vec *bvec, u32 index,
 		goto out;
 	}
 
-	ret = lzo1x_1_compress(uncmem, PAGE_SIZE, src, &clen,
-			       zram->compress_workmem);
+	clen = 2 * PAGE_SIZE;
+	ret = zram_compress(uncmem, src, &clen, zram->compress_workmem);
 
 	kunmap_atomic(user_mem, KM_USER0);
 	if (is_partial_io(bvec))
 			kfree(uncmem);
 
-	if (unlikely(ret != LZO_E_OK)) {
+	if (unlikely(ret)) {
 		pr_err("Compression failed! err=%d\n", ret);
 		goto out;
 	}
@@ -634,7 +669,7 @@ int zram_init_device(struct zram *zram)
 
 	zram_set_disksize(zram, totalram_pages << PAGE_SHIFT);
 
-	zram->compress_workmem = kzalloc(LZO1X_MEM_COMPRESS, GFP_KERNEL);
+	zram->compress_workmem = kzalloc(ZRAM_COMP_WORKMEM, GFP_KERNEL);
 	if (!zram->compress_workmem) {
 		pr_err("Error allocating compressor working memory!\n");
 		ret = -ENOMEM;
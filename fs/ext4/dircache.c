@@ -0,0 +1,374 @@
+/*
+ *  linux/fs/ext4/dircache.c
+ *
+ * In-memory lookup cache for htree (dir_index) directories.
+ *
+ * A lookup in an indexed directory normally reads the dx root, binary
+ * searches it (and an interior index block on two-level trees), then
+ * reads and linearly scans the leaf block the name hashes to. For large
+ * directories (dalvik-cache, application caches) most of that work is
+ * repeated for every lookup, and a name that does not exist pays the
+ * full price every time.
+ *
+ * The cache is built lazily: every leaf block scanned by
+ * ext4_dx_find_entry() has the hashes of its live entries recorded,
+ * mapping each hash to the logical block holding the name. Later
+ * lookups go straight to that block. Positive entries are hints only;
+ * the block is searched as usual, and a stale hint (the entry moved on
+ * a split, or went away) is dropped and the index walked as before.
+ *
+ * Names that were looked up and not found are recorded as negative
+ * entries together with the name itself, so that a hash collision can
+ * never hide an existing file. Since a negative entry is trusted
+ * without touching the disk, every insertion into the directory drops
+ * the negative entry for that name first; insertions all go through
+ * add_dirent_to_buf() in namei.c.
+ *
+ * The cache hangs off the directory inode and is freed together with
+ * it, so the inode shrinker bounds the memory used; the number of
+ * entries per directory is capped by /sys/fs/ext4/<dev>/dir_cache_max.
+ * Callers hold the directory i_mutex; dc_lock only protects the hash
+ * chains themselves.
+ */
+
+#include <linux/fs.h>
+#include <linux/hash.h>
+#include <linux/log2.h>
+#include <linux/slab.h>
+#include <linux/buffer_head.h>
+#include "ext4.h"
+
+#define EXT4_DIRCACHE_MIN_BITS	6
+#define EXT4_DIRCACHE_MAX_BITS	10
+
+/* de_block value of a negative entry */
+#define EXT4_DIRCACHE_NEG	((ext4_lblk_t) ~0U)
+
+struct ext4_dircache_entry {
+	struct hlist_node	de_node;
+	u32			de_hash;
+	u32			de_minor_hash;
+	ext4_lblk_t		de_block;
+	u8			de_name_len;	/* negative entries only */
+	char			de_name[0];
+};
+
+struct ext4_dircache {
+	spinlock_t		dc_lock;
+	int			dc_hash_version;
+	unsigned int		dc_bits;
+	unsigned int		dc_count;
+	unsigned int		dc_gen;		/* bumped by insertions */
+	struct hlist_head	dc_hash[0];
+};
+
+static size_t ext4_dircache_entry_size(struct ext4_dircache_entry *e)
+{
+	if (e->de_block == EXT4_DIRCACHE_NEG)
+		return sizeof(*e) + e->de_name_len;
+	return sizeof(*e);
+}
+
+static size_t ext4_dircache_size(unsigned int bits)
+{
+	return sizeof(struct ext4_dircache) +
+		(sizeof(struct hlist_head) << bits);
+}
+
+static struct hlist_head *ext4_dircache_bucket(struct ext4_dircache *dc,
+					       u32 hash)
+{
+	return &dc->dc_hash[hash_32(hash, dc->dc_bits)];
+}
+
+static void ext4_dircache_hash(struct inode *dir, struct ext4_dircache *dc,
+			       const char *name, int len,
+			       struct dx_hash_info *hinfo)
+{
+	hinfo->hash_version = dc->dc_hash_version;
+	hinfo->seed = EXT4_SB(dir->i_sb)->s_hash_seed;
+	ext4fs_dirhash(name, len, hinfo);
+}
+
+static void ext4_dircache_del(struct ext4_sb_info *sbi,
+			      struct ext4_dircache *dc,
+			      struct ext4_dircache_entry *e)
+{
+	hlist_del(&e->de_node);
+	dc->dc_count--;
+	atomic_long_sub(ext4_dircache_entry_size(e), &sbi->s_dir_cache_bytes);
+	kfree(e);
+}
+
+/*
+ * Look @d_name up in the cache of @dir. Returns EXT4_DIRCACHE_NEGATIVE if
+ * the name is known not to exist, EXT4_DIRCACHE_POSITIVE with the leaf
+ * block in *@block if it is believed to be there, and EXT4_DIRCACHE_MISS
+ * otherwise. *@gen is set for a later ext4_dircache_add_negative().
+ */
+int ext4_dircache_lookup(struct inode *dir, const struct qstr *d_name,
+			 ext4_lblk_t *block, unsigned int *gen)
+{
+	struct ext4_sb_info *sbi = EXT4_SB(dir->i_sb);
+	struct ext4_dircache *dc = EXT4_I(dir)->i_dircache;
+	struct ext4_dircache_entry *e;
+	struct hlist_node *pos;
+	struct dx_hash_info hinfo;
+	int ret = EXT4_DIRCACHE_MISS;
+
+	*gen = 0;
+	if (!dc)
+		goto out;
+
+	ext4_dircache_hash(dir, dc, d_name->name, d_name->len, &hinfo);
+	spin_lock(&dc->dc_lock);
+	*gen = dc->dc_gen;
+	hlist_for_each_entry(e, pos, ext4_dircache_bucket(dc, hinfo.hash),
+			     de_node) {
+		if (e->de_hash != hinfo.hash ||
+		    e->de_minor_hash != hinfo.minor_hash)
+			continue;
+		if (e->de_block != EXT4_DIRCACHE_NEG) {
+			*block = e->de_block;
+			ret = EXT4_DIRCACHE_POSITIVE;
+			break;
+		}
+		if (e->de_name_len == d_name->len &&
+		    !memcmp(e->de_name, d_name->name, d_name->len)) {
+			ret = EXT4_DIRCACHE_NEGATIVE;
+			break;
+		}
+	}
+	spin_unlock(&dc->dc_lock);
+out:
+	if (ret == EXT4_DIRCACHE_POSITIVE)
+		atomic_inc(&sbi->s_dir_cache_hits);
+	else if (ret == EXT4_DIRCACHE_NEGATIVE)
+		atomic_inc(&sbi->s_dir_cache_neg_hits);
+	else
+		atomic_inc(&sbi->s_dir_cache_misses);
+	return ret;
+}
+
+static struct ext4_dircache *ext4_dircache_get(struct inode *dir,
+					       struct dx_hash_info *hinfo)
+{
+	struct ext4_sb_info *sbi = EXT4_SB(dir->i_sb);
+	struct ext4_inode_info *ei = EXT4_I(dir);
+	struct ext4_dircache *dc = ei->i_dircache;
+	unsigned int bits;
+	int i;
+
+	if (dc || !sbi->s_dir_cache_max)
+		return dc;
+
+	/* size the table for roughly 16 entries per leaf block */
+	bits = ilog2((dir->i_size >> dir->i_sb->s_blocksize_bits) + 1) + 4;
+	bits = clamp_t(unsigned int, bits, EXT4_DIRCACHE_MIN_BITS,
+		       EXT4_DIRCACHE_MAX_BITS);
+	dc = kmalloc(ext4_dircache_size(bits), GFP_NOFS);
+	if (!dc)
+		return NULL;
+	spin_lock_init(&dc->dc_lock);
+	dc->dc_hash_version = hinfo->hash_version;
+	dc->dc_bits = bits;
+	dc->dc_count = 0;
+	dc->dc_gen = 0;
+	for (i = 0; i < (1 << bits); i++)
+		INIT_HLIST_HEAD(&dc->dc_hash[i]);
+
+	if (cmpxchg(&ei->i_dircache, NULL, dc) != NULL) {
+		kfree(dc);
+		return ei->i_dircache;
+	}
+	atomic_long_add(ext4_dircache_size(bits), &sbi->s_dir_cache_bytes);
+	return dc;
+}
+
+static bool ext4_dircache_has_block(struct ext4_dircache *dc, u32 hash,
+				    u32 minor_hash, ext4_lblk_t block)
+{
+	struct ext4_dircache_entry *e;
+	struct hlist_node *pos;
+
+	hlist_for_each_entry(e, pos, ext4_dircache_bucket(dc, hash), de_node)
+		if (e->de_hash == hash && e->de_minor_hash == minor_hash &&
+		    e->de_block == block)
+			return true;
+	return false;
+}
+
+/*
+ * Record every live entry of the leaf block @bh (logical block @block)
+ * of @dir. @hinfo is the one dx_probe() filled in; only its hash version
+ * is used.
+ */
+void ext4_dircache_add_block(struct inode *dir, struct dx_hash_info *hinfo,
+			     struct buffer_head *bh, ext4_lblk_t block)
+{
+	struct ext4_sb_info *sbi = EXT4_SB(dir->i_sb);
+	unsigned int blocksize = dir->i_sb->s_blocksize;
+	struct ext4_dircache *dc;
+	struct ext4_dircache_entry *e;
+	struct ext4_dir_entry_2 *de;
+	struct dx_hash_info h;
+	char *limit = bh->b_data + blocksize;
+	int rlen;
+
+	dc = ext4_dircache_get(dir, hinfo);
+	if (!dc)
+		return;
+
+	for (de = (struct ext4_dir_entry_2 *) bh->b_data;
+	     (char *) de < limit;
+	     de = (struct ext4_dir_entry_2 *) ((char *) de + rlen)) {
+		rlen = ext4_rec_len_from_disk(de->rec_len, blocksize);
+		if (rlen < EXT4_DIR_REC_LEN(1) ||
+		    (char *) de + rlen > limit ||
+		    rlen < EXT4_DIR_REC_LEN(de->name_len))
+			return;
+		if (!de->inode)
+			continue;
+		if (dc->dc_count >= sbi->s_dir_cache_max)
+			return;
+
+		ext4_dircache_hash(dir, dc, de->name, de->name_len, &h);
+		spin_lock(&dc->dc_lock);
+		if (ext4_dircache_has_block(dc, h.hash, h.minor_hash, block)) {
+			spin_unlock(&dc->dc_lock);
+			continue;
+		}
+		spin_unlock(&dc->dc_lock);
+
+		e = kmalloc(sizeof(*e), GFP_NOFS);
+		if (!e)
+			return;
+		e->de_hash = h.hash;
+		e->de_minor_hash = h.minor_hash;
+		e->de_block = block;
+		e->de_name_len = 0;
+
+		spin_lock(&dc->dc_lock);
+		hlist_add_head(&e->de_node, ext4_dircache_bucket(dc, h.hash));
+		dc->dc_count++;
+		spin_unlock(&dc->dc_lock);
+		atomic_long_add(sizeof(*e), &sbi->s_dir_cache_bytes);
+	}
+}
+
+/*
+ * Remember that @d_name does not exist in @dir. @hinfo holds the hash
+ * dx_probe() computed for it, and @gen is what ext4_dircache_lookup()
+ * returned before the search: if the directory gained an entry since,
+ * the result may already be stale and is not recorded.
+ */
+void ext4_dircache_add_negative(struct inode *dir, const struct qstr *d_name,
+				struct dx_hash_info *hinfo, unsigned int gen)
+{
+	struct ext4_sb_info *sbi = EXT4_SB(dir->i_sb);
+	struct ext4_dircache *dc;
+	struct ext4_dircache_entry *e;
+	struct hlist_head *head;
+
+	dc = ext4_dircache_get(dir, hinfo);
+	if (!dc)
+		return;
+
+	e = kmalloc(sizeof(*e) + d_name->len, GFP_NOFS);
+	if (!e)
+		return;
+	e->de_hash = hinfo->hash;
+	e->de_minor_hash = hinfo->minor_hash;
+	e->de_block = EXT4_DIRCACHE_NEG;
+	e->de_name_len = d_name->len;
+	memcpy(e->de_name, d_name->name, d_name->len);
+
+	head = ext4_dircache_bucket(dc, e->de_hash);
+	spin_lock(&dc->dc_lock);
+	if (dc->dc_gen != gen) {
+		spin_unlock(&dc->dc_lock);
+		kfree(e);
+		return;
+	}
+	/* when full, make room by evicting from the same chain */
+	if (dc->dc_count >= sbi->s_dir_cache_max) {
+		if (hlist_empty(head)) {
+			spin_unlock(&dc->dc_lock);
+			kfree(e);
+			return;
+		}
+		ext4_dircache_del(sbi, dc, hlist_entry(head->first,
+			struct ext4_dircache_entry, de_node));
+	}
+	hlist_add_head(&e->de_node, head);
+	dc->dc_count++;
+	spin_unlock(&dc->dc_lock);
+	atomic_long_add(ext4_dircache_entry_size(e), &sbi->s_dir_cache_bytes);
+}
+
+/*
+ * Drop the cached entries for @name in @dir: the negative one when
+ * @negative is set (the name is being created), the positive ones
+ * otherwise (it is being removed, or a hint turned out stale).
+ */
+static void ext4_dircache_drop(struct inode *dir, const char *name, int len,
+			       bool negative)
+{
+	struct ext4_sb_info *sbi = EXT4_SB(dir->i_sb);
+	struct ext4_dircache *dc = EXT4_I(dir)->i_dircache;
+	struct ext4_dircache_entry *e;
+	struct hlist_node *pos, *n;
+	struct dx_hash_info hinfo;
+
+	if (!dc)
+		return;
+
+	ext4_dircache_hash(dir, dc, name, len, &hinfo);
+	spin_lock(&dc->dc_lock);
+	if (negative)
+		dc->dc_gen++;
+	hlist_for_each_entry_safe(e, pos, n,
+				  ext4_dircache_bucket(dc, hinfo.hash),
+				  de_node) {
+		if (e->de_hash != hinfo.hash ||
+		    e->de_minor_hash != hinfo.minor_hash)
+			continue;
+		if (!negative && e->de_block != EXT4_DIRCACHE_NEG)
+			ext4_dircache_del(sbi, dc, e);
+		else if (negative && e->de_block == EXT4_DIRCACHE_NEG &&
+			 e->de_name_len == len &&
+			 !memcmp(e->de_name, name, len))
+			ext4_dircache_del(sbi, dc, e);
+	}
+	spin_unlock(&dc->dc_lock);
+}
+
+void ext4_dircache_insert(struct inode *dir, const char *name, int len)
+{
+	ext4_dircache_drop(dir, name, len, true);
+}
+
+void ext4_dircache_remove(struct inode *dir, const char *name, int len)
+{
+	ext4_dircache_drop(dir, name, len, false);
+}
+
+void ext4_dircache_free(struct inode *dir)
+{
+	struct ext4_sb_info *sbi = EXT4_SB(dir->i_sb);
+	struct ext4_dircache *dc;
+	struct ext4_dircache_entry *e;
+	struct hlist_node *pos, *n;
+	int i;
+
+	dc = xchg(&EXT4_I(dir)->i_dircache, NULL);
+	if (!dc)
+		return;
+
+	for (i = 0; i < (1 << dc->dc_bits); i++)
+		hlist_for_each_entry_safe(e, pos, n, &dc->dc_hash[i], de_node)
+			ext4_dircache_del(sbi, dc, e);
+	atomic_long_sub(ext4_dircache_size(dc->dc_bits),
+			&sbi->s_dir_cache_bytes);
+	kfree(dc);
+}
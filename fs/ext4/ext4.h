@@ -772,6 +772,7 @@ struct ext4_inode_info {
 	 */
 	ext4_group_t	i_block_group;
 	ext4_lblk_t	i_dir_start_lookup;
+	struct ext4_dircache *i_dircache;	/* htree lookup cache */
 #if (BITS_PER_LONG < 64)
 	unsigned long	i_state_flags;		/* Dynamic state flags */
 #endif
@@ -1159,6 +1160,15 @@ struct ext4_sb_info {
 	unsigned long extent_cache_hits;
 	unsigned long extent_cache_misses;
 
+	/* htree lookup cache */
+	unsigned int s_dir_cache_max;	/* entries per directory */
+	atomic_t s_dir_cache_hits;
+	atomic_t s_dir_cache_neg_hits;
+	atomic_t s_dir_cache_misses;
+	atomic_long_t s_dir_cache_bytes;
+	atomic_t s_dx_lookups;
+	atomic64_t s_dx_lookup_ns;
+
 	/* for buddy allocator */
 	struct ext4_group_info ***s_group_info;
 	struct inode *s_buddy_cache;
@@ -1168,6 +1178,7 @@ struct ext4_sb_info {
 
 	/* tunables */
 	unsigned long s_stripe;
+	unsigned long s_erase_blk;
 	unsigned int s_mb_stream_request;
 	unsigned int s_mb_max_to_scan;
 	unsigned int s_mb_min_to_scan;
@@ -1187,6 +1198,8 @@ struct ext4_sb_info {
 	atomic_t s_bal_goals;	/* goal hits */
 	atomic_t s_bal_breaks;	/* too long searches */
 	atomic_t s_bal_2orders;	/* 2^order hits */
+	atomic_t s_bal_erase_aligned;	/* erase block aligned allocations */
+	atomic_t s_bal_erase_misaligned;	/* erase block straddling ones */
 	spinlock_t s_bal_lock;
 	unsigned long s_mb_buddies_generated;
 	unsigned long long s_mb_generation_time;
@@ -1765,6 +1778,27 @@ extern int ext4_htree_store_dirent(struct file *dir_file, __u32 hash,
 				    struct ext4_dir_entry_2 *dirent);
 extern void ext4_htree_free_dir_info(struct dir_private_info *p);
 
+/* dircache.c */
+enum {
+	EXT4_DIRCACHE_MISS,
+	EXT4_DIRCACHE_POSITIVE,
+	EXT4_DIRCACHE_NEGATIVE,
+};
+extern int ext4_dircache_lookup(struct inode *dir, const struct qstr *d_name,
+				ext4_lblk_t *block, unsigned int *gen);
+extern void ext4_dircache_add_block(struct inode *dir,
+				    struct dx_hash_info *hinfo,
+				    struct buffer_head *bh, ext4_lblk_t block);
+extern void ext4_dircache_add_negative(struct inode *dir,
+				       const struct qstr *d_name,
+				       struct dx_hash_info *hinfo,
+				       unsigned int gen);
+extern void ext4_dircache_insert(struct inode *dir, const char *name,
+				 int len);
+extern void ext4_dircache_remove(struct inode *dir, const char *name,
+				 int len);
+extern void ext4_dircache_free(struct inode *dir);
+
 /* fsync.c */
 extern int ext4_sync_file(struct file *, loff_t, loff_t, int);
 extern int ext4_flush_completed_IO(struct inode *);
@@ -134,6 +134,14 @@
  * the smallest multiple of the stripe value (sbi->s_stripe) which is
  * greater than the default mb_group_prealloc.
  *
+ * On flash (eMMC/SD) the unit that matters is the erase block rather
+ * than the RAID stripe. Mounting with erase_blk=<value> makes mballoc use
+ * that value in place of s_stripe for every alignment decision above,
+ * and additionally trims large normalized requests down to a whole
+ * number of erase blocks, so that streaming writes start and end on
+ * erase block boundaries. How well that works is reported by
+ * /sys/fs/ext4/<partition>/mb_erase_aligned and mb_erase_misaligned.
+ *
  * The regular allocator (using the buddy cache) supports a few tunables.
  *
  * /sys/fs/ext4/<partition>/mb_min_to_scan
@@ -1703,6 +1711,15 @@ int ext4_mb_try_best_found(struct ext4_allocation_context *ac,
 	return 0;
 }
 
+/*
+ * Alignment unit for the stripe-aware paths: the flash erase block if one
+ * was given at mount time, the RAID stripe otherwise.
+ */
+static inline unsigned long ext4_mb_align_unit(struct ext4_sb_info *sbi)
+{
+	return sbi->s_erase_blk ? sbi->s_erase_blk : sbi->s_stripe;
+}
+
 static noinline_for_stack
 int ext4_mb_find_by_goal(struct ext4_allocation_context *ac,
 				struct ext4_buddy *e4b)
@@ -1724,13 +1741,14 @@ int ext4_mb_find_by_goal(struct ext4_allocation_context *ac,
 	max = mb_find_extent(e4b, 0, ac->ac_g_ex.fe_start,
 			     ac->ac_g_ex.fe_len, &ex);
 
-	if (max >= ac->ac_g_ex.fe_len && ac->ac_g_ex.fe_len == sbi->s_stripe) {
+	if (max >= ac->ac_g_ex.fe_len &&
+	    ac->ac_g_ex.fe_len == ext4_mb_align_unit(sbi)) {
 		ext4_fsblk_t start;
 
 		start = ext4_group_first_block_no(ac->ac_sb, e4b->bd_group) +
 			ex.fe_start;
 		/* use do_div to get remainder (would be 64-bit modulo) */
-		if (do_div(start, sbi->s_stripe) == 0) {
+		if (do_div(start, ext4_mb_align_unit(sbi)) == 0) {
 			ac->ac_found++;
 			ac->ac_b_ex = ex;
 			ext4_mb_use_best_found(ac, e4b);
@@ -1874,30 +1892,31 @@ void ext4_mb_scan_aligned(struct ext4_allocation_context *ac,
 	void *bitmap = EXT4_MB_BITMAP(e4b);
 	struct ext4_free_extent ex;
 	ext4_fsblk_t first_group_block;
+	unsigned long stripe = ext4_mb_align_unit(sbi);
 	ext4_fsblk_t a;
 	ext4_grpblk_t i;
 	int max;
 
-	BUG_ON(sbi->s_stripe == 0);
+	BUG_ON(stripe == 0);
 
 	/* find first stripe-aligned block in group */
 	first_group_block = ext4_group_first_block_no(sb, e4b->bd_group);
 
-	a = first_group_block + sbi->s_stripe - 1;
-	do_div(a, sbi->s_stripe);
-	i = (a * sbi->s_stripe) - first_group_block;
+	a = first_group_block + stripe - 1;
+	do_div(a, stripe);
+	i = (a * stripe) - first_group_block;
 
 	while (i < EXT4_BLOCKS_PER_GROUP(sb)) {
 		if (!mb_test_bit(i, bitmap)) {
-			max = mb_find_extent(e4b, 0, i, sbi->s_stripe, &ex);
-			if (max >= sbi->s_stripe) {
+			max = mb_find_extent(e4b, 0, i, stripe, &ex);
+			if (max >= stripe) {
 				ac->ac_found++;
 				ac->ac_b_ex = ex;
 				ext4_mb_use_best_found(ac, e4b);
 				break;
 			}
 		}
-		i += sbi->s_stripe;
+		i += stripe;
 	}
 }
 
@@ -2054,8 +2073,9 @@ repeat:
 			ac->ac_groups_scanned++;
 			if (cr == 0)
 				ext4_mb_simple_scan_group(ac, &e4b);
-			else if (cr == 1 && sbi->s_stripe &&
-					!(ac->ac_g_ex.fe_len % sbi->s_stripe))
+			else if (cr == 1 && ext4_mb_align_unit(sbi) &&
+				 !(ac->ac_g_ex.fe_len %
+				   ext4_mb_align_unit(sbi)))
 				ext4_mb_scan_aligned(ac, &e4b);
 			else
 				ext4_mb_complex_scan_group(ac, &e4b);
@@ -2480,11 +2500,12 @@ int ext4_mb_init(struct super_block *sb, int needs_recovery)
 	 * the s_mb_group_prealloc as determined above. We want
 	 * the preallocation size to be an exact multiple of the
 	 * RAID stripe size so that preallocations don't fragment
-	 * the stripes.
+	 * the stripes. An erase_blk= mount option takes the place
+	 * of the stripe here.
 	 */
-	if (sbi->s_stripe > 1) {
+	if (ext4_mb_align_unit(sbi) > 1) {
 		sbi->s_mb_group_prealloc = roundup(
-			sbi->s_mb_group_prealloc, sbi->s_stripe);
+			sbi->s_mb_group_prealloc, ext4_mb_align_unit(sbi));
 	}
 
 	sbi->s_locality_groups = alloc_percpu(struct ext4_locality_group);
@@ -2592,6 +2613,11 @@ int ext4_mb_release(struct super_block *sb)
 		       "mballoc: %u preallocated, %u discarded",
 				atomic_read(&sbi->s_mb_preallocated),
 				atomic_read(&sbi->s_mb_discarded));
+		if (sbi->s_erase_blk)
+			ext4_msg(sb, KERN_INFO,
+			       "mballoc: %u erase block aligned, %u misaligned",
+				atomic_read(&sbi->s_bal_erase_aligned),
+				atomic_read(&sbi->s_bal_erase_misaligned));
 	}
 
 	free_percpu(sbi->s_locality_groups);
@@ -2890,6 +2916,7 @@ ext4_mb_normalize_request(struct ext4_allocation_context *ac,
 	ext4_lblk_t end;
 	loff_t size, orig_size, start_off;
 	ext4_lblk_t start;
+	struct ext4_sb_info *sbi = EXT4_SB(ac->ac_sb);
 	struct ext4_inode_info *ei = EXT4_I(ac->ac_inode);
 	struct ext4_prealloc_space *pa;
 
@@ -3038,6 +3065,22 @@ ext4_mb_normalize_request(struct ext4_allocation_context *ac,
 			start > ac->ac_o_ex.fe_logical);
 	BUG_ON(size <= 0 || size > EXT4_BLOCKS_PER_GROUP(ac->ac_sb));
 
+	/*
+	 * On flash, trim a large request to whole erase blocks so the
+	 * allocation found by ext4_mb_scan_aligned() does not spill into a
+	 * partially used erase block. Only do it if the trimmed request
+	 * still covers the original one.
+	 */
+	if (sbi->s_erase_blk && size >= sbi->s_erase_blk) {
+		/* size fits in a group here, so no 64-bit division */
+		unsigned long trimmed = (unsigned long) size -
+			(unsigned long) size % sbi->s_erase_blk;
+
+		if (start + trimmed >=
+		    ac->ac_o_ex.fe_logical + ac->ac_o_ex.fe_len)
+			size = trimmed;
+	}
+
 	/* now prepare goal request */
 
 	/* XXX: is it better to align blocks WRT to logical
@@ -3082,6 +3125,18 @@ static void ext4_mb_collect_stats(struct ext4_allocation_context *ac)
 			atomic_inc(&sbi->s_bal_breaks);
 	}
 
+	if (sbi->s_erase_blk && ac->ac_op == EXT4_MB_HISTORY_ALLOC &&
+	    ac->ac_status == AC_STATUS_FOUND &&
+	    ac->ac_g_ex.fe_len >= sbi->s_erase_blk) {
+		ext4_fsblk_t start = ext4_grp_offs_to_block(ac->ac_sb,
+							    &ac->ac_b_ex);
+
+		if (do_div(start, sbi->s_erase_blk) == 0)
+			atomic_inc(&sbi->s_bal_erase_aligned);
+		else
+			atomic_inc(&sbi->s_bal_erase_misaligned);
+	}
+
 	if (ac->ac_op == EXT4_MB_HISTORY_ALLOC)
 		trace_ext4_mballoc_alloc(ac);
 	else
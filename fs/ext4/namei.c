@@ -970,18 +970,61 @@ cleanup_and_exit:
 	return ret;
 }
 
+/*
+ * Try the htree lookup cache before walking the index. Returns the leaf
+ * buffer if a cached hint led to the entry, NULL with *err == -ENOENT if
+ * the name is cached as absent, and NULL with *err == 0 if the index has
+ * to be walked.
+ */
+static struct buffer_head *ext4_dx_cached_entry(struct inode *dir,
+					const struct qstr *d_name,
+					struct ext4_dir_entry_2 **res_dir,
+					unsigned int *gen, int *err)
+{
+	struct buffer_head *bh;
+	ext4_lblk_t block;
+
+	*err = 0;
+	switch (ext4_dircache_lookup(dir, d_name, &block, gen)) {
+	case EXT4_DIRCACHE_NEGATIVE:
+		*err = -ENOENT;
+		return NULL;
+	case EXT4_DIRCACHE_POSITIVE:
+		bh = ext4_bread(NULL, dir, block, 0, err);
+		*err = 0;
+		if (!bh)
+			break;
+		if (search_dirblock(bh, dir, d_name,
+				    block << EXT4_BLOCK_SIZE_BITS(dir->i_sb),
+				    res_dir) == 1)
+			return bh;
+		brelse(bh);
+		/* stale hint: the entry moved or went away */
+		ext4_dircache_remove(dir, d_name->name, d_name->len);
+		break;
+	}
+	return NULL;
+}
+
 static struct buffer_head * ext4_dx_find_entry(struct inode *dir, const struct qstr *d_name,
 		       struct ext4_dir_entry_2 **res_dir, int *err)
 {
 	struct super_block * sb = dir->i_sb;
+	struct ext4_sb_info *sbi = EXT4_SB(sb);
 	struct dx_hash_info	hinfo;
 	struct dx_frame frames[2], *frame;
 	struct buffer_head *bh;
 	ext4_lblk_t block;
+	unsigned int gen;
+	ktime_t start = ktime_get();
 	int retval;
 
+	bh = ext4_dx_cached_entry(dir, d_name, res_dir, &gen, err);
+	if (bh || *err)
+		goto out;
+
 	if (!(frame = dx_probe(d_name, dir, &hinfo, frames, err)))
-		return NULL;
+		goto out;
 	do {
 		block = dx_get_block(frame->at);
 		if (!(bh = ext4_bread(NULL, dir, block, 0, err)))
@@ -991,9 +1034,12 @@ static struct buffer_head * ext4_dx_find_entry(struct inode *dir, const struct q
 					 block << EXT4_BLOCK_SIZE_BITS(sb),
 					 res_dir);
 		if (retval == 1) { 	/* Success! */
+			ext4_dircache_add_block(dir, &hinfo, bh, block);
 			dx_release(frames);
-			return bh;
+			goto out;
 		}
+		if (retval == 0)
+			ext4_dircache_add_block(dir, &hinfo, bh, block);
 		brelse(bh);
 		if (retval == -1) {
 			*err = ERR_BAD_DX_DIR;
@@ -1013,10 +1059,16 @@ static struct buffer_head * ext4_dx_find_entry(struct inode *dir, const struct q
 	} while (retval == 1);
 
 	*err = -ENOENT;
+	ext4_dircache_add_negative(dir, d_name, &hinfo, gen);
 errout:
 	dxtrace(printk(KERN_DEBUG "%s not found\n", d_name->name));
 	dx_release (frames);
-	return NULL;
+	bh = NULL;
+out:
+	atomic_inc(&sbi->s_dx_lookups);
+	atomic64_add(ktime_to_ns(ktime_sub(ktime_get(), start)),
+		     &sbi->s_dx_lookup_ns);
+	return bh;
 }
 
 static struct dentry *ext4_lookup(struct inode *dir, struct dentry *dentry, struct nameidata *nd)
@@ -1305,6 +1357,7 @@ static int add_dirent_to_buf(handle_t *handle, struct dentry *dentry,
 		de->inode = 0;
 	de->name_len = namelen;
 	memcpy(de->name, name, namelen);
+	ext4_dircache_insert(dir, name, namelen);
 	/*
 	 * XXX shouldn't update any times until successful
 	 * completion of syscall, but too many callers depend
@@ -1378,6 +1431,7 @@ static int make_indexed_dir(handle_t *handle, struct dentry *dentry,
 		return retval;
 	}
 	ext4_set_inode_flag(dir, EXT4_INODE_INDEX);
+	ext4_dircache_free(dir);
 	data1 = bh2->b_data;
 
 	memcpy (data1, de, len);
@@ -1463,6 +1517,7 @@ static int ext4_add_entry(handle_t *handle, struct dentry *dentry,
 		if (!retval || (retval != ERR_BAD_DX_DIR))
 			return retval;
 		ext4_clear_inode_flag(dir, EXT4_INODE_INDEX);
+		ext4_dircache_free(dir);
 		dx_fallback++;
 		ext4_mark_inode_dirty(handle, dir);
 	}
@@ -1659,6 +1714,7 @@ static int ext4_delete_entry(handle_t *handle,
 				ext4_std_error(dir->i_sb, err);
 				return err;
 			}
+			ext4_dircache_remove(dir, de->name, de->name_len);
 			if (pde)
 				pde->rec_len = ext4_rec_len_to_disk(
 					ext4_rec_len_from_disk(pde->rec_len,
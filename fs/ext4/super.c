@@ -880,6 +880,7 @@ static struct inode *ext4_alloc_inode(struct super_block *sb)
 	ei->vfs_inode.i_version = 1;
 	ei->vfs_inode.i_data.writeback_index = 0;
 	memset(&ei->i_cached_extent, 0, sizeof(struct ext4_ext_cache));
+	ei->i_dircache = NULL;
 	INIT_LIST_HEAD(&ei->i_prealloc_list);
 	spin_lock_init(&ei->i_prealloc_lock);
 	ei->i_reserved_data_blocks = 0;
@@ -966,6 +967,7 @@ void ext4_clear_inode(struct inode *inode)
 	end_writeback(inode);
 	dquot_drop(inode);
 	ext4_discard_preallocations(inode);
+	ext4_dircache_free(inode);
 	if (EXT4_I(inode)->jinode) {
 		jbd2_journal_release_jbd_inode(EXT4_JOURNAL(inode),
 					       EXT4_I(inode)->jinode);
@@ -1105,6 +1107,8 @@ static int ext4_show_options(struct seq_file *seq, struct vfsmount *vfs)
 		seq_puts(seq, ",nomblk_io_submit");
 	if (sbi->s_stripe)
 		seq_printf(seq, ",stripe=%lu", sbi->s_stripe);
+	if (sbi->s_erase_blk)
+		seq_printf(seq, ",erase_blk=%lu", sbi->s_erase_blk);
 	/*
 	 * journal mode get enabled in different ways
 	 * So just print the value even if we didn't specify it
@@ -1314,7 +1318,8 @@ enum {
 	Opt_jqfmt_vfsold, Opt_jqfmt_vfsv0, Opt_jqfmt_vfsv1, Opt_quota,
 	Opt_noquota, Opt_ignore, Opt_barrier, Opt_nobarrier, Opt_err,
 	Opt_resize, Opt_usrquota, Opt_grpquota, Opt_i_version,
-	Opt_stripe, Opt_delalloc, Opt_nodelalloc, Opt_mblk_io_submit,
+	Opt_stripe, Opt_erase_blk, Opt_delalloc, Opt_nodelalloc,
+	Opt_mblk_io_submit,
 	Opt_nomblk_io_submit, Opt_block_validity, Opt_noblock_validity,
 	Opt_inode_readahead_blks, Opt_journal_ioprio,
 	Opt_dioread_nolock, Opt_dioread_lock,
@@ -1375,6 +1380,7 @@ static const match_table_t tokens = {
 	{Opt_nobarrier, "nobarrier"},
 	{Opt_i_version, "i_version"},
 	{Opt_stripe, "stripe=%u"},
+	{Opt_erase_blk, "erase_blk=%u"},
 	{Opt_resize, "resize"},
 	{Opt_delalloc, "delalloc"},
 	{Opt_nodelalloc, "nodelalloc"},
@@ -1814,6 +1820,21 @@ set_qf_format:
 				return 0;
 			sbi->s_stripe = option;
 			break;
+		case Opt_erase_blk:
+			if (match_int(&args[0], &option))
+				return 0;
+			if (option < 0)
+				return 0;
+			/* on first mount this is checked in ext4_fill_super */
+			if (sbi->s_blocks_per_group &&
+			    option > sbi->s_blocks_per_group) {
+				ext4_msg(sb, KERN_ERR,
+					 "erase_blk=%d larger than a group",
+					 option);
+				return 0;
+			}
+			sbi->s_erase_blk = option > 1 ? option : 0;
+			break;
 		case Opt_delalloc:
 			set_opt(sb, DELALLOC);
 			break;
@@ -2492,6 +2513,62 @@ static ssize_t extent_cache_misses_show(struct ext4_attr *a,
 	return snprintf(buf, PAGE_SIZE, "%lu\n", sbi->extent_cache_misses);
 }
 
+static ssize_t mb_erase_aligned_show(struct ext4_attr *a,
+				     struct ext4_sb_info *sbi, char *buf)
+{
+	return snprintf(buf, PAGE_SIZE, "%u\n",
+			atomic_read(&sbi->s_bal_erase_aligned));
+}
+
+static ssize_t mb_erase_misaligned_show(struct ext4_attr *a,
+					struct ext4_sb_info *sbi, char *buf)
+{
+	return snprintf(buf, PAGE_SIZE, "%u\n",
+			atomic_read(&sbi->s_bal_erase_misaligned));
+}
+
+static ssize_t dir_cache_hits_show(struct ext4_attr *a,
+				   struct ext4_sb_info *sbi, char *buf)
+{
+	return snprintf(buf, PAGE_SIZE, "%u\n",
+			atomic_read(&sbi->s_dir_cache_hits));
+}
+
+static ssize_t dir_cache_negative_hits_show(struct ext4_attr *a,
+					    struct ext4_sb_info *sbi, char *buf)
+{
+	return snprintf(buf, PAGE_SIZE, "%u\n",
+			atomic_read(&sbi->s_dir_cache_neg_hits));
+}
+
+static ssize_t dir_cache_misses_show(struct ext4_attr *a,
+				     struct ext4_sb_info *sbi, char *buf)
+{
+	return snprintf(buf, PAGE_SIZE, "%u\n",
+			atomic_read(&sbi->s_dir_cache_misses));
+}
+
+static ssize_t dir_cache_bytes_show(struct ext4_attr *a,
+				    struct ext4_sb_info *sbi, char *buf)
+{
+	return snprintf(buf, PAGE_SIZE, "%ld\n",
+			atomic_long_read(&sbi->s_dir_cache_bytes));
+}
+
+static ssize_t dx_lookups_show(struct ext4_attr *a,
+			       struct ext4_sb_info *sbi, char *buf)
+{
+	return snprintf(buf, PAGE_SIZE, "%u\n",
+			atomic_read(&sbi->s_dx_lookups));
+}
+
+static ssize_t dx_lookup_ns_show(struct ext4_attr *a,
+				 struct ext4_sb_info *sbi, char *buf)
+{
+	return snprintf(buf, PAGE_SIZE, "%llu\n", (unsigned long long)
+			atomic64_read(&sbi->s_dx_lookup_ns));
+}
+
 static ssize_t inode_readahead_blks_store(struct ext4_attr *a,
 					  struct ext4_sb_info *sbi,
 					  const char *buf, size_t count)
@@ -2551,6 +2628,14 @@ EXT4_RO_ATTR(session_write_kbytes);
 EXT4_RO_ATTR(lifetime_write_kbytes);
 EXT4_RO_ATTR(extent_cache_hits);
 EXT4_RO_ATTR(extent_cache_misses);
+EXT4_RO_ATTR(mb_erase_aligned);
+EXT4_RO_ATTR(mb_erase_misaligned);
+EXT4_RO_ATTR(dir_cache_hits);
+EXT4_RO_ATTR(dir_cache_negative_hits);
+EXT4_RO_ATTR(dir_cache_misses);
+EXT4_RO_ATTR(dir_cache_bytes);
+EXT4_RO_ATTR(dx_lookups);
+EXT4_RO_ATTR(dx_lookup_ns);
 EXT4_ATTR_OFFSET(inode_readahead_blks, 0644, sbi_ui_show,
 		 inode_readahead_blks_store, s_inode_readahead_blks);
 EXT4_RW_ATTR_SBI_UI(inode_goal, s_inode_goal);
@@ -2561,6 +2646,7 @@ EXT4_RW_ATTR_SBI_UI(mb_order2_req, s_mb_order2_reqs);
 EXT4_RW_ATTR_SBI_UI(mb_stream_req, s_mb_stream_request);
 EXT4_RW_ATTR_SBI_UI(mb_group_prealloc, s_mb_group_prealloc);
 EXT4_RW_ATTR_SBI_UI(max_writeback_mb_bump, s_max_writeback_mb_bump);
+EXT4_RW_ATTR_SBI_UI(dir_cache_max, s_dir_cache_max);
 
 static struct attribute *ext4_attrs[] = {
 	ATTR_LIST(delayed_allocation_blocks),
@@ -2576,7 +2662,16 @@ static struct attribute *ext4_attrs[] = {
 	ATTR_LIST(mb_order2_req),
 	ATTR_LIST(mb_stream_req),
 	ATTR_LIST(mb_group_prealloc),
+	ATTR_LIST(mb_erase_aligned),
+	ATTR_LIST(mb_erase_misaligned),
 	ATTR_LIST(max_writeback_mb_bump),
+	ATTR_LIST(dir_cache_max),
+	ATTR_LIST(dir_cache_hits),
+	ATTR_LIST(dir_cache_negative_hits),
+	ATTR_LIST(dir_cache_misses),
+	ATTR_LIST(dir_cache_bytes),
+	ATTR_LIST(dx_lookups),
+	ATTR_LIST(dx_lookup_ns),
 	NULL,
 };
 
@@ -3500,7 +3595,14 @@ static int ext4_fill_super(struct super_block *sb, void *data, int silent)
 	}
 
 	sbi->s_stripe = ext4_get_stripe_size(sbi);
+	if (sbi->s_erase_blk > sbi->s_blocks_per_group) {
+		ext4_msg(sb, KERN_WARNING,
+			 "erase_blk=%lu larger than a group, ignored",
+			 sbi->s_erase_blk);
+		sbi->s_erase_blk = 0;
+	}
 	sbi->s_max_writeback_mb_bump = 128;
+	sbi->s_dir_cache_max = 2048;
 
 	/*
 	 * set up enough so that it can read an inode
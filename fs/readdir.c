@@ -14,6 +14,10 @@
 #include <linux/file.h>
 #include <linux/fs.h>
 #include <linux/dirent.h>
+#include <linux/dirent_stat.h>
+#include <linux/namei.h>
+#include <linux/mount.h>
+#include <linux/fs_struct.h>
 #include <linux/security.h>
 #include <linux/syscalls.h>
 #include <linux/unistd.h>
@@ -309,3 +313,197 @@ SYSCALL_DEFINE3(getdents64, unsigned int, fd,
 out:
 	return error;
 }
+
+/*
+ * getdents_stat: getdents64 plus the attributes of every entry, for
+ * scanners that would otherwise stat() each name after reading it.
+ *
+ * Entries are gathered a page at a time with vfs_readdir() into a kernel
+ * buffer laid out like the user one. The attributes are filled in once
+ * ->readdir() has returned and the directory i_mutex has been dropped,
+ * so that ->lookup() is never called from inside a filesystem's
+ * ->readdir(). Each name is looked up relative to the directory dentry,
+ * which is much cheaper than the full path walk of a stat() call, and
+ * the page is then copied out in one go.
+ */
+struct getdents_stat_callback {
+	char *buf;
+	int used;
+	int size;
+	struct linux_dirent_stat *previous;
+	bool full;
+};
+
+static int filldir_stat(void *__buf, const char *name, int namlen,
+			loff_t offset, u64 ino, unsigned int d_type)
+{
+	struct getdents_stat_callback *buf = __buf;
+	struct linux_dirent_stat *dirent;
+	int reclen = ALIGN(offsetof(struct linux_dirent_stat, d_name) +
+			   namlen + 1, sizeof(u64));
+
+	if (buf->used + reclen > buf->size) {
+		buf->full = true;
+		return -EINVAL;
+	}
+	if (buf->previous)
+		buf->previous->d_off = offset;
+	dirent = (struct linux_dirent_stat *)(buf->buf + buf->used);
+	/* the padding after the name is copied out too */
+	memset(dirent, 0, reclen);
+	dirent->d_ino = ino;
+	dirent->d_reclen = reclen;
+	dirent->d_type = d_type;
+	memcpy(dirent->d_name, name, namlen);
+	dirent->d_name[namlen] = 0;
+	buf->previous = dirent;
+	buf->used += reclen;
+	return 0;
+}
+
+/* the path ".." refers to, with the same rules as a path walk */
+static void getdents_stat_dotdot(struct path *path)
+{
+	struct path root;
+
+	get_fs_root(current->fs, &root);
+	while (!path_equal(path, &root)) {
+		if (path->dentry != path->mnt->mnt_root) {
+			struct dentry *parent = dget_parent(path->dentry);
+
+			dput(path->dentry);
+			path->dentry = parent;
+			break;
+		}
+		if (!follow_up(path))
+			break;
+	}
+	path_put(&root);
+}
+
+static int getdents_stat_one(struct file *file, struct linux_dirent_stat *de)
+{
+	struct dentry *dir = file->f_path.dentry;
+	int namlen = strlen(de->d_name);
+	struct path path;
+	struct kstat stat;
+	int error;
+
+	path = file->f_path;
+	path_get(&path);
+	if (namlen == 2 && de->d_name[0] == '.' && de->d_name[1] == '.') {
+		getdents_stat_dotdot(&path);
+	} else if (namlen != 1 || de->d_name[0] != '.') {
+		struct dentry *dentry;
+
+		mutex_lock(&dir->d_inode->i_mutex);
+		dentry = lookup_one_len(de->d_name, dir, namlen);
+		mutex_unlock(&dir->d_inode->i_mutex);
+		if (IS_ERR(dentry)) {
+			error = PTR_ERR(dentry);
+			goto out;
+		}
+		dput(path.dentry);
+		path.dentry = dentry;
+		error = -ENOENT;
+		if (!dentry->d_inode)
+			goto out;
+	}
+	while (d_mountpoint(path.dentry) && follow_down_one(&path))
+		;
+
+	error = vfs_getattr(path.mnt, path.dentry, &stat);
+	if (error)
+		goto out;
+
+	de->d_stat.st_dev = new_encode_dev(stat.dev);
+	de->d_stat.st_ino = stat.ino;
+	de->d_stat.st_rdev = new_encode_dev(stat.rdev);
+	de->d_stat.st_size = stat.size;
+	de->d_stat.st_blocks = stat.blocks;
+	de->d_stat.st_atime_sec = stat.atime.tv_sec;
+	de->d_stat.st_mtime_sec = stat.mtime.tv_sec;
+	de->d_stat.st_ctime_sec = stat.ctime.tv_sec;
+	de->d_stat.st_atime_nsec = stat.atime.tv_nsec;
+	de->d_stat.st_mtime_nsec = stat.mtime.tv_nsec;
+	de->d_stat.st_ctime_nsec = stat.ctime.tv_nsec;
+	de->d_stat.st_mode = stat.mode;
+	de->d_stat.st_nlink = stat.nlink;
+	de->d_stat.st_uid = stat.uid;
+	de->d_stat.st_gid = stat.gid;
+	de->d_stat.st_blksize = stat.blksize;
+	if (de->d_type == DT_UNKNOWN)
+		de->d_type = (stat.mode & S_IFMT) >> 12;
+out:
+	path_put(&path);
+	return error;
+}
+
+SYSCALL_DEFINE4(getdents_stat, unsigned int, fd,
+		struct linux_dirent_stat __user *, dirent, unsigned int, count,
+		unsigned int, flags)
+{
+	struct getdents_stat_callback buf;
+	struct file *file;
+	unsigned int copied = 0;
+	int error;
+
+	if (flags)
+		return -EINVAL;
+	if (!access_ok(VERIFY_WRITE, dirent, count))
+		return -EFAULT;
+
+	file = fget(fd);
+	if (!file)
+		return -EBADF;
+
+	error = -ENOMEM;
+	buf.buf = (char *)__get_free_page(GFP_KERNEL);
+	if (!buf.buf)
+		goto out_fput;
+
+	do {
+		int pos;
+
+		buf.used = 0;
+		buf.size = min_t(unsigned int, count - copied, PAGE_SIZE);
+		buf.previous = NULL;
+		buf.full = false;
+
+		error = vfs_readdir(file, filldir_stat, &buf);
+		if (error < 0)
+			break;
+		if (!buf.previous) {
+			/* not even one entry fits in what is left */
+			error = (buf.full && !copied) ? -EINVAL : 0;
+			break;
+		}
+		buf.previous->d_off = file->f_pos;
+
+		for (pos = 0; pos < buf.used; ) {
+			struct linux_dirent_stat *de =
+				(struct linux_dirent_stat *)(buf.buf + pos);
+
+			de->d_stat_err = getdents_stat_one(file, de);
+			pos += de->d_reclen;
+		}
+
+		if (copy_to_user((char __user *)dirent + copied, buf.buf,
+				 buf.used)) {
+			error = -EFAULT;
+			break;
+		}
+		copied += buf.used;
+		error = 0;
+
+		if (fatal_signal_pending(current))
+			break;
+	} while (buf.full && copied < count);
+
+	free_page((unsigned long)buf.buf);
+out_fput:
+	fput(file);
+	if (copied && error != -EFAULT)
+		return copied;
+	return error;
+}
@@ -25,6 +25,9 @@
 #include <linux/mutex.h>
 #include <linux/slab.h>
 #include <linux/buffer_head.h>
+#include <linux/list.h>
+#include <linux/sched.h>
+#include <linux/wait.h>
 
 #include "squashfs_fs.h"
 #include "squashfs_fs_sb.h"
@@ -33,7 +36,8 @@
 
 /*
  * This file (and decompressor.h) implements a decompressor framework for
- * Squashfs, allowing multiple decompressors to be easily supported
+ * Squashfs, allowing multiple decompressors to be easily supported, and
+ * the pool of decompressor streams shared by a mounted filesystem
  */
 
 static const struct squashfs_decompressor squashfs_lzma_unsupported_comp_ops = {
@@ -46,6 +50,12 @@ static const struct squashfs_decompressor squashfs_lzo_comp_ops = {
 };
 #endif
 
+#ifndef CONFIG_SQUASHFS_LZ4
+static const struct squashfs_decompressor squashfs_lz4_comp_ops = {
+	NULL, NULL, NULL, LZ4_COMPRESSION, "lz4", 0
+};
+#endif
+
 #ifndef CONFIG_SQUASHFS_XZ
 static const struct squashfs_decompressor squashfs_xz_comp_ops = {
 	NULL, NULL, NULL, XZ_COMPRESSION, "xz", 0
@@ -66,6 +76,7 @@ static const struct squashfs_decompressor *decompressor[] = {
 	&squashfs_zlib_comp_ops,
 	&squashfs_lzo_comp_ops,
 	&squashfs_xz_comp_ops,
+	&squashfs_lz4_comp_ops,
 	&squashfs_lzma_unsupported_comp_ops,
 	&squashfs_unknown_comp_ops
 };
@@ -83,34 +94,187 @@ const struct squashfs_decompressor *squashfs_lookup_decompressor(int id)
 }
 
 
-void *squashfs_decompressor_init(struct super_block *sb, unsigned short flags)
+struct decomp_stream {
+	void			*stream;
+	struct list_head	list;
+};
+
+
+static struct decomp_stream *decomp_stream_alloc(
+	struct squashfs_sb_info *msblk, struct squashfs_stream *pool)
+{
+	struct decomp_stream *decomp;
+
+	decomp = kmalloc(sizeof(*decomp), GFP_KERNEL);
+	if (decomp == NULL)
+		return ERR_PTR(-ENOMEM);
+
+	decomp->stream = msblk->decompressor->init(msblk, pool->comp_opts,
+		pool->comp_opts_len);
+	if (IS_ERR(decomp->stream)) {
+		int err = PTR_ERR(decomp->stream);
+
+		kfree(decomp);
+		return ERR_PTR(err);
+	}
+
+	return decomp;
+}
+
+
+static void decomp_stream_free(struct squashfs_sb_info *msblk,
+	struct decomp_stream *decomp)
+{
+	msblk->decompressor->free(decomp->stream);
+	kfree(decomp);
+}
+
+
+/*
+ * Take a free stream from the pool, creating one if the pool is below
+ * its limit, otherwise wait for another reader to release one.  If a new
+ * stream cannot be allocated the reader waits for an existing one, and
+ * only fails if there are none.
+ */
+static struct decomp_stream *get_decomp_stream(struct squashfs_sb_info *msblk,
+	struct squashfs_stream *pool)
+{
+	struct decomp_stream *decomp;
+
+	mutex_lock(&pool->mutex);
+	while (list_empty(&pool->free_list)) {
+		if (pool->nr_streams < pool->max_streams) {
+			decomp = decomp_stream_alloc(msblk, pool);
+			if (!IS_ERR(decomp)) {
+				pool->nr_streams++;
+				mutex_unlock(&pool->mutex);
+				return decomp;
+			}
+			if (pool->nr_streams == 0) {
+				mutex_unlock(&pool->mutex);
+				return decomp;
+			}
+		}
+
+		mutex_unlock(&pool->mutex);
+		wait_event(pool->wait, !list_empty(&pool->free_list));
+		mutex_lock(&pool->mutex);
+	}
+
+	decomp = list_entry(pool->free_list.next, struct decomp_stream, list);
+	list_del(&decomp->list);
+	mutex_unlock(&pool->mutex);
+
+	return decomp;
+}
+
+
+static void put_decomp_stream(struct squashfs_stream *pool,
+	struct decomp_stream *decomp)
+{
+	mutex_lock(&pool->mutex);
+	list_add(&decomp->list, &pool->free_list);
+	mutex_unlock(&pool->mutex);
+	wake_up(&pool->wait);
+}
+
+
+int squashfs_decompress(struct squashfs_sb_info *msblk, void **buffer,
+	struct buffer_head **bh, int b, int offset, int length, int srclength,
+	int pages)
+{
+	struct squashfs_stream *pool = msblk->stream;
+	struct decomp_stream *decomp;
+	int res, k;
+
+	decomp = get_decomp_stream(msblk, pool);
+	if (IS_ERR(decomp)) {
+		for (k = 0; k < b; k++)
+			put_bh(bh[k]);
+		return PTR_ERR(decomp);
+	}
+
+	res = msblk->decompressor->decompress(msblk, decomp->stream, buffer,
+		bh, b, offset, length, srclength, pages);
+
+	put_decomp_stream(pool, decomp);
+
+	return res;
+}
+
+
+struct squashfs_stream *squashfs_decompressor_create(struct super_block *sb,
+	unsigned short flags, int max_streams)
 {
 	struct squashfs_sb_info *msblk = sb->s_fs_info;
-	void *strm, *buffer = NULL;
-	int length = 0;
+	struct squashfs_stream *pool;
+	struct decomp_stream *decomp;
+	int err;
+
+	pool = kzalloc(sizeof(*pool), GFP_KERNEL);
+	if (pool == NULL)
+		return ERR_PTR(-ENOMEM);
+
+	mutex_init(&pool->mutex);
+	INIT_LIST_HEAD(&pool->free_list);
+	init_waitqueue_head(&pool->wait);
+	pool->max_streams = max_streams;
 
 	/*
-	 * Read decompressor specific options from file system if present
+	 * Read decompressor specific options from file system if present.
+	 * They are kept for creating further streams.
 	 */
 	if (SQUASHFS_COMP_OPTS(flags)) {
-		buffer = kmalloc(PAGE_CACHE_SIZE, GFP_KERNEL);
-		if (buffer == NULL)
-			return ERR_PTR(-ENOMEM);
+		pool->comp_opts = kmalloc(PAGE_CACHE_SIZE, GFP_KERNEL);
+		if (pool->comp_opts == NULL) {
+			err = -ENOMEM;
+			goto failed;
+		}
 
-		length = squashfs_read_data(sb, &buffer,
+		pool->comp_opts_len = squashfs_read_data(sb, &pool->comp_opts,
 			sizeof(struct squashfs_super_block), 0, NULL,
 			PAGE_CACHE_SIZE, 1);
 
-		if (length < 0) {
-			strm = ERR_PTR(length);
-			goto finished;
+		if (pool->comp_opts_len < 0) {
+			err = pool->comp_opts_len;
+			goto failed;
 		}
 	}
 
-	strm = msblk->decompressor->init(msblk, buffer, length);
+	/*
+	 * Always create the first stream now, so that bad compressor
+	 * options fail the mount rather than the first read.
+	 */
+	decomp = decomp_stream_alloc(msblk, pool);
+	if (IS_ERR(decomp)) {
+		err = PTR_ERR(decomp);
+		goto failed;
+	}
+	list_add(&decomp->list, &pool->free_list);
+	pool->nr_streams = 1;
+
+	return pool;
 
-finished:
-	kfree(buffer);
+failed:
+	kfree(pool->comp_opts);
+	kfree(pool);
+	return ERR_PTR(err);
+}
+
+
+void squashfs_decompressor_destroy(struct squashfs_sb_info *msblk)
+{
+	struct squashfs_stream *pool = msblk->stream;
+	struct decomp_stream *decomp, *next;
 
-	return strm;
+	if (pool == NULL)
+		return;
+
+	list_for_each_entry_safe(decomp, next, &pool->free_list, list) {
+		list_del(&decomp->list);
+		decomp_stream_free(msblk, decomp);
+	}
+	kfree(pool->comp_opts);
+	kfree(pool);
 }
+
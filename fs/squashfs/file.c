@@ -47,6 +47,8 @@
 #include <linux/string.h>
 #include <linux/pagemap.h>
 #include <linux/mutex.h>
+#include <linux/highmem.h>
+#include <linux/vmalloc.h>
 
 #include "squashfs_fs.h"
 #include "squashfs_fs_sb.h"
@@ -371,19 +373,210 @@ static int read_blocklist(struct inode *inode, int index, u64 *block)
 }
 
 
-static int squashfs_readpage(struct file *file, struct page *page)
+/*
+ * Copy a datablock or fragment (NULL buffer for a hole) into the pages of
+ * the block containing page.  As the datablock likely covers many
+ * PAGE_CACHE_SIZE pages (default block size is 128 KiB) explicitly grab
+ * the pages from the page cache, except for the page that we've been
+ * called to fill.
+ */
+static void squashfs_copy_cache(struct page *page,
+	struct squashfs_cache_entry *buffer, int bytes, int offset)
 {
 	struct inode *inode = page->mapping->host;
 	struct squashfs_sb_info *msblk = inode->i_sb->s_fs_info;
-	int bytes, i, offset = 0, sparse = 0;
-	struct squashfs_cache_entry *buffer = NULL;
 	void *pageaddr;
+	int i, mask = (1 << (msblk->block_log - PAGE_CACHE_SHIFT)) - 1;
+	int start_index = page->index & ~mask, end_index = start_index | mask;
+
+	for (i = start_index; i <= end_index && bytes > 0; i++,
+			bytes -= PAGE_CACHE_SIZE, offset += PAGE_CACHE_SIZE) {
+		struct page *push_page;
+		int avail = buffer ? min_t(int, bytes, PAGE_CACHE_SIZE) : 0;
+
+		TRACE("bytes %d, i %d, available_bytes %d\n", bytes, i, avail);
+
+		push_page = (i == page->index) ? page :
+			grab_cache_page_nowait(page->mapping, i);
+
+		if (!push_page)
+			continue;
+
+		if (PageUptodate(push_page))
+			goto skip_page;
+
+		pageaddr = kmap_atomic(push_page, KM_USER0);
+		squashfs_copy_data(pageaddr, buffer, offset, avail);
+		memset(pageaddr + avail, 0, PAGE_CACHE_SIZE - avail);
+		kunmap_atomic(pageaddr, KM_USER0);
+		flush_dcache_page(push_page);
+		SetPageUptodate(push_page);
+skip_page:
+		unlock_page(push_page);
+		if (i != page->index)
+			page_cache_release(push_page);
+	}
+}
+
 
+/* Read a datablock through the read_page cache */
+static int squashfs_readpage_cache(struct page *page, u64 block, int bsize)
+{
+	struct inode *inode = page->mapping->host;
+	struct squashfs_cache_entry *buffer;
+
+	buffer = squashfs_get_datablock(inode->i_sb, block, bsize);
+	if (buffer->error) {
+		ERROR("Unable to read page, block %llx, size %x\n", block,
+			bsize);
+		squashfs_cache_put(buffer);
+		return -EIO;
+	}
+
+	squashfs_copy_cache(page, buffer, buffer->length, 0);
+	squashfs_cache_put(buffer);
+	return 0;
+}
+
+
+/*
+ * Read a datablock by decompressing it straight into the page cache
+ * pages it covers, rather than into the read_page cache and copying from
+ * there.  If any of those pages is locked by someone else, or is already
+ * up to date, fall back to the read_page cache.  On success every page,
+ * including the one we were called to fill, is up to date and unlocked.
+ */
+static int squashfs_readpage_block(struct page *target_page, u64 block,
+	int bsize)
+{
+	struct inode *inode = target_page->mapping->host;
+	struct squashfs_sb_info *msblk = inode->i_sb->s_fs_info;
 	int mask = (1 << (msblk->block_log - PAGE_CACHE_SHIFT)) - 1;
-	int index = page->index >> (msblk->block_log - PAGE_CACHE_SHIFT);
-	int start_index = page->index & ~mask;
+	int start_index = target_page->index & ~mask;
 	int end_index = start_index | mask;
+	int file_end = (i_size_read(inode) - 1) >> PAGE_CACHE_SHIFT;
+	int i, pages, res = -ENOMEM, missing = 0, highmem = 0;
+	struct page **page;
+	void **pageaddr, *vaddr = NULL;
+
+	if (end_index > file_end)
+		end_index = file_end;
+	pages = end_index - start_index + 1;
+
+	page = kmalloc(pages * sizeof(*page), GFP_KERNEL);
+	pageaddr = kmalloc(pages * sizeof(*pageaddr), GFP_KERNEL);
+	if (page == NULL || pageaddr == NULL)
+		goto out;
+
+	for (i = 0; i < pages; i++) {
+		int n = start_index + i;
+
+		if (n == target_page->index) {
+			page[i] = target_page;
+			continue;
+		}
+
+		page[i] = grab_cache_page_nowait(target_page->mapping, n);
+		if (page[i] == NULL) {
+			missing++;
+			continue;
+		}
+
+		if (PageUptodate(page[i])) {
+			unlock_page(page[i]);
+			page_cache_release(page[i]);
+			page[i] = NULL;
+			missing++;
+		}
+	}
+
+	if (missing)
+		goto release_pages;
+
+	/*
+	 * Decompression may sleep, so highmem pages cannot be kmapped
+	 * atomically; map the whole block with vmap rather than taking
+	 * a persistent kmap per page.
+	 */
+	for (i = 0; i < pages; i++)
+		highmem |= PageHighMem(page[i]);
+
+	if (highmem) {
+		vaddr = vmap(page, pages, VM_MAP, PAGE_KERNEL);
+		if (vaddr == NULL)
+			goto release_pages;
+		for (i = 0; i < pages; i++)
+			pageaddr[i] = vaddr + i * PAGE_CACHE_SIZE;
+	} else {
+		for (i = 0; i < pages; i++)
+			pageaddr[i] = page_address(page[i]);
+	}
+
+	res = squashfs_read_data(inode->i_sb, pageaddr, block, bsize, NULL,
+		msblk->block_size, pages);
+
+	if (res >= 0) {
+		/* Zero the rest of the last page */
+		for (i = 0; i < pages; i++) {
+			int avail = clamp_t(int, res - i * PAGE_CACHE_SIZE, 0,
+				PAGE_CACHE_SIZE);
+
+			if (avail < PAGE_CACHE_SIZE)
+				memset(pageaddr[i] + avail, 0,
+					PAGE_CACHE_SIZE - avail);
+		}
+	}
+
+	if (vaddr) {
+		flush_kernel_vmap_range(vaddr, pages * PAGE_CACHE_SIZE);
+		vunmap(vaddr);
+	}
+
+	if (res < 0) {
+		ERROR("Unable to read page, block %llx, size %x\n", block,
+			bsize);
+		res = -EIO;
+		goto release_pages;
+	}
+
+	for (i = 0; i < pages; i++) {
+		flush_dcache_page(page[i]);
+		SetPageUptodate(page[i]);
+		unlock_page(page[i]);
+		if (page[i] != target_page)
+			page_cache_release(page[i]);
+	}
+
+	kfree(pageaddr);
+	kfree(page);
+	return 0;
+
+release_pages:
+	for (i = 0; i < pages; i++) {
+		if (page[i] && page[i] != target_page) {
+			unlock_page(page[i]);
+			page_cache_release(page[i]);
+		}
+	}
+
+out:
+	kfree(pageaddr);
+	kfree(page);
+
+	if (missing || res == -ENOMEM)
+		return squashfs_readpage_cache(target_page, block, bsize);
+	return res;
+}
+
+
+static int squashfs_readpage(struct file *file, struct page *page)
+{
+	struct inode *inode = page->mapping->host;
+	struct squashfs_sb_info *msblk = inode->i_sb->s_fs_info;
+	int index = page->index >> (msblk->block_log - PAGE_CACHE_SHIFT);
 	int file_end = i_size_read(inode) >> msblk->block_log;
+	struct squashfs_cache_entry *buffer;
+	void *pageaddr;
 
 	TRACE("Entered squashfs_readpage, page index %lx, start block %llx\n",
 				page->index, squashfs_i(inode)->start);
@@ -404,24 +597,12 @@ static int squashfs_readpage(struct file *file, struct page *page)
 			goto error_out;
 
 		if (bsize == 0) { /* hole */
-			bytes = index == file_end ?
+			int bytes = index == file_end ?
 				(i_size_read(inode) & (msblk->block_size - 1)) :
 				 msblk->block_size;
-			sparse = 1;
-		} else {
-			/*
-			 * Read and decompress datablock.
-			 */
-			buffer = squashfs_get_datablock(inode->i_sb,
-								block, bsize);
-			if (buffer->error) {
-				ERROR("Unable to read page, block %llx, size %x"
-					"\n", block, bsize);
-				squashfs_cache_put(buffer);
-				goto error_out;
-			}
-			bytes = buffer->length;
-		}
+			squashfs_copy_cache(page, NULL, bytes, 0);
+		} else if (squashfs_readpage_block(page, block, bsize))
+			goto error_out;
 	} else {
 		/*
 		 * Datablock is stored inside a fragment (tail-end packed
@@ -438,46 +619,11 @@ static int squashfs_readpage(struct file *file, struct page *page)
 			squashfs_cache_put(buffer);
 			goto error_out;
 		}
-		bytes = i_size_read(inode) & (msblk->block_size - 1);
-		offset = squashfs_i(inode)->fragment_offset;
-	}
-
-	/*
-	 * Loop copying datablock into pages.  As the datablock likely covers
-	 * many PAGE_CACHE_SIZE pages (default block size is 128 KiB) explicitly
-	 * grab the pages from the page cache, except for the page that we've
-	 * been called to fill.
-	 */
-	for (i = start_index; i <= end_index && bytes > 0; i++,
-			bytes -= PAGE_CACHE_SIZE, offset += PAGE_CACHE_SIZE) {
-		struct page *push_page;
-		int avail = sparse ? 0 : min_t(int, bytes, PAGE_CACHE_SIZE);
-
-		TRACE("bytes %d, i %d, available_bytes %d\n", bytes, i, avail);
-
-		push_page = (i == page->index) ? page :
-			grab_cache_page_nowait(page->mapping, i);
-
-		if (!push_page)
-			continue;
-
-		if (PageUptodate(push_page))
-			goto skip_page;
-
-		pageaddr = kmap_atomic(push_page, KM_USER0);
-		squashfs_copy_data(pageaddr, buffer, offset, avail);
-		memset(pageaddr + avail, 0, PAGE_CACHE_SIZE - avail);
-		kunmap_atomic(pageaddr, KM_USER0);
-		flush_dcache_page(push_page);
-		SetPageUptodate(push_page);
-skip_page:
-		unlock_page(push_page);
-		if (i != page->index)
-			page_cache_release(push_page);
-	}
-
-	if (!sparse)
+		squashfs_copy_cache(page, buffer,
+			i_size_read(inode) & (msblk->block_size - 1),
+			squashfs_i(inode)->fragment_offset);
 		squashfs_cache_put(buffer);
+	}
 
 	return 0;
 
@@ -0,0 +1,60 @@
+/*
+ * include/linux/cprofile.h
+ *
+ * Record format of /proc/cprofile/samples, the continuous callchain
+ * profiler.  See Documentation/trace/cprofile.txt.
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms and conditions of the GNU General Public License,
+ * version 2, as published by the Free Software Foundation.
+ */
+
+#ifndef _LINUX_CPROFILE_H
+#define _LINUX_CPROFILE_H
+
+#include <linux/types.h>
+
+/*
+ * Every record starts with a struct cprofile_header whose size covers
+ * the whole record, so a reader can skip types it does not know.  Fields
+ * are in the byte order of the profiled machine.
+ */
+#define CPROFILE_SAMPLE		1
+#define CPROFILE_COMM		2
+#define CPROFILE_LOST		3
+
+#define CPROFILE_MAX_DEPTH	64
+
+struct cprofile_header {
+	__u16	type;
+	__u16	size;
+	__u32	pid;
+	__u64	time;		/* ns, ring buffer clock */
+};
+
+/* A callchain, innermost frame first: nr_kernel kernel then user frames */
+struct cprofile_sample {
+	struct cprofile_header	h;
+	__u32	tgid;
+	__u16	nr_kernel;
+	__u16	nr_user;
+	__u64	ips[0];
+};
+
+/* Name of h.pid, written before its first sample on a CPU */
+struct cprofile_comm {
+	struct cprofile_header	h;
+	__u32	tgid;
+	char	comm[16];
+	__u32	pad;
+};
+
+/* Samples on @cpu that were overwritten before they could be read */
+struct cprofile_lost {
+	struct cprofile_header	h;
+	__u32	cpu;
+	__u32	pad;
+	__u64	count;
+};
+
+#endif /* _LINUX_CPROFILE_H */
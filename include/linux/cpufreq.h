@@ -373,6 +373,9 @@ extern struct cpufreq_governor cpufreq_gov_smartass2;
 #elif defined(CONFIG_CPU_FREQ_DEFAULT_GOV_LAGFREE)
 extern struct cpufreq_governor cpufreq_gov_lagfree;
 #define CPUFREQ_DEFAULT_GOVERNOR	(&cpufreq_gov_lagfree)
+#elif defined(CONFIG_CPU_FREQ_DEFAULT_GOV_PREDICTIVE)
+extern struct cpufreq_governor cpufreq_gov_predictive;
+#define CPUFREQ_DEFAULT_GOVERNOR	(&cpufreq_gov_predictive)
 #endif
 
 
@@ -10,6 +10,16 @@
 
 extern u32  crc32_le(u32 crc, unsigned char const *p, size_t len);
 extern u32  crc32_be(u32 crc, unsigned char const *p, size_t len);
+extern u32  __crc32c_le(u32 crc, unsigned char const *p, size_t len);
+
+/* every table-driven implementation, for lib/crc32test.c */
+extern const char *crc32_impl_name(unsigned int n);
+extern u32  crc32_le_impl(unsigned int n, u32 crc, unsigned char const *p,
+			  size_t len);
+extern u32  crc32_be_impl(unsigned int n, u32 crc, unsigned char const *p,
+			  size_t len);
+extern u32  __crc32c_le_impl(unsigned int n, u32 crc,
+			     unsigned char const *p, size_t len);
 
 #define crc32(seed, data, length)  crc32_le(seed, (unsigned char const *)(data), length)
 
@@ -0,0 +1,42 @@
+#ifndef _LINUX_DIRENT_STAT_H
+#define _LINUX_DIRENT_STAT_H
+
+#include <linux/types.h>
+
+/*
+ * Records returned by getdents_stat(2): a getdents64 entry followed by
+ * the attributes of the entry, as fstatat(dirfd, d_name,
+ * AT_SYMLINK_NOFOLLOW | AT_NO_AUTOMOUNT) would report them. The layout
+ * is the same for 32-bit and 64-bit callers.
+ */
+struct dirent_stat_attr {
+	__u64	st_dev;
+	__u64	st_ino;
+	__u64	st_rdev;
+	__s64	st_size;
+	__u64	st_blocks;
+	__s64	st_atime_sec;
+	__s64	st_mtime_sec;
+	__s64	st_ctime_sec;
+	__u32	st_atime_nsec;
+	__u32	st_mtime_nsec;
+	__u32	st_ctime_nsec;
+	__u32	st_mode;
+	__u32	st_nlink;
+	__u32	st_uid;
+	__u32	st_gid;
+	__u32	st_blksize;
+};
+
+struct linux_dirent_stat {
+	__u64	d_ino;
+	__s64	d_off;
+	__u16	d_reclen;
+	__u8	d_type;
+	__u8	d_pad;
+	__s32	d_stat_err;	/* 0, or -errno if d_stat is not valid */
+	struct dirent_stat_attr d_stat;
+	char	d_name[0];
+};
+
+#endif /* _LINUX_DIRENT_STAT_H */
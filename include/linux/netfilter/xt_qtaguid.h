@@ -3,6 +3,8 @@
 
 /* For now we just replace the xt_owner.
  * FIXME: make iptables aware of qtaguid. */
+#include <linux/if.h>
+#include <linux/types.h>
 #include <linux/netfilter/xt_owner.h>
 
 #define XT_QTAGUID_UID    XT_OWNER_UID
@@ -10,4 +12,76 @@
 #define XT_QTAGUID_SOCKET XT_OWNER_SOCKET
 #define xt_qtaguid_match_info xt_owner_match_info
 
+/*
+ * Binary stats export: /proc/net/xt_qtaguid/stats_bin
+ *
+ * Write a struct xt_qtaguid_stats_req, then read from offset 0 until EOF.
+ * Without a request, everything is returned. The data is a
+ * struct xt_qtaguid_stats_hdr followed by num_ifaces iface records, then
+ * num_tags tag records. Counters are totals, not deltas.
+ *
+ * Every interface is always returned. Tag records are only returned for
+ * stats that changed in or after since_gen; pass the returned generation
+ * as since_gen on the next request. A stats entry may be returned by two
+ * consecutive requests. If stats were deleted in the meantime, the reply
+ * holds all the stats and has XT_QTAGUID_STATS_F_FULL set, and the caller
+ * should drop what it had.
+ */
+#define XT_QTAGUID_STATS_VERSION 1
+
+/* The reply is not incremental, it replaces all previous ones. */
+#define XT_QTAGUID_STATS_F_FULL (1 << 0)
+
+struct xt_qtaguid_stats_req {
+	__u32 version;
+	__u32 padding;
+	__u64 since_gen;	/* 0 returns everything */
+};
+
+struct xt_qtaguid_stats_hdr {
+	__u32 version;
+	__u32 flags;
+	__u64 generation;
+	__u32 num_ifaces;
+	__u32 num_tags;
+};
+
+struct xt_qtaguid_stats_counts {
+	__u64 bytes;
+	__u64 packets;
+};
+
+enum {
+	XT_QTAGUID_RX,
+	XT_QTAGUID_TX,
+	XT_QTAGUID_DIRECTIONS
+};
+
+enum {
+	XT_QTAGUID_TCP,
+	XT_QTAGUID_UDP,
+	XT_QTAGUID_OTHER,
+	XT_QTAGUID_PROTOS
+};
+
+struct xt_qtaguid_iface_rec {
+	char ifname[IFNAMSIZ];
+	__u32 active;
+	__u32 padding;
+	/* Accumulated over the previous lives of the device */
+	struct xt_qtaguid_stats_counts totals[XT_QTAGUID_DIRECTIONS];
+	/* The device's own current stats, zero when it is not active */
+	struct xt_qtaguid_stats_counts dev[XT_QTAGUID_DIRECTIONS];
+};
+
+/* One per counter set in use by a {acct_tag, uid} on an interface */
+struct xt_qtaguid_tag_rec {
+	char ifname[IFNAMSIZ];
+	__u64 acct_tag;
+	__u32 uid;
+	__u32 cnt_set;
+	struct xt_qtaguid_stats_counts
+		counts[XT_QTAGUID_DIRECTIONS][XT_QTAGUID_PROTOS];
+};
+
 #endif /* _XT_QTAGUID_MATCH_H */
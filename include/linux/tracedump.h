@@ -21,6 +21,8 @@
 #ifndef _LINUX_KERNEL_TRACEDUMP_H
 #define _LINUX_KERNEL_TRACEDUMP_H
 
+#include <linux/types.h>
+
 /* tracedump
  * This module provides additional mechanisms for retreiving tracing data.
  * For details on configurations, parameters and usage, see tracedump.txt.
@@ -33,6 +35,9 @@
 /* Dump the tracer to console */
 int tracedump_dump(size_t max_out);
 
+/* Dump the tracer to the persistent RAM region, if there is one */
+int tracedump_ram_dump(void);
+
 /* Dumping functions */
 int tracedump_init(void);
 ssize_t tracedump_all(int print_to);
@@ -40,4 +45,35 @@ ssize_t tracedump_next(size_t max_out, int print_to);
 int tracedump_reset(void);
 int tracedump_deinit(void);
 
+/* Persistent RAM dump
+ * The region starts with a header, followed by a ring of records. Each
+ * record is an LZ4 compressed raw ring buffer page of one CPU, or a
+ * run of saved cmdlines. Records are 4 byte aligned. Starting at tail,
+ * there are count records; when wrap is not 0, the record that ends
+ * there is followed by the one at offset 0. tools/tracedump decodes it.
+ */
+#define TD_RAM_SIG		0x4d524454	/* TDRM */
+#define TD_RAM_VERSION		1
+
+#define TD_RAM_REC_PAGE		1
+#define TD_RAM_REC_CMDLINES	2
+
+struct tracedump_ram_header {
+	__u32	sig;
+	__u32	version;
+	__u32	size;		/* bytes of records after the header */
+	__u32	head;		/* offset of the next record */
+	__u32	tail;		/* offset of the oldest record */
+	__u32	wrap;		/* end of the records before offset 0 */
+	__u32	count;
+	__u32	page_size;
+};
+
+struct tracedump_ram_record {
+	__u16	type;
+	__u16	cpu;
+	__u32	len;		/* uncompressed */
+	__u32	clen;		/* compressed, follows the record */
+};
+
 #endif /* _LINUX_KERNEL_TRACEDUMP_H */
@@ -0,0 +1,533 @@
+/*
+ * kernel/events/cprofile.c - continuous callchain profiling
+ *
+ * Samples every online CPU at a low rate with a kernel perf counter and
+ * writes the callchain of whatever was running, kernel frames then user
+ * frames, into a per-CPU overwriting ring buffer.  Nothing is formatted
+ * or symbolized in the kernel: a sample is a few header words and the
+ * return addresses, so the profiler can stay enabled on production
+ * builds.  Userspace drains /proc/cprofile/samples from time to time and
+ * aggregates the stacks (tools/cprofile).
+ *
+ * The counter is the CPU cycle counter where the PMU supports sampling,
+ * so idle CPUs are not woken, and the cpu-clock software event otherwise.
+ * See Documentation/trace/cprofile.txt.
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms and conditions of the GNU General Public License,
+ * version 2, as published by the Free Software Foundation.
+ */
+
+#include <linux/cpu.h>
+#include <linux/cprofile.h>
+#include <linux/init.h>
+#include <linux/kernel.h>
+#include <linux/moduleparam.h>
+#include <linux/mutex.h>
+#include <linux/percpu.h>
+#include <linux/perf_event.h>
+#include <linux/proc_fs.h>
+#include <linux/ring_buffer.h>
+#include <linux/sched.h>
+#include <linux/seq_file.h>
+#include <linux/slab.h>
+#include <linux/string.h>
+#include <linux/uaccess.h>
+
+enum {
+	CPROFILE_EV_AUTO,
+	CPROFILE_EV_CYCLES,
+	CPROFILE_EV_CPU_CLOCK,
+};
+
+static const char * const cprofile_event_names[] = {
+	[CPROFILE_EV_AUTO]	= "auto",
+	[CPROFILE_EV_CYCLES]	= "cycles",
+	[CPROFILE_EV_CPU_CLOCK]	= "cpu-clock",
+};
+
+#define CPROFILE_MAX_FREQ	1000
+
+static bool cprofile_enabled;
+static int cprofile_event = CPROFILE_EV_AUTO;
+static unsigned int cprofile_freq = 49;
+static unsigned int cprofile_depth = 16;
+static unsigned long cprofile_buffer_kb = 64;
+static int cprofile_tgid;
+
+/*
+ * cprofile_lock serializes starting and stopping, CPU hotplug and
+ * readers of the ring buffer, which is only replaced while stopped.  It
+ * nests inside get_online_cpus().  The overflow handler takes no locks.
+ */
+static DEFINE_MUTEX(cprofile_lock);
+static bool cprofile_ready;
+static bool cprofile_running;
+static int cprofile_running_event;
+static unsigned long cprofile_buffer_size;
+static struct ring_buffer *cprofile_buffer;
+static struct perf_event_attr cprofile_attr;
+
+static DEFINE_PER_CPU(struct perf_event *, cprofile_cpu_event);
+static DEFINE_PER_CPU(struct perf_callchain_entry, cprofile_chain);
+static DEFINE_PER_CPU(struct cprofile_comm, cprofile_last_comm);
+static DEFINE_PER_CPU(unsigned long, cprofile_dropped);
+
+/* Tell the reader who h.pid is, if this CPU has not already. */
+static void cprofile_write_comm(struct task_struct *tsk)
+{
+	struct cprofile_comm *last = &__get_cpu_var(cprofile_last_comm);
+	struct ring_buffer_event *rbe;
+
+	if (last->h.pid == tsk->pid && last->tgid == tsk->tgid &&
+	    !strncmp(last->comm, tsk->comm, sizeof(last->comm)))
+		return;
+
+	rbe = ring_buffer_lock_reserve(cprofile_buffer, sizeof(*last));
+	if (!rbe) {
+		__get_cpu_var(cprofile_dropped)++;
+		return;
+	}
+	last->h.type = CPROFILE_COMM;
+	last->h.size = sizeof(*last);
+	last->h.pid = tsk->pid;
+	last->tgid = tsk->tgid;
+	memcpy(last->comm, tsk->comm, sizeof(last->comm));
+	memcpy(ring_buffer_event_data(rbe), last, sizeof(*last));
+	ring_buffer_unlock_commit(cprofile_buffer, rbe);
+}
+
+static void cprofile_overflow(struct perf_event *event,
+			      struct perf_sample_data *data,
+			      struct pt_regs *regs)
+{
+	struct task_struct *tsk = current;
+	struct perf_callchain_entry *chain;
+	struct ring_buffer_event *rbe;
+	struct cprofile_sample *s;
+	unsigned int depth, base, nr_kernel, nr;
+	int tgid = ACCESS_ONCE(cprofile_tgid);
+
+	if (!tsk->pid || (tgid && tsk->tgid != tgid))
+		return;
+
+	/*
+	 * Start the chain depth entries short of its end: the arch
+	 * unwinders stop walking the user stack once the entry is full,
+	 * so a deep stack costs no more than depth frames.
+	 */
+	depth = clamp_t(unsigned int, ACCESS_ONCE(cprofile_depth), 1,
+			CPROFILE_MAX_DEPTH);
+	chain = &__get_cpu_var(cprofile_chain);
+	base = PERF_MAX_STACK_DEPTH - depth;
+	chain->nr = base;
+
+	nr_kernel = 0;
+	if (!user_mode(regs)) {
+		perf_callchain_kernel(chain, regs);
+		nr_kernel = chain->nr - base;
+		regs = tsk->mm ? task_pt_regs(tsk) : NULL;
+	}
+	if (regs && chain->nr < PERF_MAX_STACK_DEPTH)
+		perf_callchain_user(chain, regs);
+	nr = chain->nr - base;
+
+	cprofile_write_comm(tsk);
+
+	rbe = ring_buffer_lock_reserve(cprofile_buffer,
+				       sizeof(*s) + nr * sizeof(u64));
+	if (!rbe) {
+		__get_cpu_var(cprofile_dropped)++;
+		return;
+	}
+	s = ring_buffer_event_data(rbe);
+	s->h.type = CPROFILE_SAMPLE;
+	s->h.size = sizeof(*s) + nr * sizeof(u64);
+	s->h.pid = tsk->pid;
+	s->h.time = 0;
+	s->tgid = tsk->tgid;
+	s->nr_kernel = nr_kernel;
+	s->nr_user = nr - nr_kernel;
+	memcpy(s->ips, &chain->ip[base], nr * sizeof(u64));
+	ring_buffer_unlock_commit(cprofile_buffer, rbe);
+}
+
+static void cprofile_set_attr(int ev)
+{
+	unsigned int freq = clamp_t(unsigned int, cprofile_freq, 1,
+				    CPROFILE_MAX_FREQ);
+
+	memset(&cprofile_attr, 0, sizeof(cprofile_attr));
+	cprofile_attr.size = sizeof(cprofile_attr);
+	cprofile_attr.pinned = 1;
+	cprofile_attr.disabled = 1;
+
+	if (ev == CPROFILE_EV_CYCLES) {
+		/* the period follows the clock rate, as perf record -F */
+		cprofile_attr.type = PERF_TYPE_HARDWARE;
+		cprofile_attr.config = PERF_COUNT_HW_CPU_CYCLES;
+		cprofile_attr.freq = 1;
+		cprofile_attr.sample_freq = freq;
+	} else {
+		cprofile_attr.type = PERF_TYPE_SOFTWARE;
+		cprofile_attr.config = PERF_COUNT_SW_CPU_CLOCK;
+		cprofile_attr.sample_period = NSEC_PER_SEC / freq;
+	}
+}
+
+static int cprofile_cpu_start(int cpu)
+{
+	struct perf_event *event;
+
+	event = perf_event_create_kernel_counter(&cprofile_attr, cpu, NULL,
+						 cprofile_overflow, NULL);
+	if (IS_ERR(event))
+		return PTR_ERR(event);
+
+	per_cpu(cprofile_last_comm, cpu).h.pid = 0;
+	per_cpu(cprofile_cpu_event, cpu) = event;
+	perf_event_enable(event);
+	return 0;
+}
+
+static void cprofile_cpu_stop(int cpu)
+{
+	struct perf_event *event = per_cpu(cprofile_cpu_event, cpu);
+
+	if (event) {
+		per_cpu(cprofile_cpu_event, cpu) = NULL;
+		perf_event_disable(event);
+		perf_event_release_kernel(event);
+	}
+}
+
+static int cprofile_start_cpus(int ev)
+{
+	int cpu, ret;
+
+	cprofile_set_attr(ev);
+	for_each_online_cpu(cpu) {
+		ret = cprofile_cpu_start(cpu);
+		if (ret) {
+			for_each_online_cpu(cpu)
+				cprofile_cpu_stop(cpu);
+			return ret;
+		}
+	}
+	cprofile_running_event = ev;
+	return 0;
+}
+
+static int cprofile_start(void)
+{
+	unsigned long size = cprofile_buffer_kb << 10;
+	int ret = 0;
+
+	get_online_cpus();
+	mutex_lock(&cprofile_lock);
+	if (cprofile_running)
+		goto out;
+
+	if (cprofile_buffer && cprofile_buffer_size != size) {
+		ring_buffer_free(cprofile_buffer);
+		cprofile_buffer = NULL;
+	}
+	if (!cprofile_buffer) {
+		cprofile_buffer = ring_buffer_alloc(size, RB_FL_OVERWRITE);
+		if (!cprofile_buffer) {
+			ret = -ENOMEM;
+			goto out;
+		}
+		cprofile_buffer_size = size;
+	}
+
+	if (cprofile_event == CPROFILE_EV_AUTO) {
+		ret = cprofile_start_cpus(CPROFILE_EV_CYCLES);
+		if (ret)
+			ret = cprofile_start_cpus(CPROFILE_EV_CPU_CLOCK);
+	} else {
+		ret = cprofile_start_cpus(cprofile_event);
+	}
+	if (ret) {
+		pr_err("cprofile: cannot create %s counter: %d\n",
+		       cprofile_event_names[cprofile_event], ret);
+		goto out;
+	}
+	cprofile_running = true;
+	pr_info("cprofile: sampling %s at %u Hz\n",
+		cprofile_event_names[cprofile_running_event],
+		clamp_t(unsigned int, cprofile_freq, 1, CPROFILE_MAX_FREQ));
+out:
+	cprofile_enabled = cprofile_running;
+	mutex_unlock(&cprofile_lock);
+	put_online_cpus();
+	return ret;
+}
+
+/* Samples already taken stay readable until the next start. */
+static void cprofile_stop(void)
+{
+	int cpu;
+
+	get_online_cpus();
+	mutex_lock(&cprofile_lock);
+	if (cprofile_running) {
+		for_each_online_cpu(cpu)
+			cprofile_cpu_stop(cpu);
+		cprofile_running = false;
+	}
+	cprofile_enabled = false;
+	mutex_unlock(&cprofile_lock);
+	put_online_cpus();
+}
+
+static int __cpuinit cprofile_cpu_callback(struct notifier_block *nfb,
+					   unsigned long action, void *hcpu)
+{
+	int cpu = (long)hcpu;
+	int ret;
+
+	mutex_lock(&cprofile_lock);
+	if (!cprofile_running)
+		goto out;
+
+	switch (action & ~CPU_TASKS_FROZEN) {
+	case CPU_ONLINE:
+	case CPU_DOWN_FAILED:
+		ret = cprofile_cpu_start(cpu);
+		if (ret)
+			pr_warning("cprofile: cannot sample cpu %d: %d\n",
+				   cpu, ret);
+		break;
+	case CPU_DOWN_PREPARE:
+		cprofile_cpu_stop(cpu);
+		break;
+	}
+out:
+	mutex_unlock(&cprofile_lock);
+	return NOTIFY_OK;
+}
+
+static struct notifier_block __cpuinitdata cprofile_cpu_nb = {
+	.notifier_call = cprofile_cpu_callback,
+};
+
+/*
+ * Module parameters, settable on the command line as cprofile.<name>=
+ * and at run time in /sys/module/cprofile/parameters.  The event,
+ * frequency and buffer size apply from the next enable; depth and tgid
+ * at once.
+ */
+static int cprofile_enable_set(const char *val, const struct kernel_param *kp)
+{
+	bool enable;
+	int ret;
+
+	ret = strtobool(val ? val : "1", &enable);
+	if (ret)
+		return ret;
+
+	/* too early for perf events; cprofile_init() will start us */
+	if (!cprofile_ready) {
+		cprofile_enabled = enable;
+		return 0;
+	}
+
+	if (!enable) {
+		cprofile_stop();
+		return 0;
+	}
+	return cprofile_start();
+}
+
+static struct kernel_param_ops cprofile_enable_ops = {
+	.set = cprofile_enable_set,
+	.get = param_get_bool,
+};
+module_param_cb(enable, &cprofile_enable_ops, &cprofile_enabled, 0644);
+MODULE_PARM_DESC(enable, "Sample all CPUs");
+
+static int cprofile_event_set(const char *val, const struct kernel_param *kp)
+{
+	int i;
+
+	for (i = 0; i < ARRAY_SIZE(cprofile_event_names); i++) {
+		if (sysfs_streq(val, cprofile_event_names[i])) {
+			cprofile_event = i;
+			return 0;
+		}
+	}
+	return -EINVAL;
+}
+
+static int cprofile_event_get(char *buffer, const struct kernel_param *kp)
+{
+	return sprintf(buffer, "%s", cprofile_event_names[cprofile_event]);
+}
+
+static struct kernel_param_ops cprofile_event_ops = {
+	.set = cprofile_event_set,
+	.get = cprofile_event_get,
+};
+module_param_cb(event, &cprofile_event_ops, NULL, 0644);
+MODULE_PARM_DESC(event, "Sampling event: auto, cycles or cpu-clock");
+
+module_param_named(freq, cprofile_freq, uint, 0644);
+MODULE_PARM_DESC(freq, "Samples per second per CPU");
+
+module_param_named(depth, cprofile_depth, uint, 0644);
+MODULE_PARM_DESC(depth, "Maximum frames in a callchain");
+
+module_param_named(buffer_kb, cprofile_buffer_kb, ulong, 0644);
+MODULE_PARM_DESC(buffer_kb, "Ring buffer size per CPU in kB");
+
+module_param_named(tgid, cprofile_tgid, int, 0644);
+MODULE_PARM_DESC(tgid, "Only sample this process, 0 for all");
+
+/* The oldest record of any CPU, and the lost count before it. */
+static struct cprofile_header *cprofile_peek(int *cpup, u64 *tsp,
+					     unsigned long *lostp)
+{
+	struct ring_buffer_event *rbe, *next = NULL;
+	unsigned long lost;
+	u64 ts;
+	int cpu;
+
+	for_each_possible_cpu(cpu) {
+		rbe = ring_buffer_peek(cprofile_buffer, cpu, &ts, &lost);
+		if (rbe && (!next || ts < *tsp)) {
+			next = rbe;
+			*cpup = cpu;
+			*tsp = ts;
+			*lostp = lost;
+		}
+	}
+	return next ? ring_buffer_event_data(next) : NULL;
+}
+
+/*
+ * Reading consumes: each read returns as many whole records as fit, in
+ * time order across CPUs, and 0 once the buffer is empty.
+ */
+static ssize_t cprofile_samples_read(struct file *file, char __user *ubuf,
+				     size_t count, loff_t *ppos)
+{
+	struct cprofile_header *h;
+	struct cprofile_lost lost_rec;
+	union {
+		struct cprofile_header h;
+		char buf[sizeof(struct cprofile_sample) +
+			 CPROFILE_MAX_DEPTH * sizeof(u64)];
+	} *rec;
+	unsigned long lost;
+	ssize_t done = 0;
+	size_t need;
+	int cpu;
+	u64 ts;
+
+	rec = kmalloc(sizeof(*rec), GFP_KERNEL);
+	if (!rec)
+		return -ENOMEM;
+
+	mutex_lock(&cprofile_lock);
+	while (cprofile_buffer) {
+		h = cprofile_peek(&cpu, &ts, &lost);
+		if (!h)
+			break;
+		if (WARN_ON_ONCE(h->size > sizeof(*rec))) {
+			done = -EIO;
+			break;
+		}
+		need = h->size + (lost ? sizeof(lost_rec) : 0);
+		if (need > count - done)
+			break;
+
+		memcpy(rec, h, h->size);
+		rec->h.time = ts;
+		ring_buffer_consume(cprofile_buffer, cpu, NULL, NULL);
+
+		if (lost) {
+			memset(&lost_rec, 0, sizeof(lost_rec));
+			lost_rec.h.type = CPROFILE_LOST;
+			lost_rec.h.size = sizeof(lost_rec);
+			lost_rec.h.time = ts;
+			lost_rec.cpu = cpu;
+			lost_rec.count = lost;
+			if (copy_to_user(ubuf + done, &lost_rec,
+					 sizeof(lost_rec))) {
+				done = -EFAULT;
+				break;
+			}
+			done += sizeof(lost_rec);
+		}
+		if (copy_to_user(ubuf + done, rec, rec->h.size)) {
+			done = -EFAULT;
+			break;
+		}
+		done += rec->h.size;
+	}
+	mutex_unlock(&cprofile_lock);
+
+	kfree(rec);
+	return done;
+}
+
+static const struct file_operations cprofile_samples_fops = {
+	.read		= cprofile_samples_read,
+	.llseek		= noop_llseek,
+};
+
+static int cprofile_stats_show(struct seq_file *m, void *v)
+{
+	int cpu;
+
+	mutex_lock(&cprofile_lock);
+	seq_printf(m, "enabled: %d\n", cprofile_running);
+	if (cprofile_running)
+		seq_printf(m, "event: %s\n",
+			   cprofile_event_names[cprofile_running_event]);
+	if (cprofile_buffer) {
+		for_each_online_cpu(cpu)
+			seq_printf(m, "cpu%d: entries %lu overrun %lu "
+				   "dropped %lu\n", cpu,
+				   ring_buffer_entries_cpu(cprofile_buffer, cpu),
+				   ring_buffer_overrun_cpu(cprofile_buffer, cpu),
+				   per_cpu(cprofile_dropped, cpu));
+	}
+	mutex_unlock(&cprofile_lock);
+	return 0;
+}
+
+static int cprofile_stats_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, cprofile_stats_show, NULL);
+}
+
+static const struct file_operations cprofile_stats_fops = {
+	.open		= cprofile_stats_open,
+	.read		= seq_read,
+	.llseek		= seq_lseek,
+	.release	= single_release,
+};
+
+static int __init cprofile_init(void)
+{
+	struct proc_dir_entry *dir;
+
+	dir = proc_mkdir("cprofile", NULL);
+	if (!dir)
+		return -ENOMEM;
+	proc_create("samples", S_IRUSR, dir, &cprofile_samples_fops);
+	proc_create("stats", S_IRUGO, dir, &cprofile_stats_fops);
+
+	register_hotcpu_notifier(&cprofile_cpu_nb);
+
+	kparam_block_sysfs_write(enable);
+	cprofile_ready = true;
+	kparam_unblock_sysfs_write(enable);
+
+	if (cprofile_enabled)
+		cprofile_start();
+	return 0;
+}
+late_initcall(cprofile_init);
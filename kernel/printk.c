@@ -41,6 +41,8 @@
 #include <linux/cpu.h>
 #include <linux/notifier.h>
 #include <linux/rculist.h>
+#include <linux/kthread.h>
+#include <linux/atomic.h>
 
 #include <asm/uaccess.h>
 
@@ -100,9 +102,9 @@ EXPORT_SYMBOL_GPL(console_drivers);
 static int console_locked, console_suspended;
 
 /*
- * logbuf_lock protects log_buf, log_start, log_end, con_start and logged_chars
- * It is also used in interesting ways to provide interlocking in
- * console_unlock();.
+ * logbuf_lock serialises the readers of log_buf - syslog(), kmsg_dump()
+ * and log_buf_copy() - and protects log_start.  printk() itself does not
+ * take it: writers reserve their space locklessly, see log_store().
  */
 static DEFINE_SPINLOCK(logbuf_lock);
 
@@ -114,8 +116,7 @@ static DEFINE_SPINLOCK(logbuf_lock);
  * must be masked before subscripting
  */
 static unsigned log_start;	/* Index into log_buf: next char to be read by syslog() */
-static unsigned con_start;	/* Index into log_buf: next char to be sent to consoles */
-static unsigned log_end;	/* Index into log_buf: most-recently-written-char + 1 */
+static unsigned log_end;	/* Index into log_buf: most-recently-committed-char + 1 */
 
 /*
  * If exclusive_console is non-NULL then only this console is to be printed to.
@@ -146,6 +147,20 @@ EXPORT_SYMBOL(console_set_on_cmdline);
 /* Flag: console code may call schedule() */
 static int console_may_schedule;
 
+/*
+ * Console output is normally left to printk_thread, so that printk()
+ * never waits for a console driver.  Until the consoles are resumed,
+ * suspend_console() has printk() print itself, see printk_direct().
+ */
+static struct task_struct *printk_thread;
+static int printk_sync_suspend;
+
+/* What printk() left for the next tick to do, see printk_tick() */
+#define PRINTK_PENDING_WAKEUP	0x01
+#define PRINTK_PENDING_CONSOLE	0x02
+
+static DEFINE_PER_CPU(int, printk_pending);
+
 #ifdef CONFIG_PRINTK
 
 static char __log_buf[__LOG_BUF_LEN];
@@ -154,6 +169,86 @@ static int log_buf_len = __LOG_BUF_LEN;
 static unsigned logged_chars; /* Number of chars produced since last read+clear operation */
 static int saved_console_loglevel = -1;
 
+/*
+ * Every printk() that stores text is a record: the part of log_buf its
+ * text went to, when it was logged and a sequence number.  Writers
+ * reserve their text with a cmpxchg on log_head and copy it in without
+ * a lock, then commit in reservation order, which is when the record
+ * gets its sequence number and log_end moves on.  The records tile the
+ * text, so the consoles print up to the end of each record, from where
+ * they stopped.  A burst of short printks can overwrite records while
+ * their text is still there; that text still gets printed.
+ */
+struct log_rec {
+	u64 ts_nsec;		/* cpu_clock() when the text was reserved */
+	unsigned seq;
+	unsigned start;		/* Index into log_buf of the first char */
+	unsigned len;
+};
+
+#define LOG_REC_NR	(1 << (CONFIG_LOG_BUF_SHIFT - 7))
+#define LOG_REC_MASK	(LOG_REC_NR - 1)
+
+static struct log_rec log_recs[LOG_REC_NR];
+static unsigned log_next_seq;	/* Sequence number of the next record */
+static unsigned console_seq;	/* Next record for the consoles (console_sem) */
+static unsigned console_idx;	/* Index just past what they printed */
+
+/*
+ * The low 32 bits of log_head are the index just past the last
+ * reservation, committed or not.  LOG_HEAD_OPEN says that its text did
+ * not end a line.  The two move together, so that a writer knows
+ * whether its text has to start with a newline and a log prefix.
+ */
+static atomic64_t log_head = ATOMIC64_INIT(0);
+
+#define LOG_HEAD_OPEN	(1ULL << 32)
+
+static inline unsigned log_reserved(void)
+{
+	return (unsigned)atomic64_read(&log_head);
+}
+
+/*
+ * Is the text at @idx still there, i.e. not reserved again by a later
+ * writer?  Read the text first, then check.
+ */
+static inline int log_text_valid(unsigned idx)
+{
+	smp_rmb();
+	return log_reserved() - idx <= log_buf_len;
+}
+
+/*
+ * Move a reader's index on to the oldest text that has not been reserved
+ * again, if it has fallen that far behind.  @end is the log_end the
+ * reader is working to.
+ */
+static unsigned log_clamp(unsigned idx, unsigned end)
+{
+	unsigned oldest = log_reserved() - log_buf_len;
+
+	if ((int)(oldest - idx) > 0)
+		idx = (int)(oldest - end) > 0 ? end : oldest;
+	return idx;
+}
+
+/*
+ * Copy record @seq to @rec.  Returns 0 if it has been overwritten by a
+ * newer record, or is being.
+ */
+static int log_rec_get(unsigned seq, struct log_rec *rec)
+{
+	struct log_rec *r = &log_recs[seq & LOG_REC_MASK];
+
+	if (ACCESS_ONCE(r->seq) != seq)
+		return 0;
+	smp_rmb();
+	*rec = *r;
+	smp_rmb();
+	return ACCESS_ONCE(r->seq) == seq;
+}
+
 #ifdef CONFIG_KEXEC
 /*
  * This appends the listed symbols to /proc/vmcoreinfo
@@ -192,7 +287,7 @@ early_param("log_buf_len", log_buf_len_setup);
 void __init setup_log_buf(int early)
 {
 	unsigned long flags;
-	unsigned start, dest_idx, offset;
+	unsigned idx;
 	char *new_log_buf;
 	int free;
 
@@ -216,24 +311,20 @@ void __init setup_log_buf(int early)
 		return;
 	}
 
+	/*
+	 * Only the boot CPU runs, with interrupts off, so there are no
+	 * writers.  The indices stay as they are: the text keeps its
+	 * place modulo the larger buffer, and the records stay valid.
+	 */
 	spin_lock_irqsave(&logbuf_lock, flags);
+	idx = log_end - min_t(unsigned, log_end, __LOG_BUF_LEN);
+	for (; idx != log_end; idx++)
+		new_log_buf[idx & (new_log_buf_len - 1)] =
+			__log_buf[idx & (__LOG_BUF_LEN - 1)];
 	log_buf_len = new_log_buf_len;
 	log_buf = new_log_buf;
 	new_log_buf_len = 0;
 	free = __LOG_BUF_LEN - log_end;
-
-	offset = start = min(con_start, log_start);
-	dest_idx = 0;
-	while (start != log_end) {
-		unsigned log_idx_mask = start & (__LOG_BUF_LEN - 1);
-
-		log_buf[dest_idx] = __log_buf[log_idx_mask];
-		start++;
-		dest_idx++;
-	}
-	log_start -= offset;
-	con_start -= offset;
-	log_end -= offset;
 	spin_unlock_irqrestore(&logbuf_lock, flags);
 
 	pr_info("log_buf_len: %d\n", log_buf_len);
@@ -417,8 +508,16 @@ int do_syslog(int type, char __user *buf, int len, bool from_file)
 			goto out;
 		i = 0;
 		spin_lock_irq(&logbuf_lock);
-		while (!error && (log_start != log_end) && i < len) {
+		while (!error && i < len) {
+			unsigned end = ACCESS_ONCE(log_end);
+
+			log_start = log_clamp(log_start, end);
+			if (log_start == end)
+				break;
+			smp_rmb();
 			c = LOG_BUF(log_start);
+			if (!log_text_valid(log_start))
+				continue;
 			log_start++;
 			spin_unlock_irq(&logbuf_lock);
 			error = __put_user(c,buf);
@@ -456,6 +555,7 @@ int do_syslog(int type, char __user *buf, int len, bool from_file)
 		if (do_clear)
 			logged_chars = 0;
 		limit = log_end;
+		smp_rmb();
 		/*
 		 * __put_user() could sleep, and while we sleep
 		 * printk() could overwrite the messages
@@ -464,9 +564,9 @@ int do_syslog(int type, char __user *buf, int len, bool from_file)
 		 */
 		for (i = 0; i < count && !error; i++) {
 			j = limit-1-i;
-			if (j + log_buf_len < log_end)
-				break;
 			c = LOG_BUF(j);
+			if (!log_text_valid(j))
+				break;
 			spin_unlock_irq(&logbuf_lock);
 			error = __put_user(c,&buf[count-1-i]);
 			cond_resched();
@@ -520,7 +620,8 @@ int do_syslog(int type, char __user *buf, int len, bool from_file)
 		break;
 	/* Number of chars in the log buffer */
 	case SYSLOG_ACTION_SIZE_UNREAD:
-		error = log_end - log_start;
+		limit = log_end;
+		error = limit - log_clamp(log_start, limit);
 		break;
 	/* Size of the log buffer */
 	case SYSLOG_ACTION_SIZE_BUFFER:
@@ -556,9 +657,9 @@ void kdb_syslog_data(char *syslog_data[4])
 #endif	/* CONFIG_KGDB_KDB */
 
 /*
- * Call the console drivers on a range of log_buf
+ * Call the console drivers on some text
  */
-static void __call_console_drivers(unsigned start, unsigned end)
+static void __call_console_drivers(const char *text, unsigned len)
 {
 	struct console *con;
 
@@ -568,7 +669,7 @@ static void __call_console_drivers(unsigned start, unsigned end)
 		if ((con->flags & CON_ENABLED) && con->write &&
 				(cpu_online(smp_processor_id()) ||
 				(con->flags & CON_ANYTIME)))
-			con->write(con, &LOG_BUF(start), end - start);
+			con->write(con, text, len);
 	}
 }
 
@@ -594,11 +695,11 @@ static void _call_console_drivers(unsigned start,
 			console_drivers && start != end) {
 		if ((start & LOG_BUF_MASK) > (end & LOG_BUF_MASK)) {
 			/* wrapped write */
-			__call_console_drivers(start & LOG_BUF_MASK,
-						log_buf_len);
-			__call_console_drivers(0, end & LOG_BUF_MASK);
+			__call_console_drivers(&LOG_BUF(start),
+					log_buf_len - (start & LOG_BUF_MASK));
+			__call_console_drivers(log_buf, end & LOG_BUF_MASK);
 		} else {
-			__call_console_drivers(start, end);
+			__call_console_drivers(&LOG_BUF(start), end - start);
 		}
 	}
 }
@@ -668,6 +769,12 @@ static size_t log_prefix(const char *p, unsigned int *level, char *special)
 	return len;
 }
 
+/*
+ * Log level of the line the consoles are in the middle of, or -1 at the
+ * start of a line.  Under console_sem.
+ */
+static int msg_level = -1;
+
 /*
  * Call the console drivers, asking them to write out
  * log_buf[start] to log_buf[end - 1].
@@ -676,7 +783,6 @@ static size_t log_prefix(const char *p, unsigned int *level, char *special)
 static void call_console_drivers(unsigned start, unsigned end)
 {
 	unsigned cur_index, start_print;
-	static int msg_level = -1;
 
 	BUG_ON(((int)(start - end)) > 0);
 
@@ -712,16 +818,162 @@ static void call_console_drivers(unsigned start, unsigned end)
 	_call_console_drivers(start_print, end, msg_level);
 }
 
-static void emit_log_char(char c)
+/*
+ * The text of one printk() as it goes into log_buf: the message without
+ * its log prefix, and the prefix and timestamp that start each line.
+ */
+struct log_text {
+	const char *text;
+	unsigned len;
+	const char *prefix;
+	unsigned prefix_len;
+	const char *time;
+	unsigned time_len;
+	unsigned lines;		/* lines started after a newline in text */
+	int newline;		/* text ends any line left open */
+};
+
+/* Number of chars @t takes in log_buf, with a line @open or not. */
+static unsigned log_text_size(const struct log_text *t, int open)
 {
-	LOG_BUF(log_end) = c;
-	log_end++;
-	if (log_end - log_start > log_buf_len)
-		log_start = log_end - log_buf_len;
-	if (log_end - con_start > log_buf_len)
-		con_start = log_end - log_buf_len;
-	if (logged_chars < log_buf_len)
-		logged_chars++;
+	unsigned hdr_len = t->prefix_len + t->time_len;
+	unsigned size = t->len + t->lines * hdr_len;
+
+	if (open && t->newline) {
+		size++;
+		open = 0;
+	}
+	if (!open && t->len)
+		size += hdr_len;
+	return size;
+}
+
+static unsigned log_copy(unsigned idx, const char *src, unsigned len)
+{
+	while (len) {
+		unsigned off = idx & LOG_BUF_MASK;
+		unsigned n = min_t(unsigned, len, log_buf_len - off);
+
+		memcpy(log_buf + off, src, n);
+		idx += n;
+		src += n;
+		len -= n;
+	}
+	return idx;
+}
+
+static void log_text_write(unsigned idx, const struct log_text *t, int open)
+{
+	const char *p = t->text, *end = t->text + t->len;
+
+	if (open && t->newline) {
+		LOG_BUF(idx) = '\n';
+		idx++;
+		open = 0;
+	}
+	while (p < end) {
+		const char *eol = memchr(p, '\n', end - p);
+		unsigned n = eol ? eol + 1 - p : end - p;
+
+		if (!open) {
+			idx = log_copy(idx, t->prefix, t->prefix_len);
+			idx = log_copy(idx, t->time, t->time_len);
+		}
+		idx = log_copy(idx, p, n);
+		p += n;
+		open = 0;
+	}
+}
+
+/* How long to wait for a writer that may have died in an oops */
+#define LOG_COMMIT_SPINS	(1 << 20)
+
+/*
+ * Set on a CPU from a writer's reservation to its commit.  Interrupts
+ * are off then, but an NMI is not, and an NMI printk() that reserved
+ * after it would wait for a commit that cannot happen until the NMI
+ * returns.  Such a printk() is dropped instead, and counted.
+ */
+static DEFINE_PER_CPU(int, log_store_busy);
+static atomic_t log_nmi_dropped = ATOMIC_INIT(0);
+
+/*
+ * Publish the text reserved at [@start, @end) as the next record, once
+ * every writer that reserved before it has done the same.  They are
+ * copying with interrupts off, on other CPUs or in an NMI on this one
+ * that reserved in between, unless one died doing so in an oops: then
+ * it is overtaken after a while, and a writer that finds log_end
+ * already past its text gives up.
+ */
+static void log_commit(unsigned start, unsigned end, u64 ts_nsec)
+{
+	struct log_rec *rec;
+	unsigned seq, old, chars;
+	unsigned long spins = 0;
+
+	while (ACCESS_ONCE(log_end) != start) {
+		if ((int)(ACCESS_ONCE(log_end) - start) > 0)
+			return;
+		if (oops_in_progress && ++spins > LOG_COMMIT_SPINS)
+			break;
+		cpu_relax();
+	}
+	smp_rmb();
+
+	seq = log_next_seq;
+	rec = &log_recs[seq & LOG_REC_MASK];
+	/* a sequence number not of this slot says it is being rewritten */
+	rec->seq = seq + 1;
+	smp_wmb();
+	rec->ts_nsec = ts_nsec;
+	rec->start = start;
+	rec->len = end - start;
+	smp_wmb();
+	rec->seq = seq;
+	smp_wmb();
+	log_next_seq = seq + 1;
+
+	do {
+		old = logged_chars;
+		chars = min_t(unsigned, old + (end - start), log_buf_len);
+	} while (cmpxchg(&logged_chars, old, chars) != old);
+
+	/* the text and the record before log_end, for the readers */
+	smp_wmb();
+	log_end = end;
+}
+
+/*
+ * Append @t to the log and return the number of chars it took.  The
+ * space is reserved with a cmpxchg on log_head, which also says whether
+ * the previous text left a line open, then filled and committed.
+ * Interrupts must be off, so that no writer on this CPU can come in
+ * between the reservation and the commit and wait for it, and NMIs
+ * must not store while log_store_busy is set.
+ */
+static unsigned log_store(const struct log_text *t, u64 ts_nsec)
+{
+	u64 old, new;
+	unsigned start, size;
+	int open;
+
+	__this_cpu_write(log_store_busy, 1);
+	do {
+		old = atomic64_read(&log_head);
+		start = (unsigned)old;
+		open = !!(old & LOG_HEAD_OPEN);
+		size = log_text_size(t, open);
+		new = (u32)(start + size);
+		if (t->len ? t->text[t->len - 1] != '\n' : open && !t->newline)
+			new |= LOG_HEAD_OPEN;
+	} while (atomic64_cmpxchg(&log_head, old, new) != old);
+
+	if (size) {
+		log_text_write(start, t, open);
+		log_commit(start, start + size, ts_nsec);
+	}
+	__this_cpu_write(log_store_busy, 0);
+	return size;
 }
 
 /*
@@ -770,11 +1022,13 @@ static int have_callable_console(void)
  *
  * This is printk().  It can be called from any context.  We want it to work.
  *
- * We try to grab the console_lock.  If we succeed, it's easy - we log the output and
- * call the console drivers.  If we fail to get the semaphore we place the output
- * into the log buffer and return.  The current holder of the console_sem will
- * notice the new output in console_unlock(); and will send it to the
- * consoles before releasing the lock.
+ * The output goes into the log buffer without taking a lock, and the
+ * printk kthread is woken on the next tick to send it to the consoles.
+ * Before that thread runs, while the system boots or goes down, and on
+ * an oops, we try to grab the console_lock instead.  If we succeed, we
+ * call the console drivers.  If we fail to get the semaphore the current
+ * holder of the console_sem will notice the new output in console_unlock();
+ * and will send it to the consoles before releasing the lock.
  *
  * One effect of this deferred printing is that code which calls printk() and
  * then changes console_loglevel may break. This is because console_loglevel
@@ -806,9 +1060,6 @@ asmlinkage int printk(const char *fmt, ...)
 	return r;
 }
 
-/* cpu currently holding logbuf_lock */
-static volatile unsigned int printk_cpu = UINT_MAX;
-
 /*
  * Can we actually use the console at this time on this cpu?
  *
@@ -828,41 +1079,67 @@ static inline int can_use_console(unsigned int cpu)
  * console_lock held, and 'console_locked' set) if it
  * is successful, false otherwise.
  *
- * This gets called with the 'logbuf_lock' spinlock held and
- * interrupts disabled. It should return with 'lockbuf_lock'
- * released but interrupts still disabled.
+ * This gets called with interrupts disabled.
  */
 static int console_trylock_for_printk(unsigned int cpu)
-	__releases(&logbuf_lock)
 {
-	int retval = 0, wake = 0;
-
-	if (console_trylock()) {
-		retval = 1;
+	if (!console_trylock())
+		return 0;
 
-		/*
-		 * If we can't use the console, we need to release
-		 * the console semaphore by hand to avoid flushing
-		 * the buffer. We need to hold the console semaphore
-		 * in order to do this test safely.
-		 */
-		if (!can_use_console(cpu)) {
-			console_locked = 0;
-			wake = 1;
-			retval = 0;
-		}
-	}
-	printk_cpu = UINT_MAX;
-	spin_unlock(&logbuf_lock);
-	if (wake)
+	/*
+	 * If we can't use the console, we need to release
+	 * the console semaphore by hand to avoid flushing
+	 * the buffer. We need to hold the console semaphore
+	 * in order to do this test safely.
+	 */
+	if (!can_use_console(cpu)) {
+		console_locked = 0;
 		up(&console_sem);
-	return retval;
+		return 0;
+	}
+	return 1;
+}
+
+static int printk_sync;
+
+/*
+ * Print from printk() itself rather than leave it to printk_thread:
+ * before the thread runs, while booting or going down, on an oops, or
+ * when asked to with printk.sync=1.
+ */
+static inline int printk_direct(void)
+{
+	return printk_sync || printk_sync_suspend || oops_in_progress ||
+		!printk_thread || system_state != SYSTEM_RUNNING;
 }
+
 static const char recursion_bug_msg [] =
 		KERN_CRIT "BUG: recent printk recursion!\n";
 static int recursion_bug;
-static int new_text_line = 1;
-static char printk_buf[1024];
+
+static const char nmi_dropped_msg[] =
+		KERN_WARNING "printk: %d messages from NMI dropped\n";
+
+/*
+ * printk() formats into a buffer of its own CPU and context - task,
+ * softirq, hardirq or NMI - so that needs no lock, and interrupts stay
+ * on while it formats.  busy catches a printk() recursing into itself.
+ */
+#define PRINTK_CTX_NR	4
+
+struct printk_stage {
+	char buf[1024];
+	int busy;
+};
+
+static DEFINE_PER_CPU(struct printk_stage, printk_stage[PRINTK_CTX_NR]);
+
+static inline struct printk_stage *printk_stage_get(void)
+{
+	int ctx = in_nmi() ? 3 : in_irq() ? 2 : in_serving_softirq() ? 1 : 0;
+
+	return &__get_cpu_var(printk_stage)[ctx];
+}
 
 int printk_delay_msec __read_mostly;
 
@@ -882,24 +1159,26 @@ asmlinkage int vprintk(const char *fmt, va_list args)
 {
 	int printed_len = 0;
 	int current_log_level = default_message_loglevel;
+	struct printk_stage *ps;
+	struct log_text t;
 	unsigned long flags;
 	int this_cpu;
-	char *p;
+	char *p, level[3], tbuf[50];
 	size_t plen;
 	char special;
+	u64 ts_nsec;
 
 	boot_delay_msec();
 	printk_delay();
 
 	preempt_disable();
-	/* This stops the holder of console_sem just where we want him */
-	raw_local_irq_save(flags);
 	this_cpu = smp_processor_id();
+	ps = printk_stage_get();
 
 	/*
 	 * Ouch, printk recursed into itself!
 	 */
-	if (unlikely(printk_cpu == this_cpu)) {
+	if (unlikely(ps->busy)) {
 		/*
 		 * If a crash is occurring during printk() on this CPU,
 		 * then try to get the crash message out but make sure
@@ -909,29 +1188,43 @@ asmlinkage int vprintk(const char *fmt, va_list args)
 		 */
 		if (!oops_in_progress) {
 			recursion_bug = 1;
-			goto out_restore_irqs;
+			goto out;
 		}
 		zap_locks();
 	}
-
-	lockdep_off();
-	spin_lock(&logbuf_lock);
-	printk_cpu = this_cpu;
+	/*
+	 * An NMI that came in between a reservation and its commit on
+	 * this CPU cannot store, see log_store_busy.
+	 */
+	if (unlikely(in_nmi() && __this_cpu_read(log_store_busy))) {
+		atomic_inc(&log_nmi_dropped);
+		goto out;
+	}
+	ps->busy = 1;
 
 	if (recursion_bug) {
 		recursion_bug = 0;
-		strcpy(printk_buf, recursion_bug_msg);
+		strcpy(ps->buf, recursion_bug_msg);
 		printed_len = strlen(recursion_bug_msg);
 	}
+	if (unlikely(atomic_read(&log_nmi_dropped)) && !in_nmi()) {
+		int n = atomic_xchg(&log_nmi_dropped, 0);
+
+		if (n)
+			printed_len += scnprintf(ps->buf + printed_len,
+						 sizeof(ps->buf) - printed_len,
+						 nmi_dropped_msg, n);
+	}
 	/* Emit the output into the temporary buffer */
-	printed_len += vscnprintf(printk_buf + printed_len,
-				  sizeof(printk_buf) - printed_len, fmt, args);
+	printed_len += vscnprintf(ps->buf + printed_len,
+				  sizeof(ps->buf) - printed_len, fmt, args);
 
 #ifdef	CONFIG_DEBUG_LL
-	printascii(printk_buf);
+	printascii(ps->buf);
 #endif
 
-	p = printk_buf;
+	p = ps->buf;
+	t.newline = 0;
 
 	/* Read log level and handle special printk prefix */
 	plen = log_prefix(p, &current_log_level, &special);
@@ -945,89 +1238,212 @@ asmlinkage int vprintk(const char *fmt, va_list args)
 		case 'd': /* Strip <d> KERN_DEFAULT, start new line */
 			plen = 0;
 		default:
-			if (!new_text_line) {
-				emit_log_char('\n');
-				new_text_line = 1;
-			}
+			t.newline = 1;
 		}
 	}
 
 	/*
-	 * Copy the output into log_buf. If the caller didn't provide
-	 * the appropriate log prefix, we insert them here
+	 * Every line starts with the caller's log prefix, or with one
+	 * made up here, and the time stamp.
 	 */
-	for (; *p; p++) {
-		if (new_text_line) {
-			new_text_line = 0;
-
-			if (plen) {
-				/* Copy original log prefix */
-				int i;
-
-				for (i = 0; i < plen; i++)
-					emit_log_char(printk_buf[i]);
-				printed_len += plen;
-			} else {
-				/* Add log prefix */
-				emit_log_char('<');
-				emit_log_char(current_log_level + '0');
-				emit_log_char('>');
-				printed_len += 3;
-			}
+	if (plen) {
+		t.prefix = ps->buf;
+		t.prefix_len = plen;
+	} else {
+		level[0] = '<';
+		level[1] = current_log_level + '0';
+		level[2] = '>';
+		t.prefix = level;
+		t.prefix_len = 3;
+	}
 
-			if (printk_time) {
-				/* Add the current time stamp */
-				char tbuf[50], *tp;
-				unsigned tlen;
-				unsigned long long t;
-				unsigned long nanosec_rem;
-
-				t = cpu_clock(printk_cpu);
-				nanosec_rem = do_div(t, 1000000000);
-				tlen = sprintf(tbuf, "[%5lu.%06lu] ",
-						(unsigned long) t,
-						nanosec_rem / 1000);
-
-				for (tp = tbuf; tp < tbuf + tlen; tp++)
-					emit_log_char(*tp);
-				printed_len += tlen;
-			}
+	ts_nsec = cpu_clock(this_cpu);
+	t.time = tbuf;
+	t.time_len = 0;
+	if (printk_time) {
+		unsigned long long secs = ts_nsec;
+		unsigned long nanosec_rem;
 
-			if (!*p)
-				break;
-		}
+		nanosec_rem = do_div(secs, 1000000000);
+		t.time_len = sprintf(tbuf, "[%5lu.%06lu] ",
+				     (unsigned long) secs, nanosec_rem / 1000);
+	}
 
-		emit_log_char(*p);
+	t.text = p;
+	t.len = ps->buf + printed_len - p;
+	t.lines = 0;
+	for (; p + 1 < t.text + t.len; p++)
 		if (*p == '\n')
-			new_text_line = 1;
-	}
+			t.lines++;
 
-	/*
-	 * Try to acquire and then immediately release the
-	 * console semaphore. The release will do all the
-	 * actual magic (print out buffers, wake up klogd,
-	 * etc). 
-	 *
-	 * The console_trylock_for_printk() function
-	 * will release 'logbuf_lock' regardless of whether it
-	 * actually gets the semaphore or not.
-	 */
-	if (console_trylock_for_printk(this_cpu))
-		console_unlock();
+	lockdep_off();
+	raw_local_irq_save(flags);
+	printed_len = log_store(&t, ts_nsec);
+	ps->busy = 0;
+
+	if (printk_direct()) {
+		/*
+		 * Try to acquire and then immediately release the
+		 * console semaphore. The release will do all the
+		 * actual magic (print out buffers, wake up klogd,
+		 * etc). If someone else holds it, they will print
+		 * the record on their way out of console_unlock().
+		 */
+		smp_mb();
+		if (console_trylock_for_printk(this_cpu))
+			console_unlock();
+	} else {
+		this_cpu_or(printk_pending, PRINTK_PENDING_CONSOLE);
+		wake_up_klogd();
+	}
 
 	lockdep_on();
-out_restore_irqs:
 	raw_local_irq_restore(flags);
-
+out:
 	preempt_enable();
 	return printed_len;
 }
 EXPORT_SYMBOL(printk);
 EXPORT_SYMBOL(vprintk);
 
+module_param_named(sync, printk_sync, bool, S_IRUGO | S_IWUSR);
+
+static int console_pending(void)
+{
+	return console_seq != ACCESS_ONCE(log_next_seq);
+}
+
+/* Tell the consoles about a gap where @count chars were lost. */
+static void console_dropped(unsigned count)
+{
+	char text[64];
+	int len = 0;
+
+	if (msg_level >= 0)
+		text[len++] = '\n';
+	len += scnprintf(text + len, sizeof(text) - len,
+			 "** %u printk chars dropped **\n", count);
+	msg_level = -1;
+
+	if ((4 < console_loglevel || ignore_loglevel) && console_drivers)
+		__call_console_drivers(text, len);
+}
+
+/*
+ * Feed the records the consoles have not seen yet to the console
+ * drivers, oldest first.  Each time, the text from where the consoles
+ * stopped to the end of the record is printed, which includes the text
+ * of records that were overwritten or are being.  Text that writers
+ * reused before it could be printed is reported at the gap.  The
+ * console_lock must be held.
+ */
+static void console_flush(int may_schedule)
+{
+	struct log_rec rec;
+	unsigned long flags;
+	unsigned next, start, end;
+
+	for (;;) {
+		next = ACCESS_ONCE(log_next_seq);
+		smp_rmb();
+		if (next - console_seq > LOG_REC_NR)
+			console_seq = next - LOG_REC_NR;
+		if (console_seq == next)
+			break;
+		if (!log_rec_get(console_seq++, &rec))
+			continue;
+
+		end = rec.start + rec.len;
+		if ((int)(end - console_idx) <= 0)
+			continue;
+		start = log_clamp(console_idx, end);
+
+		local_irq_save(flags);
+		stop_critical_timings();	/* don't trace print latency */
+		if (start != console_idx)
+			console_dropped(start - console_idx);
+		call_console_drivers(start, end);
+		console_idx = end;
+		start_critical_timings();
+		local_irq_restore(flags);
+
+		if (may_schedule)
+			cond_resched();
+	}
+}
+
+/*
+ * Point the consoles at the first text syslog() has not read yet, to
+ * replay the log to a new console.  The console_lock must be held.
+ */
+static void console_replay(void)
+{
+	struct log_rec rec;
+	unsigned long flags;
+	unsigned seq, start;
+	int n;
+
+	spin_lock_irqsave(&logbuf_lock, flags);
+	start = log_start;
+	spin_unlock_irqrestore(&logbuf_lock, flags);
+
+	seq = ACCESS_ONCE(log_next_seq);
+	smp_rmb();
+	for (n = 0; n < LOG_REC_NR; n++) {
+		if (!log_rec_get(seq - 1, &rec) ||
+		    (int)(rec.start - start) < 0 || !log_text_valid(rec.start))
+			break;
+		seq--;
+	}
+	console_seq = seq;
+	console_idx = start;
+}
+
+static int printk_thread_fn(void *unused)
+{
+	for (;;) {
+		set_current_state(TASK_INTERRUPTIBLE);
+		if (console_suspended || !console_pending())
+			schedule();
+		__set_current_state(TASK_RUNNING);
+
+		console_lock();
+		console_unlock();
+	}
+	return 0;
+}
+
+static int __init printk_thread_init(void)
+{
+	struct task_struct *thread;
+
+	thread = kthread_run(printk_thread_fn, NULL, "printk");
+	if (IS_ERR(thread)) {
+		pr_err("printk: cannot start console thread\n");
+		return PTR_ERR(thread);
+	}
+	printk_thread = thread;
+	return 0;
+}
+early_initcall(printk_thread_init);
+
 #else
 
-static void call_console_drivers(unsigned start, unsigned end)
+static inline int printk_direct(void)
+{
+	return 1;
+}
+
+static void console_flush(int may_schedule)
+{
+}
+
+static int console_pending(void)
+{
+	return 0;
+}
+
+static void console_replay(void)
 {
 }
 
@@ -1171,6 +1587,8 @@ __setup("no_console_suspend", console_suspend_disable);
  */
 void suspend_console(void)
 {
+	/* the printk kthread may not get to run again before we sleep */
+	printk_sync_suspend = 1;
 	if (!console_suspend_enabled)
 		return;
 	printk("Suspending console(s) (use no_console_suspend to debug)\n");
@@ -1182,10 +1600,12 @@ void suspend_console(void)
 void resume_console(void)
 {
 	if (!console_suspend_enabled)
-		return;
+		goto out;
 	down(&console_sem);
 	console_suspended = 0;
 	console_unlock();
+out:
+	printk_sync_suspend = 0;
 }
 
 /**
@@ -1259,13 +1679,16 @@ int is_console_locked(void)
 	return console_locked;
 }
 
-static DEFINE_PER_CPU(int, printk_pending);
-
 void printk_tick(void)
 {
-	if (__this_cpu_read(printk_pending)) {
+	int pending = __this_cpu_read(printk_pending);
+
+	if (pending) {
 		__this_cpu_write(printk_pending, 0);
-		wake_up_interruptible(&log_wait);
+		if (pending & PRINTK_PENDING_WAKEUP)
+			wake_up_interruptible(&log_wait);
+		if (pending & PRINTK_PENDING_CONSOLE)
+			wake_up_process(printk_thread);
 	}
 }
 
@@ -1279,7 +1702,7 @@ int printk_needs_cpu(int cpu)
 void wake_up_klogd(void)
 {
 	if (waitqueue_active(&log_wait))
-		this_cpu_write(printk_pending, 1);
+		this_cpu_or(printk_pending, PRINTK_PENDING_WAKEUP);
 }
 
 /**
@@ -1298,9 +1721,7 @@ void wake_up_klogd(void)
  */
 void console_unlock(void)
 {
-	unsigned long flags;
-	unsigned _con_start, _log_end;
-	unsigned wake_klogd = 0, retry = 0;
+	unsigned wake_klogd = 0;
 
 	if (console_suspended) {
 		up(&console_sem);
@@ -1310,41 +1731,26 @@ void console_unlock(void)
 	console_may_schedule = 0;
 
 again:
-	for ( ; ; ) {
-		spin_lock_irqsave(&logbuf_lock, flags);
-		wake_klogd |= log_start - log_end;
-		if (con_start == log_end)
-			break;			/* Nothing to print */
-		_con_start = con_start;
-		_log_end = log_end;
-		con_start = log_end;		/* Flush */
-		spin_unlock(&logbuf_lock);
-		stop_critical_timings();	/* don't trace print latency */
-		call_console_drivers(_con_start, _log_end);
-		start_critical_timings();
-		local_irq_restore(flags);
-	}
+	/* only the printk kthread knows that it may sleep here */
+	console_flush(current == printk_thread);
+	wake_klogd |= log_start - log_end;
 	console_locked = 0;
 
 	/* Release the exclusive_console once it is used */
 	if (unlikely(exclusive_console))
 		exclusive_console = NULL;
 
-	spin_unlock(&logbuf_lock);
-
 	up(&console_sem);
 
 	/*
 	 * Someone could have filled up the buffer again, so re-check if there's
 	 * something to flush. In case we cannot trylock the console_sem again,
 	 * there's a new owner and the console_unlock() from them will do the
-	 * flush, no worries.
+	 * flush, no worries.  Once the printk kthread runs, it is woken for
+	 * new output instead.  The barrier pairs with the one in vprintk().
 	 */
-	spin_lock(&logbuf_lock);
-	if (con_start != log_end)
-		retry = 1;
-	spin_unlock_irqrestore(&logbuf_lock, flags);
-	if (retry && console_trylock())
+	smp_mb();
+	if (printk_direct() && console_pending() && console_trylock())
 		goto again;
 
 	if (wake_klogd)
@@ -1465,7 +1871,6 @@ early_param("keep_bootcon", keep_bootcon_setup);
 void register_console(struct console *newcon)
 {
 	int i;
-	unsigned long flags;
 	struct console *bcon = NULL;
 
 	/*
@@ -1576,9 +1981,7 @@ void register_console(struct console *newcon)
 		 * console_unlock(); will print out the buffered messages
 		 * for us.
 		 */
-		spin_lock_irqsave(&logbuf_lock, flags);
-		con_start = log_start;
-		spin_unlock_irqrestore(&logbuf_lock, flags);
+		console_replay();
 		/*
 		 * We're about to replay the log buffer.  Only do this to the
 		 * just-registered console to avoid excessive message spam to
@@ -21,14 +21,18 @@
 #include <linux/console.h>
 #include <linux/cpumask.h>
 #include <linux/init.h>
+#include <linux/io.h>
 #include <linux/irqflags.h>
+#include <linux/lz4.h>
 #include <linux/module.h>
 #include <linux/moduleparam.h>
 #include <linux/mutex.h>
 #include <linux/notifier.h>
+#include <linux/platform_device.h>
 #include <linux/proc_fs.h>
 #include <linux/ring_buffer.h>
 #include <linux/sched.h>
+#include <linux/slab.h>
 #include <linux/smp.h>
 #include <linux/string.h>
 #include <linux/threads.h>
@@ -99,6 +103,7 @@ static struct pager_s {
 } pager;
 
 static char cmdline_buf[16+TASK_COMM_LEN];
+static int cmdline_pid;
 
 static int print_to_console(const char *buf, size_t len)
 {
@@ -292,20 +297,19 @@ static int pager_deinit(void)
  */
 static ssize_t cmdline_next(void)
 {
-	static int pid;
 	ssize_t size = 0;
 
-	if (pid >= PID_MAX_DEFAULT)
-		pid = -1;
+	if (cmdline_pid >= PID_MAX_DEFAULT)
+		cmdline_pid = -1;
 
-	while (size == 0 && pid < PID_MAX_DEFAULT) {
-		pid++;
-		trace_find_cmdline(pid, cmdline_buf);
+	while (size == 0 && cmdline_pid < PID_MAX_DEFAULT) {
+		cmdline_pid++;
+		trace_find_cmdline(cmdline_pid, cmdline_buf);
 		if (!strncmp(cmdline_buf, "<...>", 5))
 			continue;
 
 		sprintf(&cmdline_buf[strlen(cmdline_buf)], " %d"
-				     CMDLINE_DELIM, pid);
+				     CMDLINE_DELIM, cmdline_pid);
 		size = strlen(cmdline_buf);
 	}
 	return size;
@@ -658,6 +662,265 @@ static struct notifier_block tracedump_panic_notifier = {
 };
 #endif
 
+#ifdef CONFIG_TRACEDUMP_RAM
+/* Persistent RAM dump
+ *
+ * On panic, the raw ring buffer pages are read one CPU at a time in
+ * turn, LZ4 compressed a page at a time, and appended as records to a
+ * reserved memory region that survives a warm reboot. When the region
+ * is full the oldest records are overwritten, so the most recent pages
+ * of every CPU are kept. Everything is allocated at probe time: the
+ * panic path costs one page copy and one compression per ring buffer
+ * page, and never allocates.
+ *
+ * At probe, a dump left by the previous boot is copied out and shown
+ * in /proc/last_tracedump. See include/linux/tracedump.h for the format.
+ */
+static struct tracedump_ram_header *td_ram;
+static u8 *td_ram_data;
+static void *td_ram_spare;
+static void *td_ram_wrkmem;
+static u8 *td_ram_cbuf;
+
+static void *td_ram_old;
+static size_t td_ram_old_size;
+
+static u32 td_ram_rec_size(u32 off)
+{
+	struct tracedump_ram_record *rec = (void *)(td_ram_data + off);
+
+	return ALIGN(sizeof(*rec) + rec->clen, 4);
+}
+
+/* Drop the oldest records that start in the @len bytes at @off. */
+static void td_ram_make_room(u32 off, u32 len)
+{
+	struct tracedump_ram_header *hdr = td_ram;
+
+	while (hdr->count && hdr->tail >= off && hdr->tail < off + len) {
+		hdr->tail += td_ram_rec_size(hdr->tail);
+		hdr->count--;
+		if (hdr->tail == hdr->wrap) {
+			hdr->tail = 0;
+			hdr->wrap = 0;
+		}
+	}
+}
+
+static void td_ram_put(int type, int cpu, const void *buf, size_t len)
+{
+	struct tracedump_ram_header *hdr = td_ram;
+	struct tracedump_ram_record rec;
+	size_t clen = lz4_compressbound(PAGE_SIZE);
+	u32 off = hdr->head, size;
+
+	if (lz4_compress(buf, len, td_ram_cbuf, &clen, td_ram_wrkmem))
+		return;
+
+	size = ALIGN(sizeof(rec) + clen, 4);
+	if (size > hdr->size)
+		return;
+	if (off + size > hdr->size) {
+		td_ram_make_room(off, hdr->size - off);
+		hdr->wrap = off;
+		off = 0;
+	}
+	td_ram_make_room(off, size);
+
+	rec.type = type;
+	rec.cpu = cpu;
+	rec.len = len;
+	rec.clen = clen;
+	memcpy(td_ram_data + off, &rec, sizeof(rec));
+	memcpy(td_ram_data + off + sizeof(rec), td_ram_cbuf, clen);
+
+	hdr->head = off + size;
+	hdr->count++;
+}
+
+/* tracedump_ram_dump consumes the tracing ring buffers into the
+ * persistent RAM region. Returns the number of records kept.
+ */
+int tracedump_ram_dump(void)
+{
+	struct tracedump_ram_header *hdr = td_ram;
+	struct trace_array *tr;
+	int cpu, passes, active;
+	ssize_t size, used = 0;
+
+	if (!hdr)
+		return -ENODEV;
+
+	hdr->head = 0;
+	hdr->tail = 0;
+	hdr->wrap = 0;
+	hdr->count = 0;
+
+	trace_init_global_iter(&iter);
+	tr = iter.tr;
+	for_each_tracing_cpu(cpu)
+		atomic_inc(&tr->data[cpu]->disabled);
+
+	/* Only a CPU that is still writing can keep this going. */
+	passes = 2 * DIV_ROUND_UP(ring_buffer_size(tr->buffer), PAGE_SIZE) + 1;
+	do {
+		active = 0;
+		for_each_tracing_cpu(cpu) {
+			if (ring_buffer_read_page(tr->buffer, &td_ram_spare,
+						  PAGE_SIZE, cpu, 0) < 0)
+				continue;
+			td_ram_put(TD_RAM_REC_PAGE, cpu, td_ram_spare,
+				   PAGE_SIZE);
+			active = 1;
+		}
+	} while (active && --passes);
+
+	/* The spare page is free now; collect the cmdlines in it. */
+	cmdline_pid = 0;
+	while ((size = cmdline_next()) > 0) {
+		if (used + size > PAGE_SIZE) {
+			td_ram_put(TD_RAM_REC_CMDLINES, 0, td_ram_spare, used);
+			used = 0;
+		}
+		memcpy(td_ram_spare + used, cmdline_buf, size);
+		used += size;
+	}
+	if (used)
+		td_ram_put(TD_RAM_REC_CMDLINES, 0, td_ram_spare, used);
+
+	for_each_tracing_cpu(cpu)
+		atomic_dec(&tr->data[cpu]->disabled);
+
+	printk(TAG "%u records in persistent RAM\n", hdr->count);
+	return hdr->count;
+}
+
+static ssize_t td_ram_read_old(struct file *file, char __user *buf,
+			       size_t len, loff_t *offset)
+{
+	loff_t pos = *offset;
+	ssize_t count;
+
+	if (pos >= td_ram_old_size)
+		return 0;
+
+	count = min(len, (size_t)(td_ram_old_size - pos));
+	if (copy_to_user(buf, td_ram_old + pos, count))
+		return -EFAULT;
+
+	*offset += count;
+	return count;
+}
+
+static const struct file_operations td_ram_old_fops = {
+	.owner = THIS_MODULE,
+	.read = td_ram_read_old,
+};
+
+/* Keep a copy of the previous boot's dump if the header makes sense. */
+static void td_ram_save_old(struct tracedump_ram_header *hdr, size_t size)
+{
+	struct proc_dir_entry *entry;
+
+	if (hdr->sig != TD_RAM_SIG || hdr->version != TD_RAM_VERSION ||
+	    hdr->size != size || !hdr->count || hdr->head > size ||
+	    hdr->tail >= size || hdr->wrap > size) {
+		printk(KERN_INFO "tracedump: no dump in persistent RAM\n");
+		return;
+	}
+
+	td_ram_old_size = sizeof(*hdr) + size;
+	td_ram_old = vmalloc(td_ram_old_size);
+	if (!td_ram_old) {
+		printk(TAG "no memory for the previous dump\n");
+		return;
+	}
+	memcpy(td_ram_old, hdr, td_ram_old_size);
+
+	entry = create_proc_entry("last_tracedump", S_IFREG | S_IRUGO, NULL);
+	if (!entry) {
+		printk(TAG "failed to create last_tracedump\n");
+		vfree(td_ram_old);
+		td_ram_old = NULL;
+		return;
+	}
+	entry->proc_fops = &td_ram_old_fops;
+	entry->size = td_ram_old_size;
+	printk(KERN_INFO "tracedump: found %u records in persistent RAM\n",
+	       hdr->count);
+}
+
+static int td_ram_probe(struct platform_device *pdev)
+{
+	struct resource *res = platform_get_resource(pdev, IORESOURCE_MEM, 0);
+	struct tracedump_ram_header *hdr;
+	size_t size;
+
+	if (!res || resource_size(res) <= sizeof(*hdr) + PAGE_SIZE) {
+		printk(TAG "invalid persistent RAM resource\n");
+		return -ENXIO;
+	}
+	size = resource_size(res) - sizeof(*hdr);
+
+	trace_init_global_iter(&iter);
+	td_ram_spare = ring_buffer_alloc_read_page(iter.tr->buffer, 0);
+	td_ram_wrkmem = kmalloc(LZ4_MEM_COMPRESS, GFP_KERNEL);
+	td_ram_cbuf = kmalloc(lz4_compressbound(PAGE_SIZE), GFP_KERNEL);
+	hdr = ioremap(res->start, resource_size(res));
+	if (!td_ram_spare || !td_ram_wrkmem || !td_ram_cbuf || !hdr) {
+		printk(TAG "failed to set up persistent RAM\n");
+		goto err;
+	}
+
+	td_ram_save_old(hdr, size);
+
+	hdr->sig = TD_RAM_SIG;
+	hdr->version = TD_RAM_VERSION;
+	hdr->size = size;
+	hdr->head = 0;
+	hdr->tail = 0;
+	hdr->wrap = 0;
+	hdr->count = 0;
+	hdr->page_size = PAGE_SIZE;
+	td_ram_data = (u8 *)(hdr + 1);
+	td_ram = hdr;
+
+	printk(KERN_INFO "tracedump: %zu bytes of persistent RAM at %llx\n",
+	       size, (unsigned long long)res->start);
+	return 0;
+
+err:
+	if (hdr)
+		iounmap(hdr);
+	kfree(td_ram_cbuf);
+	kfree(td_ram_wrkmem);
+	if (td_ram_spare)
+		ring_buffer_free_read_page(iter.tr->buffer, td_ram_spare);
+	td_ram_spare = NULL;
+	return -ENOMEM;
+}
+
+static struct platform_driver td_ram_driver = {
+	.probe = td_ram_probe,
+	.driver = {
+		.name = "tracedump_ram",
+	},
+};
+
+static int tracedump_ram_panic_handler(struct notifier_block *this,
+				       unsigned long event, void *unused)
+{
+	tracedump_ram_dump();
+	return 0;
+}
+
+/* Ahead of the console dump, which consumes the raw pages. */
+static struct notifier_block tracedump_ram_panic_notifier = {
+	.notifier_call	= tracedump_ram_panic_handler,
+	.priority	= 200,
+};
+#endif
+
 static int __init tracedump_initcall(void)
 {
 #ifdef CONFIG_TRACEDUMP_PROCFS
@@ -676,6 +939,14 @@ static int __init tracedump_initcall(void)
 	atomic_notifier_chain_register(&panic_notifier_list,
 				       &tracedump_panic_notifier);
 #endif
+
+#ifdef CONFIG_TRACEDUMP_RAM
+	if (platform_driver_register(&td_ram_driver))
+		printk(TAG "failed to register persistent RAM driver\n");
+	else
+		atomic_notifier_chain_register(&panic_notifier_list,
+					       &tracedump_ram_panic_notifier);
+#endif
 	return 0;
 }
 
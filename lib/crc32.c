@@ -27,6 +27,10 @@
 #include <linux/types.h>
 #include <linux/init.h>
 #include <linux/atomic.h>
+#include <linux/hrtimer.h>
+#include <linux/moduleparam.h>
+#include <linux/slab.h>
+#include <linux/string.h>
 #include "crc32defs.h"
 #if CRC_LE_BITS == 8
 # define tole(x) __constant_cpu_to_le32(x)
@@ -47,24 +51,52 @@ MODULE_LICENSE("GPL");
 
 #if CRC_LE_BITS == 8 || CRC_BE_BITS == 8
 
-static inline u32
-crc32_body(u32 crc, unsigned char const *buf, size_t len, const u32 (*tab)[256])
-{
+/*
+ * Table-driven implementations. All of them take the crc in the byte
+ * order the tables were generated for (see tole()/tobe() above), so the
+ * same code serves crc32_le, crc32_be and crc32c:
+ *
+ *  sarwate     one table lookup per byte
+ *  slice-by-4  four lookups per 32-bit word, in independent tables
+ *  slice-by-8  eight lookups per 64 bits, twice the tables of slice-by-4
+ *
+ * Which one is fastest depends on the cache and load/store units of the
+ * cpu, so crc32_init() times them and picks the winner.
+ */
+typedef u32 (*crc32_body_t)(u32 crc, unsigned char const *buf, size_t len,
+			    const u32 (*tab)[256]);
+
 # ifdef __LITTLE_ENDIAN
-#  define DO_CRC(x) crc = tab[0][(crc ^ (x)) & 255] ^ (crc >> 8)
-#  define DO_CRC4 crc = tab[3][(crc) & 255] ^ \
-		tab[2][(crc >> 8) & 255] ^ \
-		tab[1][(crc >> 16) & 255] ^ \
-		tab[0][(crc >> 24) & 255]
+#  define DO_CRC(x) crc = t0[(crc ^ (x)) & 255] ^ (crc >> 8)
+#  define DO_CRC4(q) (t3[(q) & 255] ^ t2[((q) >> 8) & 255] ^ \
+		      t1[((q) >> 16) & 255] ^ t0[((q) >> 24) & 255])
+#  define DO_CRC8(q) (t7[(q) & 255] ^ t6[((q) >> 8) & 255] ^ \
+		      t5[((q) >> 16) & 255] ^ t4[((q) >> 24) & 255])
 # else
-#  define DO_CRC(x) crc = tab[0][((crc >> 24) ^ (x)) & 255] ^ (crc << 8)
-#  define DO_CRC4 crc = tab[0][(crc) & 255] ^ \
-		tab[1][(crc >> 8) & 255] ^ \
-		tab[2][(crc >> 16) & 255] ^ \
-		tab[3][(crc >> 24) & 255]
+#  define DO_CRC(x) crc = t0[((crc >> 24) ^ (x)) & 255] ^ (crc << 8)
+#  define DO_CRC4(q) (t0[(q) & 255] ^ t1[((q) >> 8) & 255] ^ \
+		      t2[((q) >> 16) & 255] ^ t3[((q) >> 24) & 255])
+#  define DO_CRC8(q) (t4[(q) & 255] ^ t5[((q) >> 8) & 255] ^ \
+		      t6[((q) >> 16) & 255] ^ t7[((q) >> 24) & 255])
 # endif
+
+static u32 crc32_body_sarwate(u32 crc, unsigned char const *buf, size_t len,
+			      const u32 (*tab)[256])
+{
+	const u32 *t0 = tab[0];
+
+	while (len--)
+		DO_CRC(*buf++);
+	return crc;
+}
+
+static u32 crc32_body_slice4(u32 crc, unsigned char const *buf, size_t len,
+			     const u32 (*tab)[256])
+{
+	const u32 *t0 = tab[0], *t1 = tab[1], *t2 = tab[2], *t3 = tab[3];
 	const u32 *b;
 	size_t    rem_len;
+	u32 q;
 
 	/* Align it */
 	if (unlikely((long)buf & 3 && len)) {
@@ -77,8 +109,8 @@ crc32_body(u32 crc, unsigned char const *buf, size_t len, const u32 (*tab)[256])
 	len = len >> 2;
 	b = (const u32 *)buf;
 	for (--b; len; --len) {
-		crc ^= *++b; /* use pre increment for speed */
-		DO_CRC4;
+		q = crc ^ *++b; /* use pre increment for speed */
+		crc = DO_CRC4(q);
 	}
 	len = rem_len;
 	/* And the last few bytes */
@@ -89,9 +121,89 @@ crc32_body(u32 crc, unsigned char const *buf, size_t len, const u32 (*tab)[256])
 		} while (--len);
 	}
 	return crc;
+}
+
+static u32 crc32_body_slice8(u32 crc, unsigned char const *buf, size_t len,
+			     const u32 (*tab)[256])
+{
+	const u32 *t0 = tab[0], *t1 = tab[1], *t2 = tab[2], *t3 = tab[3];
+	const u32 *t4 = tab[4], *t5 = tab[5], *t6 = tab[6], *t7 = tab[7];
+	const u32 *b;
+	size_t    rem_len;
+	u32 q;
+
+	/* Align it */
+	if (unlikely((long)buf & 3 && len)) {
+		do {
+			DO_CRC(*buf++);
+		} while ((--len) && ((long)buf)&3);
+	}
+	rem_len = len & 7;
+	/* load data 2 x 32 bits wide, the first word xor'ed with the crc */
+	len = len >> 3;
+	b = (const u32 *)buf;
+	for (--b; len; --len) {
+		q = crc ^ *++b; /* use pre increment for speed */
+		crc = DO_CRC8(q);
+		q = *++b;
+		crc ^= DO_CRC4(q);
+	}
+	len = rem_len;
+	/* And the last few bytes */
+	if (len) {
+		u8 *p = (u8 *)(b + 1) - 1;
+		do {
+			DO_CRC(*++p); /* use pre increment for speed */
+		} while (--len);
+	}
+	return crc;
+}
 #undef DO_CRC
 #undef DO_CRC4
+#undef DO_CRC8
+
+static const struct {
+	const char	*name;
+	crc32_body_t	body;
+} crc32_impls[] = {
+	{ "sarwate",	crc32_body_sarwate },
+	{ "slice-by-4",	crc32_body_slice4 },
+	{ "slice-by-8",	crc32_body_slice8 },
+};
+
+/* used until crc32_init() has timed the others */
+static crc32_body_t crc32_body __read_mostly = crc32_body_slice8;
+
+static char *impl;
+module_param(impl, charp, 0444);
+MODULE_PARM_DESC(impl, "Table-driven implementation to use (sarwate, "
+		 "slice-by-4, slice-by-8); the fastest one by default");
+
+/**
+ * crc32_impl_name() - name of a table-driven crc32 implementation
+ * @n: implementation number, from 0
+ *
+ * Returns NULL once @n is past the last one. Together with crc32_le_impl(),
+ * crc32_be_impl() and __crc32c_le_impl() this lets lib/crc32test.c check
+ * every implementation, not just the one in use.
+ */
+const char *crc32_impl_name(unsigned int n)
+{
+	return n < ARRAY_SIZE(crc32_impls) ? crc32_impls[n].name : NULL;
+}
+EXPORT_SYMBOL_GPL(crc32_impl_name);
+
+static crc32_body_t crc32_impl_body(unsigned int n)
+{
+	return n < ARRAY_SIZE(crc32_impls) ? crc32_impls[n].body : crc32_body;
+}
+
+#else
+const char *crc32_impl_name(unsigned int n)
+{
+	return n ? NULL : "generic";
 }
+EXPORT_SYMBOL_GPL(crc32_impl_name);
 #endif
 /**
  * crc32_le() - Calculate bitwise little-endian Ethernet AUTODIN II CRC32
@@ -120,34 +232,115 @@ u32 __pure crc32_le(u32 crc, unsigned char const *p, size_t len)
 }
 #else				/* Table-based approach */
 
-u32 __pure crc32_le(u32 crc, unsigned char const *p, size_t len)
-{
 # if CRC_LE_BITS == 8
-	const u32      (*tab)[] = crc32table_le;
-
+static inline u32 crc32_le_body(crc32_body_t body, u32 crc,
+				unsigned char const *p, size_t len,
+				const u32 (*tab)[256])
+{
 	crc = __cpu_to_le32(crc);
-	crc = crc32_body(crc, p, len, tab);
+	crc = body(crc, p, len, tab);
 	return __le32_to_cpu(crc);
+}
+
+u32 crc32_le_impl(unsigned int n, u32 crc, unsigned char const *p,
+		  size_t len)
+{
+	return crc32_le_body(crc32_impl_body(n), crc, p, len, crc32table_le);
+}
+EXPORT_SYMBOL_GPL(crc32_le_impl);
+
+/**
+ * __crc32c_le() - Calculate the little-endian CRC32c (Castagnoli)
+ * @crc: seed value for computation, or the previous value
+ * @p: pointer to buffer over which CRC is run
+ * @len: length of buffer @p
+ *
+ * Like crc32_le(), the seed is neither inverted on the way in nor on the
+ * way out; crypto/crc32c.c does that for the "crc32c" hash.
+ */
+u32 __pure __crc32c_le(u32 crc, unsigned char const *p, size_t len)
+{
+	return crc32_le_body(crc32_body, crc, p, len, crc32ctable_le);
+}
+EXPORT_SYMBOL(__crc32c_le);
+
+u32 __crc32c_le_impl(unsigned int n, u32 crc, unsigned char const *p,
+		     size_t len)
+{
+	return crc32_le_body(crc32_impl_body(n), crc, p, len, crc32ctable_le);
+}
+EXPORT_SYMBOL_GPL(__crc32c_le_impl);
+# endif
+
+u32 __pure crc32_le(u32 crc, unsigned char const *p, size_t len)
+{
+# if CRC_LE_BITS == 8
+	return crc32_le_body(crc32_body, crc, p, len, crc32table_le);
 # elif CRC_LE_BITS == 4
 	while (len--) {
 		crc ^= *p++;
-		crc = (crc >> 4) ^ crc32table_le[crc & 15];
-		crc = (crc >> 4) ^ crc32table_le[crc & 15];
+		crc = (crc >> 4) ^ crc32table_le[0][crc & 15];
+		crc = (crc >> 4) ^ crc32table_le[0][crc & 15];
 	}
 	return crc;
 # elif CRC_LE_BITS == 2
 	while (len--) {
 		crc ^= *p++;
-		crc = (crc >> 2) ^ crc32table_le[crc & 3];
-		crc = (crc >> 2) ^ crc32table_le[crc & 3];
-		crc = (crc >> 2) ^ crc32table_le[crc & 3];
-		crc = (crc >> 2) ^ crc32table_le[crc & 3];
+		crc = (crc >> 2) ^ crc32table_le[0][crc & 3];
+		crc = (crc >> 2) ^ crc32table_le[0][crc & 3];
+		crc = (crc >> 2) ^ crc32table_le[0][crc & 3];
+		crc = (crc >> 2) ^ crc32table_le[0][crc & 3];
 	}
 	return crc;
 # endif
 }
 #endif
 
+#if CRC_LE_BITS != 8
+/* without the byte-wide tables there is only the one implementation */
+u32 crc32_le_impl(unsigned int n, u32 crc, unsigned char const *p,
+		  size_t len)
+{
+	return crc32_le(crc, p, len);
+}
+EXPORT_SYMBOL_GPL(crc32_le_impl);
+
+u32 __pure __crc32c_le(u32 crc, unsigned char const *p, size_t len)
+{
+# if CRC_LE_BITS == 1
+	int i;
+	while (len--) {
+		crc ^= *p++;
+		for (i = 0; i < 8; i++)
+			crc = (crc >> 1) ^ ((crc & 1) ? CRC32C_POLY_LE : 0);
+	}
+# elif CRC_LE_BITS == 4
+	while (len--) {
+		crc ^= *p++;
+		crc = (crc >> 4) ^ crc32ctable_le[0][crc & 15];
+		crc = (crc >> 4) ^ crc32ctable_le[0][crc & 15];
+	}
+# elif CRC_LE_BITS == 2
+	while (len--) {
+		crc ^= *p++;
+		crc = (crc >> 2) ^ crc32ctable_le[0][crc & 3];
+		crc = (crc >> 2) ^ crc32ctable_le[0][crc & 3];
+		crc = (crc >> 2) ^ crc32ctable_le[0][crc & 3];
+		crc = (crc >> 2) ^ crc32ctable_le[0][crc & 3];
+	}
+# endif
+	return crc;
+}
+EXPORT_SYMBOL(__crc32c_le);
+
+u32 __crc32c_le_impl(unsigned int n, u32 crc, unsigned char const *p,
+		     size_t len)
+{
+	return __crc32c_le(crc, p, len);
+}
+EXPORT_SYMBOL_GPL(__crc32c_le_impl);
+#endif
+
 /**
  * crc32_be() - Calculate bitwise big-endian Ethernet AUTODIN II CRC32
  * @crc: seed value for computation.  ~0 for Ethernet, sometimes 0 for
@@ -177,37 +370,141 @@ u32 __pure crc32_be(u32 crc, unsigned char const *p, size_t len)
 }
 
 #else				/* Table-based approach */
-u32 __pure crc32_be(u32 crc, unsigned char const *p, size_t len)
-{
-# if CRC_BE_BITS == 8
-	const u32      (*tab)[] = crc32table_be;
 
+# if CRC_BE_BITS == 8
+static inline u32 crc32_be_body(crc32_body_t body, u32 crc,
+				unsigned char const *p, size_t len)
+{
 	crc = __cpu_to_be32(crc);
-	crc = crc32_body(crc, p, len, tab);
+	crc = body(crc, p, len, crc32table_be);
 	return __be32_to_cpu(crc);
+}
+
+u32 crc32_be_impl(unsigned int n, u32 crc, unsigned char const *p,
+		  size_t len)
+{
+	return crc32_be_body(crc32_impl_body(n), crc, p, len);
+}
+EXPORT_SYMBOL_GPL(crc32_be_impl);
+# endif
+
+u32 __pure crc32_be(u32 crc, unsigned char const *p, size_t len)
+{
+# if CRC_BE_BITS == 8
+	return crc32_be_body(crc32_body, crc, p, len);
 # elif CRC_BE_BITS == 4
 	while (len--) {
 		crc ^= *p++ << 24;
-		crc = (crc << 4) ^ crc32table_be[crc >> 28];
-		crc = (crc << 4) ^ crc32table_be[crc >> 28];
+		crc = (crc << 4) ^ crc32table_be[0][crc >> 28];
+		crc = (crc << 4) ^ crc32table_be[0][crc >> 28];
 	}
 	return crc;
 # elif CRC_BE_BITS == 2
 	while (len--) {
 		crc ^= *p++ << 24;
-		crc = (crc << 2) ^ crc32table_be[crc >> 30];
-		crc = (crc << 2) ^ crc32table_be[crc >> 30];
-		crc = (crc << 2) ^ crc32table_be[crc >> 30];
-		crc = (crc << 2) ^ crc32table_be[crc >> 30];
+		crc = (crc << 2) ^ crc32table_be[0][crc >> 30];
+		crc = (crc << 2) ^ crc32table_be[0][crc >> 30];
+		crc = (crc << 2) ^ crc32table_be[0][crc >> 30];
+		crc = (crc << 2) ^ crc32table_be[0][crc >> 30];
 	}
 	return crc;
 # endif
 }
 #endif
 
+#if CRC_BE_BITS != 8
+u32 crc32_be_impl(unsigned int n, u32 crc, unsigned char const *p,
+		  size_t len)
+{
+	return crc32_be(crc, p, len);
+}
+EXPORT_SYMBOL_GPL(crc32_be_impl);
+#endif
+
 EXPORT_SYMBOL(crc32_le);
 EXPORT_SYMBOL(crc32_be);
 
+#if CRC_LE_BITS == 8 || CRC_BE_BITS == 8
+
+#define CRC32_BENCH_LEN		4096
+#define CRC32_BENCH_LOOPS	8
+#define CRC32_BENCH_RUNS	3
+
+/* any byte-wide table will do, the bodies take the same time on all */
+#if CRC_LE_BITS == 8
+# define CRC32_BENCH_TABLE	crc32table_le
+#else
+# define CRC32_BENCH_TABLE	crc32table_be
+#endif
+
+/* keeps the compiler from dropping the timed loops */
+static u32 crc32_bench_sink __initdata;
+
+/* best time of a few runs over a 4k buffer, in ns */
+static u64 __init crc32_bench(crc32_body_t body, unsigned char const *buf)
+{
+	u64 best = ~0ULL;
+	u32 crc = 0;
+	int run, i;
+
+	for (run = 0; run < CRC32_BENCH_RUNS; run++) {
+		ktime_t start;
+		u64 ns;
+
+		preempt_disable();
+		start = ktime_get();
+		for (i = 0; i < CRC32_BENCH_LOOPS; i++)
+			crc = body(crc, buf, CRC32_BENCH_LEN,
+				   CRC32_BENCH_TABLE);
+		ns = ktime_to_ns(ktime_sub(ktime_get(), start));
+		preempt_enable();
+		best = min(best, ns);
+	}
+	crc32_bench_sink ^= crc;
+	return best;
+}
+
+static int __init crc32_init(void)
+{
+	unsigned char *buf;
+	u64 ns, best_ns = ~0ULL;
+	int i, best = -1;
+
+	for (i = 0; impl && i < ARRAY_SIZE(crc32_impls); i++) {
+		if (!strcmp(impl, crc32_impls[i].name)) {
+			crc32_body = crc32_impls[i].body;
+			pr_info("crc32: using %s\n", crc32_impls[i].name);
+			return 0;
+		}
+	}
+	if (impl)
+		pr_warn("crc32: unknown implementation %s\n", impl);
+
+	buf = kmalloc(CRC32_BENCH_LEN, GFP_KERNEL);
+	if (!buf)
+		return 0;
+	for (i = 0; i < CRC32_BENCH_LEN; i++)
+		buf[i] = i * 131 + (i >> 8);
+
+	for (i = 0; i < ARRAY_SIZE(crc32_impls); i++) {
+		ns = crc32_bench(crc32_impls[i].body, buf);
+		if (ns < best_ns) {
+			best_ns = ns;
+			best = i;
+		}
+	}
+	kfree(buf);
+
+	crc32_body = crc32_impls[best].body;
+	impl = (char *)crc32_impls[best].name;
+	pr_info("crc32: using %s, %llu MB/s\n", impl,
+		div64_u64((u64)CRC32_BENCH_LEN * CRC32_BENCH_LOOPS * 1000,
+			  best_ns ? best_ns : 1));
+	return 0;
+}
+module_init(crc32_init);
+#endif
+
 /*
  * A brief CRC tutorial.
  *
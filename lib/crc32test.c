@@ -0,0 +1,119 @@
+/*
+ * Cross-check every table-driven crc32 implementation in lib/crc32.c,
+ * for crc32_le, crc32_be and crc32c, against a bit-at-a-time reference,
+ * over all alignments and a range of lengths.
+ *
+ * This source code is licensed under the GNU General Public License,
+ * Version 2.  See the file COPYING for more details.
+ */
+
+#include <linux/crc32.h>
+#include <linux/init.h>
+#include <linux/kernel.h>
+#include <linux/module.h>
+#include <linux/random.h>
+#include <linux/slab.h>
+#include "crc32defs.h"
+
+#define TEST_BUF_LEN	2048
+#define TEST_ALIGN	8
+
+static u32 __init ref_le(u32 poly, u32 crc, const u8 *p, size_t len)
+{
+	int i;
+
+	while (len--) {
+		crc ^= *p++;
+		for (i = 0; i < 8; i++)
+			crc = (crc >> 1) ^ ((crc & 1) ? poly : 0);
+	}
+	return crc;
+}
+
+static u32 __init ref_be(u32 crc, const u8 *p, size_t len)
+{
+	int i;
+
+	while (len--) {
+		crc ^= *p++ << 24;
+		for (i = 0; i < 8; i++)
+			crc = (crc << 1) ^
+				((crc & 0x80000000) ? CRCPOLY_BE : 0);
+	}
+	return crc;
+}
+
+static int __init check_crc(const char *what, const char *impl, u32 got,
+			    u32 want, size_t off, size_t len)
+{
+	if (got == want)
+		return 0;
+	pr_err("crc32test: error: %s %s off %zu len %zu: %08x, want %08x\n",
+	       what, impl, off, len, got, want);
+	return -EINVAL;
+}
+
+/* the usual check values, over "123456789" */
+static int __init test_vectors(void)
+{
+	static const unsigned char s[] __initconst = "123456789";
+
+	return check_crc("crc32_le", "in use", crc32_le(~0, s, 9) ^ ~0,
+			 0xcbf43926, 0, 9) ?:
+	       check_crc("crc32_be", "in use", crc32_be(~0, s, 9) ^ ~0,
+			 0xfc891918, 0, 9) ?:
+	       check_crc("crc32c", "in use", __crc32c_le(~0, s, 9) ^ ~0,
+			 0xe3069283, 0, 9);
+}
+
+static int __init test_impl(unsigned int n, const u8 *buf, size_t off,
+			    size_t len)
+{
+	const char *name = crc32_impl_name(n);
+	const u8 *p = buf + off;
+	u32 seed = random32();
+
+	return check_crc("crc32_le", name, crc32_le_impl(n, seed, p, len),
+			 ref_le(CRCPOLY_LE, seed, p, len), off, len) ?:
+	       check_crc("crc32_be", name, crc32_be_impl(n, seed, p, len),
+			 ref_be(seed, p, len), off, len) ?:
+	       check_crc("crc32c", name, __crc32c_le_impl(n, seed, p, len),
+			 ref_le(CRC32C_POLY_LE, seed, p, len), off, len);
+}
+
+static int __init test_crc32_init(void)
+{
+	size_t off, len;
+	unsigned int n;
+	int err;
+	u8 *buf;
+
+	buf = kmalloc(TEST_BUF_LEN + TEST_ALIGN, GFP_KERNEL);
+	if (!buf)
+		return -ENOMEM;
+	for (len = 0; len < TEST_BUF_LEN + TEST_ALIGN; len++)
+		buf[len] = random32();
+
+	err = test_vectors();
+	for (n = 0; !err && crc32_impl_name(n); n++) {
+		for (off = 0; !err && off < TEST_ALIGN; off++) {
+			/* every short length, then larger strides */
+			for (len = 0; !err && len <= TEST_BUF_LEN;
+			     len += len < 64 ? 1 : 61)
+				err = test_impl(n, buf, off, len);
+			if (!err)
+				err = test_impl(n, buf, off, TEST_BUF_LEN);
+		}
+	}
+	kfree(buf);
+	return err;
+}
+module_init(test_crc32_init);
+
+static void __exit test_crc32_exit(void)
+{
+}
+module_exit(test_crc32_exit);
+
+MODULE_DESCRIPTION("crc32 implementation cross-check");
+MODULE_LICENSE("GPL");
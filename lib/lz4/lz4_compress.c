@@ -0,0 +1,164 @@
+/*
+ *  LZ4 Compressor
+ *
+ *  Greedy single-pass match finder over a 4096 entry hash table of
+ *  4 byte sequences, producing the LZ4 block format.  Incompressible
+ *  input is skipped over with a growing stride, which keeps the cost of
+ *  random data close to that of a memcpy().
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License version 2 as
+ *  published by the Free Software Foundation.
+ */
+
+#include <linux/module.h>
+#include <linux/kernel.h>
+#include <linux/string.h>
+#include <linux/lz4.h>
+#include <asm/unaligned.h>
+#include "lz4defs.h"
+
+static inline u32 lz4_hash(const unsigned char *p)
+{
+	return (get_unaligned((const u32 *)p) * 2654435761U) >>
+		(32 - HASH_LOG);
+}
+
+/* Number of bytes that match at @ip and @ref, stopping at @limit. */
+static inline size_t lz4_count(const unsigned char *ip,
+			       const unsigned char *ref,
+			       const unsigned char *limit)
+{
+	const unsigned char *start = ip;
+
+	while (ip + 4 <= limit &&
+	       get_unaligned((const u32 *)ip) ==
+	       get_unaligned((const u32 *)ref)) {
+		ip += 4;
+		ref += 4;
+	}
+	while (ip < limit && *ip == *ref) {
+		ip++;
+		ref++;
+	}
+	return ip - start;
+}
+
+/* Length extension bytes for a nibble that saturated at 15. */
+static inline unsigned char *lz4_put_len(unsigned char *op, size_t len)
+{
+	while (len >= 255) {
+		*op++ = 255;
+		len -= 255;
+	}
+	*op++ = len;
+	return op;
+}
+
+/* Room needed for @lit literals with their token and length bytes */
+static inline size_t lz4_lit_room(size_t lit)
+{
+	return 1 + lit + (lit >= RUN_MASK ? (lit - RUN_MASK) / 255 + 1 : 0);
+}
+
+int lz4_compress(const unsigned char *src, size_t src_len,
+		unsigned char *dst, size_t *dst_len, void *wrkmem)
+{
+	const unsigned char * const in_end = src + src_len;
+	const unsigned char * const mflimit = in_end - MFLIMIT;
+	const unsigned char * const matchlimit = in_end - LAST_LITERALS;
+	unsigned char * const op_end = dst + *dst_len;
+	const unsigned char *ip = src, *anchor = src, *ref;
+	unsigned char *op = dst, *token;
+	u32 *table = wrkmem;
+	size_t lit, len;
+	unsigned int skip;
+	u32 h;
+
+	if (src_len < MFLIMIT + 1)
+		goto last_literals;
+
+	memset(table, 0, LZ4_MEM_COMPRESS);
+	table[lz4_hash(ip)] = 0;
+	ip++;
+
+	for (;;) {
+		/* find a match, striding faster the longer we fail */
+		skip = 1 << SKIP_TRIGGER;
+		for (;;) {
+			if (unlikely(ip > mflimit))
+				goto last_literals;
+			h = lz4_hash(ip);
+			ref = src + table[h];
+			table[h] = ip - src;
+			if (ref < ip && ip - ref <= MAX_DISTANCE &&
+			    get_unaligned((const u32 *)ref) ==
+			    get_unaligned((const u32 *)ip))
+				break;
+			ip += skip++ >> SKIP_TRIGGER;
+		}
+
+		/* extend it backwards over the pending literals */
+		while (ip > anchor && ref > src && ip[-1] == ref[-1]) {
+			ip--;
+			ref--;
+		}
+
+		len = lz4_count(ip + MINMATCH, ref + MINMATCH, matchlimit);
+
+		/* literals, offset, and the match length bytes */
+		lit = ip - anchor;
+		if (unlikely(lz4_lit_room(lit) + 2 + len / 255 + 1 >
+			     (size_t)(op_end - op)))
+			return LZ4_E_OUTPUT_OVERRUN;
+
+		token = op++;
+		if (lit >= RUN_MASK) {
+			*token = RUN_MASK << ML_BITS;
+			op = lz4_put_len(op, lit - RUN_MASK);
+		} else {
+			*token = lit << ML_BITS;
+		}
+		memcpy(op, anchor, lit);
+		op += lit;
+
+		put_unaligned_le16(ip - ref, op);
+		op += 2;
+
+		if (len >= ML_MASK) {
+			*token |= ML_MASK;
+			op = lz4_put_len(op, len - ML_MASK);
+		} else {
+			*token |= len;
+		}
+
+		ip += MINMATCH + len;
+		anchor = ip;
+		if (ip > mflimit)
+			break;
+
+		/* let the bytes inside the match be found again */
+		table[lz4_hash(ip - 2)] = ip - 2 - src;
+	}
+
+last_literals:
+	lit = in_end - anchor;
+	if (unlikely(lz4_lit_room(lit) > (size_t)(op_end - op)))
+		return LZ4_E_OUTPUT_OVERRUN;
+
+	if (lit >= RUN_MASK) {
+		*op++ = RUN_MASK << ML_BITS;
+		op = lz4_put_len(op, lit - RUN_MASK);
+	} else {
+		*op++ = lit << ML_BITS;
+	}
+	memcpy(op, anchor, lit);
+	op += lit;
+
+	*dst_len = op - dst;
+	return LZ4_E_OK;
+}
+EXPORT_SYMBOL_GPL(lz4_compress);
+
+MODULE_LICENSE("GPL");
+MODULE_DESCRIPTION("LZ4 Compressor");
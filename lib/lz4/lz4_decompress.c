@@ -0,0 +1,134 @@
+/*
+ *  LZ4 Decompressor
+ *
+ *  Every length and offset read from the stream is checked against the
+ *  input and output bounds, so corrupt or hostile blocks fail cleanly.
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License version 2 as
+ *  published by the Free Software Foundation.
+ */
+
+#include <linux/module.h>
+#include <linux/kernel.h>
+#include <linux/string.h>
+#include <linux/lz4.h>
+#include <asm/unaligned.h>
+#include "lz4defs.h"
+
+#define HAVE_IP(x)	((size_t)(ip_end - ip) >= (size_t)(x))
+#define HAVE_OP(x)	((size_t)(op_end - op) >= (size_t)(x))
+#define NEED_IP(x)	if (!HAVE_IP(x)) goto input_overrun
+#define NEED_OP(x)	if (!HAVE_OP(x)) goto output_overrun
+
+int lz4_decompress_safe(const unsigned char *src, size_t src_len,
+		unsigned char *dst, size_t *dst_len)
+{
+	const unsigned char * const ip_end = src + src_len;
+	unsigned char * const op_end = dst + *dst_len;
+	const unsigned char *ip = src, *ref;
+	unsigned char *op = dst, *oe;
+	unsigned int token, s;
+	size_t len;
+
+	for (;;) {
+		NEED_IP(1);
+		token = *ip++;
+
+		/* literals; a length can never exceed the input left */
+		len = token >> ML_BITS;
+		if (len == RUN_MASK) {
+			do {
+				NEED_IP(1);
+				s = *ip++;
+				len += s;
+				NEED_IP(len);
+			} while (s == 255);
+		}
+		NEED_IP(len);
+		NEED_OP(len);
+#ifdef LZ4_FAST_COPY
+		if (likely(HAVE_IP(len + 8) && HAVE_OP(len + 8))) {
+			const unsigned char *ie = ip + len;
+
+			oe = op + len;
+			do {
+				COPY8(op, ip);
+				op += 8;
+				ip += 8;
+			} while (op < oe);
+			ip = ie;
+			op = oe;
+		} else
+#endif
+		{
+			memcpy(op, ip, len);
+			op += len;
+			ip += len;
+		}
+
+		/* the last sequence has no match */
+		if (ip == ip_end)
+			break;
+
+		NEED_IP(2);
+		len = get_unaligned_le16(ip);
+		ip += 2;
+		if (unlikely(!len || len > (size_t)(op - dst)))
+			goto lookbehind_overrun;
+		ref = op - len;
+
+		len = token & ML_MASK;
+		if (len == ML_MASK) {
+			do {
+				NEED_IP(1);
+				s = *ip++;
+				len += s;
+				NEED_OP(len);
+			} while (s == 255);
+		}
+		len += MINMATCH;
+		NEED_OP(len);
+
+		oe = op + len;
+#ifdef LZ4_FAST_COPY
+		/* a word read never covers a byte that is not written yet */
+		if (op - ref >= 8 && HAVE_OP(len + 8)) {
+			do {
+				COPY8(op, ref);
+				op += 8;
+				ref += 8;
+			} while (op < oe);
+			op = oe;
+			continue;
+		}
+#endif
+		if (len >= LZ4_MEMCPY_MIN && op - ref >= len) {
+			memcpy(op, ref, len);
+			op = oe;
+		} else {
+			do {
+				*op++ = *ref++;
+			} while (op < oe);
+		}
+	}
+
+	*dst_len = op - dst;
+	return LZ4_E_OK;
+
+input_overrun:
+	*dst_len = op - dst;
+	return LZ4_E_INPUT_OVERRUN;
+
+output_overrun:
+	*dst_len = op - dst;
+	return LZ4_E_OUTPUT_OVERRUN;
+
+lookbehind_overrun:
+	*dst_len = op - dst;
+	return LZ4_E_LOOKBEHIND_OVERRUN;
+}
+EXPORT_SYMBOL_GPL(lz4_decompress_safe);
+
+MODULE_LICENSE("GPL");
+MODULE_DESCRIPTION("LZ4 Decompressor");
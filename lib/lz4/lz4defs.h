@@ -0,0 +1,45 @@
+/*
+ *  lz4defs.h -- LZ4 block format constants and copy helpers
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License version 2 as
+ *  published by the Free Software Foundation.
+ */
+
+/*
+ * A sequence is a token byte (literal count in the high nibble, match
+ * length - MINMATCH in the low one, 15 meaning "more bytes follow"),
+ * the literals, and a 16-bit little endian match offset.  The last
+ * sequence of a block has literals only.
+ */
+#define MINMATCH	4
+#define ML_BITS		4
+#define ML_MASK		((1U << ML_BITS) - 1)
+#define RUN_BITS	(8 - ML_BITS)
+#define RUN_MASK	((1U << RUN_BITS) - 1)
+#define MAX_DISTANCE	0xffff
+
+/* a block ends with at least this many literals */
+#define LAST_LITERALS	5
+/* and its last match starts at least this far from the end */
+#define MFLIMIT		12
+
+#define HASH_LOG	12
+#define SKIP_TRIGGER	6
+
+/* as for LZO: cheap unaligned words, or memcpy() and bytes */
+#ifdef CONFIG_HAVE_EFFICIENT_UNALIGNED_ACCESS
+#define LZ4_FAST_COPY
+
+#define COPY4(dst, src)	\
+		put_unaligned(get_unaligned((const u32 *)(src)), (u32 *)(dst))
+#ifdef CONFIG_64BIT
+#define COPY8(dst, src)	\
+		put_unaligned(get_unaligned((const u64 *)(src)), (u64 *)(dst))
+#else
+#define COPY8(dst, src)	\
+		do { COPY4(dst, src); COPY4((dst) + 4, (src) + 4); } while (0)
+#endif
+#endif
+
+#define LZ4_MEMCPY_MIN	8
@@ -0,0 +1,432 @@
+/*
+ * Round-trip, fuzz and throughput tests for the LZO1X decompressor and,
+ * with CONFIG_TEST_LZ4, the LZ4 compressor and decompressor.
+ *
+ * Generated buffers of assorted content, length and alignment are
+ * compressed and must decompress to the same bytes; corrupted and
+ * truncated streams must fail without writing past the output buffer,
+ * and so must compression into a buffer that is too small, where the
+ * compressor checks for it.  The benchmark compresses and decompresses
+ * a corpus of pages copied from lowmem with each codec, which is about
+ * what zram and swap see.
+ *
+ * This source code is licensed under the GNU General Public License,
+ * Version 2.  See the file COPYING for more details.
+ */
+
+#include <linux/hrtimer.h>
+#include <linux/init.h>
+#include <linux/kernel.h>
+#include <linux/lz4.h>
+#include <linux/lzo.h>
+#include <linux/math64.h>
+#include <linux/mm.h>
+#include <linux/mmzone.h>
+#include <linux/module.h>
+#include <linux/random.h>
+#include <linux/sched.h>
+#include <linux/slab.h>
+#include <linux/vmalloc.h>
+
+#define TEST_BUF_LEN	(2 * PAGE_SIZE)
+#define TEST_ALIGN	8
+#define GUARD_LEN	64
+#define GUARD_BYTE	0xa5
+
+static unsigned int fuzz_rounds = 20000;
+module_param(fuzz_rounds, uint, 0);
+MODULE_PARM_DESC(fuzz_rounds, "Number of corrupted streams to decode");
+
+static unsigned int bench_pages = 256;
+module_param(bench_pages, uint, 0);
+MODULE_PARM_DESC(bench_pages, "Number of lowmem pages in the corpus");
+
+static unsigned int bench_loops = 16;
+module_param(bench_loops, uint, 0);
+MODULE_PARM_DESC(bench_loops, "Number of passes over the corpus");
+
+struct lzotest_codec {
+	const char *name;
+	size_t (*worst)(size_t len);
+	size_t wrkmem;
+	int (*compress)(const unsigned char *src, size_t src_len,
+			unsigned char *dst, size_t *dst_len, void *wrkmem);
+	int (*decompress)(const unsigned char *src, size_t src_len,
+			  unsigned char *dst, size_t *dst_len);
+	int output_overrun;	/* what a short output buffer returns */
+	bool bounded;		/* compress() honours *dst_len */
+	bool terminated;	/* a stream ends in an end marker */
+};
+
+static size_t __init lzo_worst(size_t len)
+{
+	return lzo1x_worst_compress(len);
+}
+
+#ifdef CONFIG_TEST_LZ4
+static size_t __init lz4_worst(size_t len)
+{
+	return lz4_compressbound(len);
+}
+#endif
+
+static const struct lzotest_codec codecs[] __initconst = {
+	{ "lzo", lzo_worst, LZO1X_MEM_COMPRESS, lzo1x_1_compress,
+	  lzo1x_decompress_safe, LZO_E_OUTPUT_OVERRUN, false, true },
+#ifdef CONFIG_TEST_LZ4
+	{ "lz4", lz4_worst, LZ4_MEM_COMPRESS, lz4_compress,
+	  lz4_decompress_safe, LZ4_E_OUTPUT_OVERRUN, true, false },
+#endif
+};
+
+/* the most any codec needs, for buffers shared between them */
+static size_t __init worst_compress(size_t len)
+{
+	size_t worst = 0;
+	int i;
+
+	for (i = 0; i < ARRAY_SIZE(codecs); i++)
+		worst = max(worst, codecs[i].worst(len));
+	return worst;
+}
+
+static bool __init guard_intact(const u8 *p)
+{
+	int i;
+
+	for (i = 0; i < GUARD_LEN; i++)
+		if (p[i] != GUARD_BYTE)
+			return false;
+	return true;
+}
+
+/* random, zero, text-like, and random with back references */
+static void __init fill(u8 *buf, size_t len, int kind)
+{
+	static const char text[] __initconst = "the quick brown fox jumps ";
+	size_t i;
+
+	for (i = 0; i < len; i++) {
+		switch (kind) {
+		case 0:
+			buf[i] = random32();
+			break;
+		case 1:
+			buf[i] = 0;
+			break;
+		case 2:
+			buf[i] = text[(random32() & 7) ? i % 26 :
+				      random32() % 26];
+			break;
+		default:
+			if (i > 64 && (random32() & 15))
+				buf[i] = buf[i - 1 - random32() % 64];
+			else
+				buf[i] = random32();
+			break;
+		}
+	}
+}
+
+struct lzotest_bufs {
+	u8 *src;
+	u8 *comp;
+	u8 *out;
+	void *wrkmem;
+};
+
+/*
+ * Decompress @clen bytes at @comp into the output buffer at @off, with
+ * room for @cap bytes followed by a guard zone.
+ */
+static int __init decompress_guarded(const struct lzotest_codec *c,
+				     struct lzotest_bufs *b,
+				     const u8 *comp, size_t clen,
+				     size_t off, size_t cap, size_t *out_len)
+{
+	memset(b->out, GUARD_BYTE, off + cap + GUARD_LEN);
+	*out_len = cap;
+	return c->decompress(comp, clen, b->out + off, out_len);
+}
+
+static int __init test_roundtrip(const struct lzotest_codec *c,
+				 struct lzotest_bufs *b, size_t len,
+				 int kind, size_t soff, size_t doff)
+{
+	const u8 *src = b->src + soff;
+	u8 *comp = b->comp + soff;
+	size_t clen = c->worst(TEST_BUF_LEN);
+	size_t out_len, short_len;
+	int ret;
+
+	fill(b->src + soff, len, kind);
+	ret = c->compress(src, len, comp, &clen, b->wrkmem);
+	if (ret || clen > c->worst(len)) {
+		pr_err("lzotest: error: %s: compress, len %zu: ret %d, "
+		       "%zu bytes\n", c->name, len, ret, clen);
+		return -EINVAL;
+	}
+
+	ret = decompress_guarded(c, b, comp, clen, doff, len, &out_len);
+	if (ret || out_len != len ||
+	    memcmp(b->out + doff, src, len) ||
+	    !guard_intact(b->out + doff + len)) {
+		pr_err("lzotest: error: %s: round trip, len %zu: ret %d\n",
+		       c->name, len, ret);
+		return -EINVAL;
+	}
+
+	if (len) {
+		ret = decompress_guarded(c, b, comp, clen, doff, len - 1,
+					 &out_len);
+		if (ret != c->output_overrun || out_len >= len ||
+		    !guard_intact(b->out + doff + len - 1)) {
+			pr_err("lzotest: error: %s: short output, len %zu: "
+			       "ret %d\n", c->name, len, ret);
+			return -EINVAL;
+		}
+	}
+
+	/*
+	 * Without an end marker a stream cut between two sequences still
+	 * decodes, but never to the full length.
+	 */
+	ret = decompress_guarded(c, b, comp, clen - 1 - random32() % clen,
+				 doff, len, &out_len);
+	if ((!ret && (c->terminated || out_len == len)) || out_len > len ||
+	    !guard_intact(b->out + doff + len)) {
+		pr_err("lzotest: error: %s: truncated input, len %zu: "
+		       "ret %d\n", c->name, len, ret);
+		return -EINVAL;
+	}
+
+	if (!c->bounded)
+		return 0;
+
+	/* compressing into one byte less than needed must fail cleanly */
+	short_len = clen - 1;
+	memset(b->out, GUARD_BYTE, clen + GUARD_LEN);
+	ret = c->compress(src, len, b->out, &short_len, b->wrkmem);
+	if (!ret || !guard_intact(b->out + clen - 1)) {
+		pr_err("lzotest: error: %s: short compress, len %zu: "
+		       "ret %d\n", c->name, len, ret);
+		return -EINVAL;
+	}
+	return 0;
+}
+
+static int __init test_fuzz(const struct lzotest_codec *c,
+			    struct lzotest_bufs *b, unsigned int rounds)
+{
+	size_t len, clen, cap, out_len;
+	unsigned int i, n;
+
+	while (rounds--) {
+		len = random32() % TEST_BUF_LEN;
+		clen = c->worst(TEST_BUF_LEN);
+		fill(b->src, len, random32() % 4);
+		c->compress(b->src, len, b->comp, &clen, b->wrkmem);
+
+		n = 1 + random32() % 4;
+		for (i = 0; i < n; i++)
+			b->comp[random32() % clen] ^= 1 << (random32() % 8);
+		if (random32() & 1)
+			clen = random32() % (clen + 1);
+
+		cap = random32() % (TEST_BUF_LEN + 1);
+		decompress_guarded(c, b, b->comp, clen, 0, cap, &out_len);
+		if (out_len > cap || !guard_intact(b->out + cap)) {
+			pr_err("lzotest: error: %s: fuzz, len %zu: wrote %zu "
+			       "of %zu\n", c->name, len, out_len, cap);
+			return -EINVAL;
+		}
+	}
+	return 0;
+}
+
+static int __init test_codec(const struct lzotest_codec *c,
+			     struct lzotest_bufs *b)
+{
+	size_t soff, doff, len;
+	int kind, ret;
+
+	for (kind = 0; kind < 4; kind++) {
+		for (soff = 0; soff < TEST_ALIGN; soff++) {
+			doff = (soff * 3) % TEST_ALIGN;
+			/* every short length, then larger strides */
+			for (len = 0; len <= TEST_BUF_LEN;
+			     len += len < 64 ? 1 : 97) {
+				ret = test_roundtrip(c, b, len, kind, soff,
+						     doff);
+				if (ret)
+					return ret;
+			}
+			ret = test_roundtrip(c, b, TEST_BUF_LEN, kind, soff,
+					     doff);
+			if (ret)
+				return ret;
+		}
+	}
+	return test_fuzz(c, b, fuzz_rounds);
+}
+
+/* Copy up to @max pages, spread over all lowmem zones, into @corpus. */
+static unsigned int __init fill_corpus(u8 *corpus, unsigned int max)
+{
+	unsigned long pfn, end, step = 0;
+	unsigned int n = 0;
+	struct zone *zone;
+
+	for_each_populated_zone(zone)
+		if (!is_highmem(zone))
+			step += zone->spanned_pages;
+	step = max_t(unsigned long, 1, step / max);
+
+	for_each_populated_zone(zone) {
+		if (is_highmem(zone))
+			continue;
+		end = zone->zone_start_pfn + zone->spanned_pages;
+		for (pfn = zone->zone_start_pfn; pfn < end && n < max;
+		     pfn += step) {
+			if (!pfn_valid(pfn))
+				continue;
+			memcpy(corpus + n * PAGE_SIZE,
+			       page_address(pfn_to_page(pfn)), PAGE_SIZE);
+			n++;
+		}
+	}
+	return n;
+}
+
+static unsigned long long __init mb_per_s(unsigned long long bytes,
+					  unsigned long long ns)
+{
+	return div64_u64(bytes * 1000, ns ?: 1);
+}
+
+/*
+ * Compress the whole corpus @bench_loops times, then decompress it as
+ * often, and report both rates and the compressed size.
+ */
+static int __init bench_codec(const struct lzotest_codec *c, u8 *corpus,
+			      unsigned int n, u8 *comp, size_t *clen,
+			      u8 *out, void *wrkmem)
+{
+	size_t worst = worst_compress(PAGE_SIZE), out_len;
+	unsigned long long total, bytes, cns, dns;
+	unsigned int i, loop;
+	ktime_t start;
+	int ret;
+
+	start = ktime_get();
+	for (loop = 0; loop < bench_loops; loop++) {
+		for (i = 0, total = 0; i < n; i++) {
+			clen[i] = worst;
+			ret = c->compress(corpus + i * PAGE_SIZE, PAGE_SIZE,
+					  comp + i * worst, &clen[i], wrkmem);
+			if (ret) {
+				pr_err("lzotest: error: %s: compress page %u: "
+				       "ret %d\n", c->name, i, ret);
+				return -EINVAL;
+			}
+			total += clen[i];
+		}
+		cond_resched();
+	}
+	cns = ktime_to_ns(ktime_sub(ktime_get(), start));
+
+	start = ktime_get();
+	for (loop = 0; loop < bench_loops; loop++) {
+		for (i = 0; i < n; i++) {
+			out_len = PAGE_SIZE;
+			ret = c->decompress(comp + i * worst, clen[i],
+					    out, &out_len);
+			if (ret || out_len != PAGE_SIZE) {
+				pr_err("lzotest: error: %s: decompress page "
+				       "%u: ret %d\n", c->name, i, ret);
+				return -EINVAL;
+			}
+		}
+		cond_resched();
+	}
+	dns = ktime_to_ns(ktime_sub(ktime_get(), start));
+
+	bytes = (unsigned long long)n * PAGE_SIZE * bench_loops;
+	pr_info("lzotest: %s: %llu bytes compressed to %llu (%llu%%)\n",
+		c->name, (unsigned long long)n * PAGE_SIZE, total,
+		div64_u64(total * 100, (unsigned long long)n * PAGE_SIZE));
+	pr_info("lzotest: %s: compress %llu MB/s, decompress %llu MB/s\n",
+		c->name, mb_per_s(bytes, cns), mb_per_s(bytes, dns));
+	return 0;
+}
+
+static int __init bench(void *wrkmem)
+{
+	size_t worst = worst_compress(PAGE_SIZE);
+	unsigned int n, i;
+	u8 *corpus, *comp, *out;
+	size_t *clen;
+	int err = -ENOMEM;
+
+	corpus = vmalloc(bench_pages * PAGE_SIZE);
+	comp = vmalloc(bench_pages * worst);
+	clen = vmalloc(bench_pages * sizeof(*clen));
+	out = kmalloc(PAGE_SIZE, GFP_KERNEL);
+	if (!corpus || !comp || !clen || !out) {
+		pr_err("lzotest: no memory for %u page corpus\n", bench_pages);
+		goto out;
+	}
+
+	n = fill_corpus(corpus, bench_pages);
+	pr_info("lzotest: %u pages, %u passes\n", n, bench_loops);
+	for (i = 0, err = 0; !err && i < ARRAY_SIZE(codecs); i++)
+		err = bench_codec(&codecs[i], corpus, n, comp, clen, out,
+				  wrkmem);
+
+out:
+	kfree(out);
+	vfree(clen);
+	vfree(comp);
+	vfree(corpus);
+	return err;
+}
+
+static int __init test_lzo_init(void)
+{
+	struct lzotest_bufs b;
+	size_t wrkmem = 0;
+	int i, ret = -ENOMEM;
+
+	for (i = 0; i < ARRAY_SIZE(codecs); i++)
+		wrkmem = max(wrkmem, codecs[i].wrkmem);
+
+	b.src = kmalloc(TEST_BUF_LEN + TEST_ALIGN, GFP_KERNEL);
+	b.comp = kmalloc(worst_compress(TEST_BUF_LEN) + TEST_ALIGN,
+			 GFP_KERNEL);
+	b.out = kmalloc(worst_compress(TEST_BUF_LEN) + TEST_ALIGN +
+			GUARD_LEN, GFP_KERNEL);
+	b.wrkmem = kmalloc(wrkmem, GFP_KERNEL);
+	if (!b.src || !b.comp || !b.out || !b.wrkmem)
+		goto out;
+
+	for (i = 0, ret = 0; !ret && i < ARRAY_SIZE(codecs); i++)
+		ret = test_codec(&codecs[i], &b);
+
+	if (!ret && bench_pages && bench_loops)
+		ret = bench(b.wrkmem);
+out:
+	kfree(b.wrkmem);
+	kfree(b.out);
+	kfree(b.comp);
+	kfree(b.src);
+	return ret;
+}
+module_init(test_lzo_init);
+
+static void __exit test_lzo_exit(void)
+{
+}
+module_exit(test_lzo_exit);
+
+MODULE_DESCRIPTION("LZO1X and LZ4 tests and benchmark");
+MODULE_LICENSE("GPL");
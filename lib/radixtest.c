@@ -0,0 +1,450 @@
+/*
+ * Tests and benchmark for the radix tree iterators and gang lookups.
+ *
+ * Random sparse trees, with entries near the top of the index space as
+ * well, are walked with each iterator and with the gang lookups from
+ * assorted starting indices; what they return must match the sorted
+ * list of indices inserted and tagged.  The benchmark scans a tree laid
+ * out like the page cache of a large sparse file, once in pagevec-sized
+ * gang lookups, which walk down from the root for every batch as the
+ * pagevec_lookup() loops in truncate and writeback do, and once with an
+ * iterator.
+ *
+ * This source code is licensed under the GNU General Public License,
+ * Version 2.  See the file COPYING for more details.
+ */
+
+#include <linux/hrtimer.h>
+#include <linux/init.h>
+#include <linux/kernel.h>
+#include <linux/math64.h>
+#include <linux/module.h>
+#include <linux/radix-tree.h>
+#include <linux/random.h>
+#include <linux/sched.h>
+#include <linux/slab.h>
+#include <linux/sort.h>
+#include <linux/vmalloc.h>
+
+#define TEST_ITEMS	2048
+#define TEST_BATCH	14	/* PAGEVEC_SIZE */
+#define TEST_TAG	0
+
+static unsigned int test_rounds = 50;
+module_param(test_rounds, uint, 0);
+MODULE_PARM_DESC(test_rounds, "Number of random trees to check");
+
+static unsigned int bench_pages = 65536;
+module_param(bench_pages, uint, 0);
+MODULE_PARM_DESC(bench_pages, "Number of pages in the sparse file");
+
+static unsigned int bench_loops = 16;
+module_param(bench_loops, uint, 0);
+MODULE_PARM_DESC(bench_loops, "Number of scans of the sparse file");
+
+/* Items are never indirect or exceptional pointers, nor NULL. */
+static inline void *item(unsigned long index)
+{
+	return (void *)((index << 3) | 4);
+}
+
+static inline unsigned long item_index(void *item)
+{
+	return (unsigned long)item >> 3;
+}
+
+struct radixtest_tree {
+	struct radix_tree_root root;
+	unsigned long *idx;	/* sorted */
+	u8 *tagged;
+	unsigned int nr;
+};
+
+static int __init cmp_ulong(const void *a, const void *b)
+{
+	unsigned long x = *(const unsigned long *)a;
+	unsigned long y = *(const unsigned long *)b;
+
+	return x < y ? -1 : x > y;
+}
+
+/* Short runs of indices, a few of them near ~0UL. */
+static int __init build_tree(struct radixtest_tree *t, unsigned int nr)
+{
+	unsigned long base = 0;
+	unsigned int i, j, run = 0;
+
+	for (i = 0; i < nr; i++) {
+		if (!run) {
+			run = 1 + random32() % 80;
+			switch (random32() % 8) {
+			case 0:
+				base = ~0UL - random32() % 200;
+				break;
+			case 1:
+				base = random32() % 100;
+				break;
+			default:
+				base = random32() % (1 << 22);
+				break;
+			}
+		}
+		t->idx[i] = base++;
+		run--;
+	}
+	sort(t->idx, nr, sizeof(*t->idx), cmp_ulong, NULL);
+	for (i = j = 0; i < nr; i++)
+		if (!j || t->idx[i] != t->idx[j - 1])
+			t->idx[j++] = t->idx[i];
+	t->nr = j;
+
+	INIT_RADIX_TREE(&t->root, GFP_KERNEL);
+	for (i = 0; i < t->nr; i++) {
+		if (radix_tree_insert(&t->root, t->idx[i], item(t->idx[i]))) {
+			pr_err("radixtest: error: insert %lu\n", t->idx[i]);
+			return -ENOMEM;
+		}
+		t->tagged[i] = random32() % 3 == 0;
+		if (t->tagged[i])
+			radix_tree_tag_set(&t->root, t->idx[i], TEST_TAG);
+	}
+	return 0;
+}
+
+/* @idx must be sorted; nothing is tagged. */
+static int __init build_fixed(struct radixtest_tree *t,
+			      const unsigned long *idx, unsigned int nr)
+{
+	unsigned int i;
+
+	INIT_RADIX_TREE(&t->root, GFP_KERNEL);
+	t->nr = nr;
+	for (i = 0; i < nr; i++) {
+		t->idx[i] = idx[i];
+		t->tagged[i] = 0;
+	}
+	for (i = 0; i < nr; i++) {
+		if (radix_tree_insert(&t->root, idx[i], item(idx[i]))) {
+			pr_err("radixtest: error: insert %lu\n", idx[i]);
+			return -ENOMEM;
+		}
+	}
+	return 0;
+}
+
+static int __init free_tree(struct radixtest_tree *t)
+{
+	unsigned int i;
+
+	for (i = 0; i < t->nr; i++)
+		radix_tree_delete(&t->root, t->idx[i]);
+	if (t->root.rnode) {
+		pr_err("radixtest: error: tree not empty after deletes\n");
+		return -EINVAL;
+	}
+	return 0;
+}
+
+/* Position of the first index >= @start. */
+static unsigned int __init lower_bound(struct radixtest_tree *t,
+				       unsigned long start)
+{
+	unsigned int lo = 0, hi = t->nr;
+
+	while (lo < hi) {
+		unsigned int mid = (lo + hi) / 2;
+
+		if (t->idx[mid] < start)
+			lo = mid + 1;
+		else
+			hi = mid;
+	}
+	return lo;
+}
+
+static int __init check_iterators(struct radixtest_tree *t,
+				  unsigned long start)
+{
+	struct radix_tree_iter iter;
+	unsigned int pos, first = lower_bound(t, start);
+	void **slot;
+
+	pos = first;
+	radix_tree_for_each_slot(slot, &t->root, &iter, start) {
+		if (pos >= t->nr || iter.index != t->idx[pos] ||
+		    *slot != item(iter.index))
+			goto fail_slot;
+		pos++;
+	}
+	if (pos != t->nr)
+		goto fail_end;
+
+	pos = first;
+	radix_tree_for_each_tagged(slot, &t->root, &iter, start, TEST_TAG) {
+		while (pos < t->nr && !t->tagged[pos])
+			pos++;
+		if (pos >= t->nr || iter.index != t->idx[pos] ||
+		    *slot != item(iter.index))
+			goto fail_slot;
+		pos++;
+	}
+	while (pos < t->nr && !t->tagged[pos])
+		pos++;
+	if (pos != t->nr)
+		goto fail_end;
+
+	pos = first;
+	radix_tree_for_each_contig(slot, &t->root, &iter, start) {
+		if (pos >= t->nr || iter.index != start + (pos - first) ||
+		    t->idx[pos] != iter.index || *slot != item(iter.index))
+			goto fail_slot;
+		pos++;
+	}
+	if (pos < t->nr && t->idx[pos] == start + (pos - first))
+		goto fail_end;
+	return 0;
+
+fail_slot:
+	pr_err("radixtest: error: iterator from %lu returned index %lu\n",
+	       start, iter.index);
+	return -EINVAL;
+fail_end:
+	pr_err("radixtest: error: iterator from %lu stopped early\n", start);
+	return -EINVAL;
+}
+
+static int __init check_gang(struct radixtest_tree *t, unsigned long start)
+{
+	unsigned long indices[TEST_BATCH];
+	void **slots[TEST_BATCH];
+	void *items[TEST_BATCH];
+	unsigned int i, n, max, pos;
+	const char *what;
+
+	max = 1 + random32() % TEST_BATCH;
+	pos = lower_bound(t, start);
+	what = "gang_lookup";
+	n = radix_tree_gang_lookup(&t->root, items, start, max);
+	if (n != min(max, t->nr - pos))
+		goto fail;
+	for (i = 0; i < n; i++)
+		if (items[i] != item(t->idx[pos + i]))
+			goto fail;
+
+	what = "gang_lookup_slot";
+	n = radix_tree_gang_lookup_slot(&t->root, slots, indices, start, max);
+	if (n != min(max, t->nr - pos))
+		goto fail;
+	for (i = 0; i < n; i++)
+		if (indices[i] != t->idx[pos + i] ||
+		    *slots[i] != item(indices[i]))
+			goto fail;
+
+	what = "gang_lookup_tag";
+	n = radix_tree_gang_lookup_tag(&t->root, items, start, max, TEST_TAG);
+	for (i = 0; i < n; i++, pos++) {
+		while (pos < t->nr && !t->tagged[pos])
+			pos++;
+		if (pos >= t->nr || items[i] != item(t->idx[pos]))
+			goto fail;
+	}
+	if (n < max) {
+		while (pos < t->nr && !t->tagged[pos])
+			pos++;
+		if (pos != t->nr)
+			goto fail;
+	}
+	return 0;
+
+fail:
+	pr_err("radixtest: error: %s from %lu, max %u\n", what, start, max);
+	return -EINVAL;
+}
+
+static const struct {
+	unsigned int nr;
+	unsigned long idx[4];
+} contig_trees[] __initconst = {
+	{ 2, { 0, 100 } },
+	{ 4, { 0, 1, 2, 4 } },
+	{ 4, { 0, 64, 65, 67 } },
+	{ 2, { 0, ~0UL } },
+};
+
+static int __init test_trees(unsigned int rounds)
+{
+	struct radixtest_tree t;
+	unsigned long start;
+	unsigned int i, r;
+	int err = -ENOMEM;
+
+	t.idx = kmalloc(TEST_ITEMS * sizeof(*t.idx), GFP_KERNEL);
+	t.tagged = kmalloc(TEST_ITEMS, GFP_KERNEL);
+	if (!t.idx || !t.tagged)
+		goto out;
+
+	/*
+	 * A hole right after the first slot: a contiguous walk from 0 used
+	 * to restart at 0 instead of ending there.
+	 */
+	for (i = 0, err = 0; !err && i < ARRAY_SIZE(contig_trees); i++) {
+		err = build_fixed(&t, contig_trees[i].idx,
+				  contig_trees[i].nr) ?:
+		      check_iterators(&t, 0) ?:
+		      check_iterators(&t, t.idx[1]);
+		err = free_tree(&t) ?: err;
+	}
+
+	for (r = 0; !err && r < rounds; r++) {
+		err = build_tree(&t, 1 + random32() % TEST_ITEMS);
+		for (i = 0; !err && i < 64; i++) {
+			/* present indices, their neighbours, and anywhere */
+			start = t.idx[random32() % t.nr];
+			if (i & 1)
+				start += (long)(random32() % 3) - 1;
+			if (i % 8 == 0)
+				start = random32() % (1 << 22);
+			if (i == 0)
+				start = 0;
+			err = check_iterators(&t, start) ?:
+			      check_gang(&t, start);
+		}
+		err = free_tree(&t) ?: err;
+		cond_resched();
+	}
+out:
+	kfree(t.tagged);
+	kfree(t.idx);
+	return err;
+}
+
+static unsigned long __init scan_gang(struct radix_tree_root *root,
+				      bool tagged)
+{
+	void **slots[TEST_BATCH];
+	unsigned long index = 0, found = 0;
+	unsigned int n;
+
+	for (;;) {
+		if (tagged)
+			n = radix_tree_gang_lookup_tag_slot(root, slots, index,
+							    TEST_BATCH,
+							    TEST_TAG);
+		else
+			n = radix_tree_gang_lookup_slot(root, slots, NULL,
+							index, TEST_BATCH);
+		if (!n)
+			break;
+		found += n;
+		index = item_index(*slots[n - 1]) + 1;
+	}
+	return found;
+}
+
+static unsigned long __init scan_iter(struct radix_tree_root *root,
+				      bool tagged)
+{
+	struct radix_tree_iter iter;
+	unsigned long found = 0;
+	void **slot;
+
+	if (tagged) {
+		radix_tree_for_each_tagged(slot, root, &iter, 0, TEST_TAG)
+			found++;
+	} else {
+		radix_tree_for_each_slot(slot, root, &iter, 0)
+			found++;
+	}
+	return found;
+}
+
+static int __init bench_scan(struct radix_tree_root *root, bool tagged,
+			     unsigned long expect)
+{
+	unsigned long long ns[2];
+	unsigned long found;
+	unsigned int loop, way;
+	ktime_t start;
+
+	for (way = 0; way < 2; way++) {
+		start = ktime_get();
+		for (loop = 0; loop < bench_loops; loop++) {
+			rcu_read_lock();
+			found = way ? scan_iter(root, tagged) :
+				      scan_gang(root, tagged);
+			rcu_read_unlock();
+			if (found != expect) {
+				pr_err("radixtest: error: %s scan found %lu "
+				       "of %lu\n", way ? "iterator" :
+				       "gang lookup", found, expect);
+				return -EINVAL;
+			}
+			cond_resched();
+		}
+		ns[way] = ktime_to_ns(ktime_sub(ktime_get(), start)) ?: 1;
+	}
+
+	expect = max(expect, 1UL) * bench_loops;
+	pr_info("radixtest: %s: ns/page gang lookup %llu, iterator %llu\n",
+		tagged ? "tagged" : "all",
+		div64_u64(ns[0], expect), div64_u64(ns[1], expect));
+	return 0;
+}
+
+/*
+ * A sparse file: extents of 16 pages, 64 times as far apart as they are
+ * long, with every fourth extent tagged, like dirty data.
+ */
+static int __init bench(void)
+{
+	struct radix_tree_root root;
+	unsigned long index, nr = 0, nr_tagged = 0;
+	void *items[TEST_BATCH];
+	unsigned int i, n;
+	int err = -ENOMEM;
+
+	INIT_RADIX_TREE(&root, GFP_KERNEL);
+	for (index = 0; nr < bench_pages; index++) {
+		if (index % 1024 >= 16)
+			index += 1024 - 16;
+		if (radix_tree_insert(&root, index, item(index))) {
+			pr_err("radixtest: no memory for %u pages\n",
+			       bench_pages);
+			goto out;
+		}
+		nr++;
+		if (index / 1024 % 4 == 0) {
+			radix_tree_tag_set(&root, index, TEST_TAG);
+			nr_tagged++;
+		}
+	}
+
+	pr_info("radixtest: %lu pages over %lu indices, %u passes\n",
+		nr, index, bench_loops);
+	err = bench_scan(&root, false, nr) ?:
+	      bench_scan(&root, true, nr_tagged);
+out:
+	while ((n = radix_tree_gang_lookup(&root, items, 0, TEST_BATCH)))
+		for (i = 0; i < n; i++)
+			radix_tree_delete(&root, item_index(items[i]));
+	return err;
+}
+
+static int __init test_radix_tree_init(void)
+{
+	int err;
+
+	err = test_trees(test_rounds);
+	if (!err && bench_pages && bench_loops)
+		err = bench();
+	return err;
+}
+module_init(test_radix_tree_init);
+
+static void __exit test_radix_tree_exit(void)
+{
+}
+module_exit(test_radix_tree_exit);
+
+MODULE_DESCRIPTION("Radix tree iterator tests and benchmark");
+MODULE_LICENSE("GPL");
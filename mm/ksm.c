@@ -189,6 +189,27 @@ static unsigned int ksm_thread_pages_to_scan = 100;
 /* Milliseconds ksmd should sleep between batches */
 static unsigned int ksm_thread_sleep_millisecs = 20;
 
+/* Whether ksmd should adapt its batch size to the merge rate */
+static unsigned int ksm_thread_adaptive;
+
+/* Smallest batch ksmd scans when adapting: pages_to_scan is the largest */
+static unsigned int ksm_thread_pages_to_scan_min = 25;
+
+/* Number of pages ksmd actually scans in its next batch */
+static unsigned int ksm_scan_batch = 100;
+
+/* Log2 of the spacing between the page chunks sampled by calc_checksum */
+static unsigned int ksm_checksum_shift = 2;
+
+/* The number of merges done by ksmd since boot */
+static unsigned long ksm_merges;
+
+/* Merges per second, as measured over ksmd's last second of activity */
+static unsigned long ksm_merges_per_sec;
+
+/* CPU time in microseconds used by ksmd's last batch */
+static unsigned long ksm_scan_cpu_usecs;
+
 #define KSM_RUN_STOP	0
 #define KSM_RUN_MERGE	1
 #define KSM_RUN_UNMERGE	2
@@ -669,11 +690,33 @@ error:
 }
 #endif /* CONFIG_SYSFS */
 
+/*
+ * The checksum only tells us whether a page is still changing, before we
+ * bother to place it in the unstable tree: every candidate is memcmp'ed in
+ * full before it is merged.  So it is enough to hash one cacheline-sized
+ * chunk out of every 1 << ksm_checksum_shift chunks of the page; shift 0
+ * hashes the whole page as before.
+ */
+#define KSM_CHECKSUM_CHUNK	16	/* u32 words in each sampled chunk */
+#define KSM_CHECKSUM_SHIFT_MAX	(PAGE_SHIFT - 2 - 4)	/* one chunk */
+
 static u32 calc_checksum(struct page *page)
 {
 	u32 checksum;
-	void *addr = kmap_atomic(page, KM_USER0);
-	checksum = jhash2(addr, PAGE_SIZE / 4, 17);
+	u32 *addr = kmap_atomic(page, KM_USER0);
+	unsigned int shift = ACCESS_ONCE(ksm_checksum_shift);
+
+	if (!shift)
+		checksum = jhash2(addr, PAGE_SIZE / 4, 17);
+	else {
+		unsigned int step = KSM_CHECKSUM_CHUNK << shift;
+		unsigned int i;
+
+		checksum = 17;
+		for (i = 0; i < PAGE_SIZE / 4; i += step)
+			checksum = jhash2(addr + i, KSM_CHECKSUM_CHUNK,
+					  checksum);
+	}
 	kunmap_atomic(addr, KM_USER0);
 	return checksum;
 }
@@ -1191,6 +1234,7 @@ static void cmp_and_merge_page(struct page *page, struct rmap_item *rmap_item)
 			lock_page(kpage);
 			stable_tree_append(rmap_item, page_stable_node(kpage));
 			unlock_page(kpage);
+			ksm_merges++;
 		}
 		put_page(kpage);
 		return;
@@ -1220,6 +1264,7 @@ static void cmp_and_merge_page(struct page *page, struct rmap_item *rmap_item)
 		 * tree, and insert it instead as new node in the stable tree.
 		 */
 		if (kpage) {
+			ksm_merges++;
 			remove_rmap_item_from_tree(tree_rmap_item);
 
 			lock_page(kpage);
@@ -1428,15 +1473,64 @@ static int ksmd_should_run(void)
 	return (ksm_run & KSM_RUN_MERGE) && !list_empty(&ksm_mm_head.mm_list);
 }
 
+/*
+ * ksm_adapt_batch - pick the size of ksmd's next batch.
+ * @merged - number of merges done by the batch just completed.
+ *
+ * While merges are being found, double the batch up to pages_to_scan;
+ * when a batch finds nothing, decay it back towards pages_to_scan_min,
+ * so an idle ksmd costs little more than its wakeups.
+ */
+static void ksm_adapt_batch(unsigned long merged)
+{
+	unsigned int hi = ksm_thread_pages_to_scan;
+	unsigned int lo = min(ksm_thread_pages_to_scan_min, hi);
+	unsigned int batch = ksm_scan_batch;
+
+	if (!ksm_thread_adaptive)
+		batch = hi;
+	else if (merged)
+		batch = batch * 2;
+	else
+		batch -= DIV_ROUND_UP(batch, 4);
+
+	ksm_scan_batch = clamp(batch, lo, hi);
+}
+
 static int ksm_scan_thread(void *nothing)
 {
+	unsigned long rate_jiffies = jiffies;
+	unsigned long rate_merges = 0;
+
 	set_freezable();
 	set_user_nice(current, 5);
 
 	while (!kthread_should_stop()) {
 		mutex_lock(&ksm_thread_mutex);
-		if (ksmd_should_run())
-			ksm_do_scan(ksm_thread_pages_to_scan);
+		if (ksmd_should_run()) {
+			unsigned long long runtime = task_sched_runtime(current);
+			unsigned long merges = ksm_merges;
+			unsigned long elapsed;
+
+			ksm_do_scan(ksm_scan_batch);
+
+			runtime = task_sched_runtime(current) - runtime;
+			do_div(runtime, NSEC_PER_USEC);
+			ksm_scan_cpu_usecs = runtime;
+			ksm_adapt_batch(ksm_merges - merges);
+
+			elapsed = jiffies - rate_jiffies;
+			if (elapsed >= HZ) {
+				ksm_merges_per_sec = (ksm_merges - rate_merges) *
+							HZ / elapsed;
+				rate_merges = ksm_merges;
+				rate_jiffies = jiffies;
+			}
+		} else {
+			ksm_merges_per_sec = 0;
+			rate_merges = ksm_merges;
+			rate_jiffies = jiffies;
+		}
 		mutex_unlock(&ksm_thread_mutex);
 
 		try_to_freeze();
@@ -1867,11 +1961,84 @@ static ssize_t pages_to_scan_store(struct kobject *kobj,
 		return -EINVAL;
 
 	ksm_thread_pages_to_scan = nr_pages;
+	ksm_scan_batch = nr_pages;
 
 	return count;
 }
 KSM_ATTR(pages_to_scan);
 
+static ssize_t pages_to_scan_min_show(struct kobject *kobj,
+				      struct kobj_attribute *attr, char *buf)
+{
+	return sprintf(buf, "%u\n", ksm_thread_pages_to_scan_min);
+}
+
+static ssize_t pages_to_scan_min_store(struct kobject *kobj,
+				       struct kobj_attribute *attr,
+				       const char *buf, size_t count)
+{
+	int err;
+	unsigned long nr_pages;
+
+	err = strict_strtoul(buf, 10, &nr_pages);
+	if (err || !nr_pages || nr_pages > UINT_MAX)
+		return -EINVAL;
+
+	ksm_thread_pages_to_scan_min = nr_pages;
+
+	return count;
+}
+KSM_ATTR(pages_to_scan_min);
+
+static ssize_t adaptive_show(struct kobject *kobj,
+			     struct kobj_attribute *attr, char *buf)
+{
+	return sprintf(buf, "%u\n", ksm_thread_adaptive);
+}
+
+static ssize_t adaptive_store(struct kobject *kobj,
+			      struct kobj_attribute *attr,
+			      const char *buf, size_t count)
+{
+	int err;
+	unsigned long adaptive;
+
+	err = strict_strtoul(buf, 10, &adaptive);
+	if (err || adaptive > 1)
+		return -EINVAL;
+
+	mutex_lock(&ksm_thread_mutex);
+	ksm_thread_adaptive = adaptive;
+	ksm_scan_batch = ksm_thread_pages_to_scan;
+	mutex_unlock(&ksm_thread_mutex);
+
+	return count;
+}
+KSM_ATTR(adaptive);
+
+static ssize_t checksum_shift_show(struct kobject *kobj,
+				   struct kobj_attribute *attr, char *buf)
+{
+	return sprintf(buf, "%u\n", ksm_checksum_shift);
+}
+
+static ssize_t checksum_shift_store(struct kobject *kobj,
+				    struct kobj_attribute *attr,
+				    const char *buf, size_t count)
+{
+	int err;
+	unsigned long shift;
+
+	err = strict_strtoul(buf, 10, &shift);
+	if (err || shift > KSM_CHECKSUM_SHIFT_MAX)
+		return -EINVAL;
+
+	ksm_checksum_shift = shift;
+
+	return count;
+}
+KSM_ATTR(checksum_shift);
+
 static ssize_t run_show(struct kobject *kobj, struct kobj_attribute *attr,
 			char *buf)
 {
@@ -1966,6 +2133,34 @@ static ssize_t full_scans_show(struct kobject *kobj,
 }
 KSM_ATTR_RO(full_scans);
 
+static ssize_t scan_batch_show(struct kobject *kobj,
+			       struct kobj_attribute *attr, char *buf)
+{
+	return sprintf(buf, "%u\n", ksm_scan_batch);
+}
+KSM_ATTR_RO(scan_batch);
+
+static ssize_t scan_cpu_usecs_show(struct kobject *kobj,
+				   struct kobj_attribute *attr, char *buf)
+{
+	return sprintf(buf, "%lu\n", ksm_scan_cpu_usecs);
+}
+KSM_ATTR_RO(scan_cpu_usecs);
+
+static ssize_t merges_show(struct kobject *kobj,
+			   struct kobj_attribute *attr, char *buf)
+{
+	return sprintf(buf, "%lu\n", ksm_merges);
+}
+KSM_ATTR_RO(merges);
+
+static ssize_t merges_per_sec_show(struct kobject *kobj,
+				   struct kobj_attribute *attr, char *buf)
+{
+	return sprintf(buf, "%lu\n", ksm_merges_per_sec);
+}
+KSM_ATTR_RO(merges_per_sec);
+
 static struct attribute *ksm_attrs[] = {
 	&sleep_millisecs_attr.attr,
 	&pages_to_scan_attr.attr,
@@ -1975,6 +2170,13 @@ static struct attribute *ksm_attrs[] = {
 	&pages_unshared_attr.attr,
 	&pages_volatile_attr.attr,
 	&full_scans_attr.attr,
+	&pages_to_scan_min_attr.attr,
+	&adaptive_attr.attr,
+	&checksum_shift_attr.attr,
+	&scan_batch_attr.attr,
+	&scan_cpu_usecs_attr.attr,
+	&merges_attr.attr,
+	&merges_per_sec_attr.attr,
 	NULL,
 };
 
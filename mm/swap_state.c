@@ -317,6 +317,13 @@ struct page *read_swap_cache_async(swp_entry_t entry, gfp_t gfp_mask,
 		err = swapcache_prepare(entry);
 		if (err == -EEXIST) {	/* seems racy */
 			radix_tree_preload_end();
+			/*
+			 * Unused slots held in a swap slot cache have
+			 * SWAP_HAS_CACHE set but will never get a page:
+			 * there is nothing to read, so don't wait for one.
+			 */
+			if (swap_slot_cached(entry))
+				break;
 			continue;
 		}
 		if (err) {		/* swp entry is obsolete ? */
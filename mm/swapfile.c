@@ -32,6 +32,8 @@
 #include <linux/memcontrol.h>
 #include <linux/poll.h>
 #include <linux/oom.h>
+#include <linux/cpu.h>
+#include <linux/workqueue.h>
 
 #include <asm/pgtable.h>
 #include <asm/tlbflush.h>
@@ -409,14 +411,13 @@ no_page:
 	return 0;
 }
 
-swp_entry_t get_swap_page(void)
+static swp_entry_t __get_swap_page(void)
 {
 	struct swap_info_struct *si;
 	pgoff_t offset;
 	int type, next;
 	int wrapped = 0;
 
-	spin_lock(&swap_lock);
 	if (nr_swap_pages <= 0)
 		goto noswap;
 	nr_swap_pages--;
@@ -438,19 +439,253 @@ swp_entry_t get_swap_page(void)
 		swap_list.next = next;
 		/* This is called for allocating swap entry for cache */
 		offset = scan_swap_map(si, SWAP_HAS_CACHE);
-		if (offset) {
-			spin_unlock(&swap_lock);
+		if (offset)
 			return swp_entry(type, offset);
-		}
 		next = swap_list.next;
 	}
 
 	nr_swap_pages++;
 noswap:
-	spin_unlock(&swap_lock);
 	return (swp_entry_t) {0};
 }
 
+/*
+ * Per-cpu swap slot caches.
+ *
+ * Allocating or freeing a swap slot takes swap_lock, which becomes a hot
+ * spot when several cpus are reclaiming to a fast swap device like zram.
+ * So each cpu keeps a small stock of slots, allocated from the swap_map in
+ * batches, and a list of slots whose last reference (the swap cache's) has
+ * gone, returned to the swap_map in batches.
+ *
+ * Slots in either list are marked SWAP_HAS_CACHE without any page in the
+ * swap cache: read_swap_cache_async() checks swap_slot_cached() so as not
+ * to spin on them, and swapoff disables and drains the caches before it
+ * starts try_to_unuse().  The caches are bypassed when swap is nearly full,
+ * lest slots sit idle on one cpu while another runs out.  Frees to a device
+ * with a swap_slot_free_notify() method are never deferred: zram releases
+ * the compressed data when notified, and must not hold it for slots that
+ * merely sit in a cache.
+ */
+#define SWAP_SLOTS_CACHE_SIZE	64
+#define SWAP_SLOTS_BATCH	(SWAP_SLOTS_CACHE_SIZE / 2)
+
+struct swap_slots_cache {
+	int		nr;		/* free slots in slots[] */
+	int		nr_ret;		/* slots in slots_ret[] to be freed */
+	swp_entry_t	slots[SWAP_SLOTS_CACHE_SIZE];
+	swp_entry_t	slots_ret[SWAP_SLOTS_CACHE_SIZE];
+	unsigned long	alloc_hits;	/* allocations served from slots[] */
+	unsigned long	alloc_misses;	/* allocations which refilled it */
+	unsigned long	free_batched;	/* frees deferred to slots_ret[] */
+	unsigned long	free_flushes;	/* batches returned to swap_map */
+};
+
+static DEFINE_PER_CPU(struct swap_slots_cache, swap_slots_cache);
+static bool swap_slots_cache_enabled = true;
+static atomic_t swap_slots_cache_disabled = ATOMIC_INIT(0);
+
+static bool swap_slots_cache_active(void)
+{
+	return swap_slots_cache_enabled &&
+		!atomic_read(&swap_slots_cache_disabled) &&
+		nr_swap_pages > num_online_cpus() * SWAP_SLOTS_CACHE_SIZE * 2;
+}
+
+/*
+ * Return true if @entry might be sitting unused in a swap slot cache.
+ * The entry may be freed, or its device swapped off, at any moment, so
+ * it is looked up under swap_lock like any other.
+ */
+bool swap_slot_cached(swp_entry_t entry)
+{
+	struct swap_info_struct *si;
+	unsigned long offset = swp_offset(entry);
+	unsigned long type = swp_type(entry);
+	bool cached = false;
+
+	if (!swap_slots_cache_enabled ||
+	    atomic_read(&swap_slots_cache_disabled))
+		return false;
+
+	spin_lock(&swap_lock);
+	if (type < nr_swapfiles) {
+		si = swap_info[type];
+		if ((si->flags & SWP_USED) && offset < si->max)
+			cached = !swap_count(si->swap_map[offset]);
+	}
+	spin_unlock(&swap_lock);
+	return cached;
+}
+
+static int get_swap_pages(int nr, swp_entry_t *slots)
+{
+	int i;
+
+	spin_lock(&swap_lock);
+	for (i = 0; i < nr; i++) {
+		slots[i] = __get_swap_page();
+		if (!slots[i].val)
+			break;
+	}
+	spin_unlock(&swap_lock);
+	return i;
+}
+
+static unsigned char swap_entry_free(struct swap_info_struct *p,
+				     swp_entry_t entry, unsigned char usage);
+
+/* Drop the swap cache's reference on a batch of valid entries */
+static void swapcache_free_entries(swp_entry_t *slots, int nr)
+{
+	int i;
+
+	spin_lock(&swap_lock);
+	for (i = 0; i < nr; i++)
+		swap_entry_free(swap_info[swp_type(slots[i])], slots[i],
+				SWAP_HAS_CACHE);
+	spin_unlock(&swap_lock);
+}
+
+/* Stock this cpu's cache with @nr newly allocated slots */
+static void swap_slots_cache_refill(swp_entry_t *slots, int nr)
+{
+	struct swap_slots_cache *cache;
+	int n = 0;
+
+	preempt_disable();
+	cache = &__get_cpu_var(swap_slots_cache);
+	if (swap_slots_cache_active()) {
+		n = min(nr, SWAP_SLOTS_CACHE_SIZE - cache->nr);
+		memcpy(&cache->slots[cache->nr], &slots[nr - n],
+		       n * sizeof(swp_entry_t));
+		cache->nr += n;
+	}
+	preempt_enable();
+
+	if (nr > n)
+		swapcache_free_entries(slots, nr - n);
+}
+
+/* Does the device behind @p want to hear about freed slots right away? */
+static bool swap_slot_notifies_free(struct swap_info_struct *p)
+{
+	return (p->flags & SWP_BLKDEV) &&
+		p->bdev->bd_disk->fops->swap_slot_free_notify;
+}
+
+/*
+ * Defer freeing @entry to this cpu's cache, if the swap cache holds its
+ * only reference.  Returns false if the caller must free it directly.
+ */
+static bool swap_slots_cache_free(swp_entry_t entry, struct page *page)
+{
+	struct swap_slots_cache *cache;
+	struct swap_info_struct *p;
+	unsigned long offset = swp_offset(entry);
+	unsigned long type = swp_type(entry);
+
+	if (type >= nr_swapfiles)
+		return false;
+	p = swap_info[type];
+	if (!(p->flags & SWP_USED) || offset >= p->max)
+		return false;
+	if (swap_slot_notifies_free(p))
+		return false;
+	if (ACCESS_ONCE(p->swap_map[offset]) != SWAP_HAS_CACHE)
+		return false;
+
+	preempt_disable();
+	if (!swap_slots_cache_active()) {
+		preempt_enable();
+		return false;
+	}
+	cache = &__get_cpu_var(swap_slots_cache);
+	if (cache->nr_ret == SWAP_SLOTS_CACHE_SIZE) {
+		swapcache_free_entries(cache->slots_ret, cache->nr_ret);
+		cache->nr_ret = 0;
+		cache->free_flushes++;
+	}
+	cache->slots_ret[cache->nr_ret++] = entry;
+	cache->free_batched++;
+	preempt_enable();
+
+	if (page)
+		mem_cgroup_uncharge_swapcache(page, entry, false);
+	return true;
+}
+
+/* Return all the slots held by @cache: its cpu must not be using it */
+static void swap_slots_cache_drain(struct swap_slots_cache *cache)
+{
+	if (cache->nr) {
+		swapcache_free_entries(cache->slots, cache->nr);
+		cache->nr = 0;
+	}
+	if (cache->nr_ret) {
+		swapcache_free_entries(cache->slots_ret, cache->nr_ret);
+		cache->nr_ret = 0;
+		cache->free_flushes++;
+	}
+}
+
+static void swap_slots_cache_drain_local(struct work_struct *dummy)
+{
+	preempt_disable();
+	swap_slots_cache_drain(&__get_cpu_var(swap_slots_cache));
+	preempt_enable();
+}
+
+/*
+ * Stop using the swap slot caches and return every slot they hold:
+ * must be balanced by swap_slots_cache_reenable().
+ */
+static void swap_slots_cache_disable(void)
+{
+	atomic_inc(&swap_slots_cache_disabled);
+	schedule_on_each_cpu(swap_slots_cache_drain_local);
+}
+
+static void swap_slots_cache_reenable(void)
+{
+	atomic_dec(&swap_slots_cache_disabled);
+}
+
+swp_entry_t get_swap_page(void)
+{
+	swp_entry_t slots[SWAP_SLOTS_BATCH];
+	swp_entry_t entry;
+	int nr;
+
+	if (swap_slots_cache_active()) {
+		struct swap_slots_cache *cache;
+
+		preempt_disable();
+		cache = &__get_cpu_var(swap_slots_cache);
+		if (cache->nr) {
+			entry = cache->slots[--cache->nr];
+			cache->alloc_hits++;
+			preempt_enable();
+			return entry;
+		}
+		cache->alloc_misses++;
+		preempt_enable();
+
+		nr = get_swap_pages(SWAP_SLOTS_BATCH, slots);
+		if (!nr)
+			return (swp_entry_t) {0};
+		entry = slots[--nr];
+		if (nr)
+			swap_slots_cache_refill(slots, nr);
+		return entry;
+	}
+
+	spin_lock(&swap_lock);
+	entry = __get_swap_page();
+	spin_unlock(&swap_lock);
+	return entry;
+}
+
 /* The only caller of this function is now susupend routine */
 swp_entry_t get_swap_page_of_type(int type)
 {
@@ -588,6 +823,9 @@ void swapcache_free(swp_entry_t entry, struct page *page)
 	struct swap_info_struct *p;
 	unsigned char count;
 
+	if (swap_slots_cache_free(entry, page))
+		return;
+
 	p = swap_info_get(entry);
 	if (p) {
 		count = swap_entry_free(p, entry, SWAP_HAS_CACHE);
@@ -1615,9 +1853,11 @@ SYSCALL_DEFINE1(swapoff, const char __user *, specialfile)
 	p->flags &= ~SWP_WRITEOK;
 	spin_unlock(&swap_lock);
 
+	swap_slots_cache_disable();
 	oom_score_adj = test_set_oom_score_adj(OOM_SCORE_ADJ_MAX);
 	err = try_to_unuse(type);
 	test_set_oom_score_adj(oom_score_adj);
+	swap_slots_cache_reenable();
 
 	if (err) {
 		/*
@@ -1806,6 +2046,122 @@ static int __init procswaps_init(void)
 __initcall(procswaps_init);
 #endif /* CONFIG_PROC_FS */
 
+#ifdef CONFIG_SYSFS
+#define SWAP_SLOTS_ATTR_RO(_name) \
+	static struct kobj_attribute _name##_attr = __ATTR_RO(_name)
+#define SWAP_SLOTS_ATTR(_name) \
+	static struct kobj_attribute _name##_attr = \
+		__ATTR(_name, 0644, _name##_show, _name##_store)
+
+/* serializes writes to swap_slots/enabled */
+static DEFINE_MUTEX(swap_slots_enabled_mutex);
+
+static ssize_t enabled_show(struct kobject *kobj,
+			    struct kobj_attribute *attr, char *buf)
+{
+	return sprintf(buf, "%u\n", swap_slots_cache_enabled);
+}
+
+static ssize_t enabled_store(struct kobject *kobj,
+			     struct kobj_attribute *attr,
+			     const char *buf, size_t count)
+{
+	unsigned long enabled;
+	int err;
+
+	err = strict_strtoul(buf, 10, &enabled);
+	if (err || enabled > 1)
+		return -EINVAL;
+
+	mutex_lock(&swap_slots_enabled_mutex);
+	if (enabled) {
+		swap_slots_cache_enabled = true;
+	} else if (swap_slots_cache_enabled) {
+		swap_slots_cache_disable();
+		swap_slots_cache_enabled = false;
+		swap_slots_cache_reenable();
+	}
+	mutex_unlock(&swap_slots_enabled_mutex);
+	return count;
+}
+SWAP_SLOTS_ATTR(enabled);
+
+static ssize_t cache_size_show(struct kobject *kobj,
+			       struct kobj_attribute *attr, char *buf)
+{
+	return sprintf(buf, "%u\n", SWAP_SLOTS_CACHE_SIZE);
+}
+SWAP_SLOTS_ATTR_RO(cache_size);
+
+static ssize_t cached_show(struct kobject *kobj,
+			   struct kobj_attribute *attr, char *buf)
+{
+	unsigned long cached = 0;
+	int cpu;
+
+	for_each_possible_cpu(cpu)
+		cached += per_cpu(swap_slots_cache, cpu).nr +
+			  per_cpu(swap_slots_cache, cpu).nr_ret;
+	return sprintf(buf, "%lu\n", cached);
+}
+SWAP_SLOTS_ATTR_RO(cached);
+
+#define SWAP_SLOTS_STAT_ATTR(_name)					\
+static ssize_t _name##_show(struct kobject *kobj,			\
+			    struct kobj_attribute *attr, char *buf)	\
+{									\
+	unsigned long sum = 0;						\
+	int cpu;							\
+									\
+	for_each_possible_cpu(cpu)					\
+		sum += per_cpu(swap_slots_cache, cpu)._name;		\
+	return sprintf(buf, "%lu\n", sum);				\
+}									\
+SWAP_SLOTS_ATTR_RO(_name)
+
+SWAP_SLOTS_STAT_ATTR(alloc_hits);
+SWAP_SLOTS_STAT_ATTR(alloc_misses);
+SWAP_SLOTS_STAT_ATTR(free_batched);
+SWAP_SLOTS_STAT_ATTR(free_flushes);
+
+static struct attribute *swap_slots_attrs[] = {
+	&enabled_attr.attr,
+	&cache_size_attr.attr,
+	&cached_attr.attr,
+	&alloc_hits_attr.attr,
+	&alloc_misses_attr.attr,
+	&free_batched_attr.attr,
+	&free_flushes_attr.attr,
+	NULL,
+};
+
+static struct attribute_group swap_slots_attr_group = {
+	.attrs = swap_slots_attrs,
+	.name = "swap_slots",
+};
+#endif /* CONFIG_SYSFS */
+
+static int swap_slots_cpu_callback(struct notifier_block *nfb,
+				   unsigned long action, void *hcpu)
+{
+	int cpu = (long)hcpu;
+
+	if (action == CPU_DEAD || action == CPU_DEAD_FROZEN)
+		swap_slots_cache_drain(&per_cpu(swap_slots_cache, cpu));
+	return NOTIFY_OK;
+}
+
+static int __init swap_slots_cache_init(void)
+{
+	hotcpu_notifier(swap_slots_cpu_callback, 0);
+#ifdef CONFIG_SYSFS
+	if (sysfs_create_group(mm_kobj, &swap_slots_attr_group))
+		printk(KERN_ERR "swap: register swap_slots sysfs failed\n");
+#endif
+	return 0;
+}
+__initcall(swap_slots_cache_init);
+
 #ifdef MAX_SWAPFILES_CHECK
 static int __init max_swapfiles_check(void)
 {
@@ -15,11 +15,17 @@
 #define DEBUG
 
 #include <linux/file.h>
+#include <linux/hash.h>
 #include <linux/inetdevice.h>
 #include <linux/module.h>
+#include <linux/mutex.h>
 #include <linux/netfilter/x_tables.h>
 #include <linux/netfilter/xt_qtaguid.h>
+#include <linux/rcupdate.h>
+#include <linux/seqlock.h>
 #include <linux/skbuff.h>
+#include <linux/uaccess.h>
+#include <linux/vmalloc.h>
 #include <linux/workqueue.h>
 #include <net/addrconf.h>
 #include <net/sock.h>
@@ -48,6 +54,12 @@ static struct proc_dir_entry *xt_qtaguid_stats_file;
 static unsigned int proc_stats_perms = S_IRUGO;
 module_param_named(stats_perms, proc_stats_perms, uint, S_IRUGO | S_IWUSR);
 
+/* Writing only sets up what the reader of that open file gets back */
+static struct proc_dir_entry *xt_qtaguid_stats_bin_file;
+static unsigned int proc_stats_bin_perms = S_IRUGO | S_IWUGO;
+module_param_named(stats_bin_perms, proc_stats_bin_perms, uint,
+		   S_IRUGO | S_IWUSR);
+
 static struct proc_dir_entry *xt_qtaguid_ctrl_file;
 #ifdef CONFIG_ANDROID_PARANOID_NETWORK
 static unsigned int proc_ctrl_perms = S_IRUGO | S_IWUGO;
@@ -178,15 +190,22 @@ static struct proc_dir_entry *iface_stat_all_procfile;
  * qtaguid_mt()
  *   account_for_uid()
  *     if_tag_stat_update()
- *       get_sock_stat()
- *         sock_tag_list_lock
- *       struct iface_stat->tag_stat_list_lock
+ *       get_iface_entry_for_dev()
+ *         (iface_stat_hash, RCU)
+ *         iface_stat_list_lock, only when the hash misses
+ *       get_sock_tag()
+ *         (sock_tag_hash, RCU)
+ *       (struct iface_stat->tag_stat_tree, RCU)
  *         tag_stat_update()
  *           get_active_counter_set()
- *             tag_counter_set_list_lock
+ *             (tag_counter_set_tree, RCU)
+ *             tag_counter_set_list_lock, only when racing a change
+ *       struct iface_stat->tag_stat_list_lock, only when the RCU search
+ *       misses or the entry is first updated in a stats generation
+ *         tag_stat_stamp()
  *         tag_stat_update()
  *           get_active_counter_set()
- *             tag_counter_set_list_lock
+ *             (as above)
  *
  *
  * qtaguid_ctrl_parse()
@@ -213,12 +232,28 @@ static struct proc_dir_entry *iface_stat_all_procfile;
  */
 static LIST_HEAD(iface_stat_list);
 static DEFINE_SPINLOCK(iface_stat_list_lock);
+/*
+ * The same iface_stat entries, hashed by ifindex for the packet path.
+ * Only changed under iface_stat_list_lock, searched under RCU.
+ */
+#define IFACE_STAT_HASH_BITS 4
+static struct hlist_head iface_stat_hash[1 << IFACE_STAT_HASH_BITS];
 
 static struct rb_root sock_tag_tree = RB_ROOT;
 static DEFINE_SPINLOCK(sock_tag_list_lock);
+/*
+ * The same sock_tags, hashed by sk for the packet path.
+ * Only changed under sock_tag_list_lock, searched under RCU.
+ * sock_tag_seq is bumped around re-tagging, as the tag is updated in place.
+ */
+#define SOCK_TAG_HASH_BITS 8
+static struct hlist_head sock_tag_hash[1 << SOCK_TAG_HASH_BITS];
+static seqcount_t sock_tag_seq = SEQCNT_ZERO;
 
 static struct rb_root tag_counter_set_tree = RB_ROOT;
 static DEFINE_SPINLOCK(tag_counter_set_list_lock);
+/* Bumped on tag_counter_set_tree changes, for its lockless readers */
+static seqcount_t tag_counter_set_seq = SEQCNT_ZERO;
 
 static struct rb_root uid_tag_data_tree = RB_ROOT;
 static DEFINE_SPINLOCK(uid_tag_data_tree_lock);
@@ -227,6 +262,15 @@ static struct rb_root proc_qtu_data_tree = RB_ROOT;
 /* No proc_qtu_data_tree_lock; use uid_tag_data_tree_lock */
 
 static struct qtaguid_event_counts qtu_events;
+
+/*
+ * Generations for the binary stats export. Each export starts a new one,
+ * and tag_stats are stamped with the one they were last updated in.
+ * qtu_stats_delete_gen is the generation started after stats were deleted.
+ * They are 64bit so that they never wrap.
+ */
+static atomic64_t qtu_stats_gen = ATOMIC64_INIT(1);
+static atomic64_t qtu_stats_delete_gen = ATOMIC64_INIT(0);
 /*----------------------------------------------*/
 static bool can_manipulate_uids(void)
 {
@@ -276,6 +320,41 @@ static inline uint64_t dc_sum_packets(struct data_counters *counters,
 		+ counters->bpc[set][direction][IFS_PROTO_OTHER].packets;
 }
 
+/*
+ * Sum up the per-cpu slots of a tag_stat.
+ * Caller must hold the iface_stat->tag_stat_list_lock of the tag_stat.
+ */
+static void tag_stat_get_counters(struct tag_stat *ts_entry,
+				  struct data_counters *dc)
+{
+	int cpu, set, direction, proto;
+
+	memset(dc, 0, sizeof(*dc));
+	for_each_possible_cpu(cpu) {
+		struct tag_stat_counters *tsc = &ts_entry->counters[cpu];
+		struct data_counters snap;
+		unsigned int start;
+
+		do {
+			start = u64_stats_fetch_begin_bh(&tsc->syncp);
+			snap = tsc->dc;
+		} while (u64_stats_fetch_retry_bh(&tsc->syncp, start));
+
+		for (set = 0; set < IFS_MAX_COUNTER_SETS; set++)
+			for (direction = 0; direction < IFS_MAX_DIRECTIONS;
+			     direction++)
+				for (proto = 0; proto < IFS_MAX_PROTOS;
+				     proto++) {
+					struct byte_packet_counters *bpc;
+					bpc = &snap.bpc[set][direction][proto];
+					dc->bpc[set][direction][proto].bytes +=
+						bpc->bytes;
+					dc->bpc[set][direction][proto].packets
+						+= bpc->packets;
+				}
+	}
+}
+
 static struct tag_node *tag_node_tree_search(struct rb_root *root, tag_t tag)
 {
 	struct rb_node *node = root->rb_node;
@@ -299,6 +378,41 @@ static struct tag_node *tag_node_tree_search(struct rb_root *root, tag_t tag)
 	return NULL;
 }
 
+/*
+ * Lockless version of tag_node_tree_search(), for trees whose entries are
+ * freed after an RCU grace period.
+ * A concurrent insert or erase can rebalance the tree under us, so this may
+ * miss an entry that is there; callers deal with that. The walk is bounded
+ * in case it runs into a rotation and goes round in circles.
+ * Caller must be in an RCU read-side section.
+ */
+#define TAG_NODE_MAXDEPTH 64
+static struct tag_node *tag_node_tree_search_rcu(struct rb_root *root,
+						 tag_t tag)
+{
+	struct rb_node *node = rcu_dereference_raw(root->rb_node);
+	int depth = 0;
+
+	while (node) {
+		struct tag_node *data = rb_entry(node, struct tag_node, node);
+		int result = tag_compare(tag, data->tag);
+
+		if (result < 0)
+			node = rcu_dereference_raw(node->rb_left);
+		else if (result > 0)
+			node = rcu_dereference_raw(node->rb_right);
+		else
+			return data;
+		if (unlikely(++depth == TAG_NODE_MAXDEPTH))
+			break;
+	}
+	return NULL;
+}
+
+/*
+ * Entries that can be found by tag_node_tree_search_rcu() must be fully
+ * set up before they are inserted.
+ */
 static void tag_node_tree_insert(struct tag_node *data, struct rb_root *root)
 {
 	struct rb_node **new = &(root->rb_node), *parent = NULL;
@@ -322,6 +436,7 @@ static void tag_node_tree_insert(struct tag_node *data, struct rb_root *root)
 	}
 
 	/* Add new node and rebalance tree. */
+	smp_wmb();
 	rb_link_node(&data->node, parent, new);
 	rb_insert_color(&data->node, root);
 }
@@ -339,6 +454,23 @@ static struct tag_stat *tag_stat_tree_search(struct rb_root *root, tag_t tag)
 	return rb_entry(&node->node, struct tag_stat, tn.node);
 }
 
+static struct tag_stat *tag_stat_tree_search_rcu(struct rb_root *root,
+						 tag_t tag)
+{
+	struct tag_node *node = tag_node_tree_search_rcu(root, tag);
+	if (!node)
+		return NULL;
+	return rb_entry(&node->node, struct tag_stat, tn.node);
+}
+
+static void tag_stat_free_rcu(struct rcu_head *head)
+{
+	struct tag_stat *ts_entry = container_of(head, struct tag_stat, rcu);
+
+	kfree(ts_entry->counters);
+	kfree(ts_entry);
+}
+
 static void tag_counter_set_tree_insert(struct tag_counter_set *data,
 					struct rb_root *root)
 {
@@ -355,6 +487,15 @@ static struct tag_counter_set *tag_counter_set_tree_search(struct rb_root *root,
 
 }
 
+static struct tag_counter_set *
+tag_counter_set_tree_search_rcu(struct rb_root *root, tag_t tag)
+{
+	struct tag_node *node = tag_node_tree_search_rcu(root, tag);
+	if (!node)
+		return NULL;
+	return rb_entry(&node->node, struct tag_counter_set, tn.node);
+}
+
 static void tag_ref_tree_insert(struct tag_ref *data, struct rb_root *root)
 {
 	tag_node_tree_insert(&data->tn, root);
@@ -408,6 +549,15 @@ static void sock_tag_tree_insert(struct sock_tag *data, struct rb_root *root)
 	rb_insert_color(&data->sock_node, root);
 }
 
+static inline struct hlist_head *sock_tag_hash_head(const struct sock *sk)
+{
+	return &sock_tag_hash[hash_ptr((void *)sk, SOCK_TAG_HASH_BITS)];
+}
+
+/*
+ * Frees sock_tags that are no longer in sock_tag_tree nor sock_tag_hash.
+ * The packet path may still be looking at them, see get_sock_tag().
+ */
 static void sock_tag_tree_erase(struct rb_root *st_to_free_tree)
 {
 	struct rb_node *node;
@@ -424,7 +574,7 @@ static void sock_tag_tree_erase(struct rb_root *st_to_free_tree)
 			 get_uid_from_tag(st_entry->tag));
 		rb_erase(&st_entry->sock_node, st_to_free_tree);
 		sockfd_put(st_entry->socket);
-		kfree(st_entry);
+		kfree_rcu(st_entry, rcu);
 	}
 }
 
@@ -739,17 +889,27 @@ static int get_active_counter_set(tag_t tag)
 {
 	int active_set = 0;
 	struct tag_counter_set *tcs;
+	unsigned int seq;
 
 	MT_DEBUG("qtaguid: get_active_counter_set(tag=0x%llx)"
 		 " (uid=%u)\n",
 		 tag, get_uid_from_tag(tag));
 	/* For now we only handle UID tags for active sets */
 	tag = get_utag_from_tag(tag);
-	spin_lock_bh(&tag_counter_set_list_lock);
-	tcs = tag_counter_set_tree_search(&tag_counter_set_tree, tag);
-	if (tcs)
-		active_set = tcs->active_set;
-	spin_unlock_bh(&tag_counter_set_list_lock);
+	rcu_read_lock();
+	seq = read_seqcount_begin(&tag_counter_set_seq);
+	tcs = tag_counter_set_tree_search_rcu(&tag_counter_set_tree, tag);
+	if (tcs) {
+		active_set = ACCESS_ONCE(tcs->active_set);
+	} else if (read_seqcount_retry(&tag_counter_set_seq, seq)) {
+		/* The tree changed under us, the miss can't be trusted. */
+		spin_lock_bh(&tag_counter_set_list_lock);
+		tcs = tag_counter_set_tree_search(&tag_counter_set_tree, tag);
+		if (tcs)
+			active_set = tcs->active_set;
+		spin_unlock_bh(&tag_counter_set_list_lock);
+	}
+	rcu_read_unlock();
 	return active_set;
 }
 
@@ -777,6 +937,57 @@ done:
 	return iface_entry;
 }
 
+static inline struct hlist_head *iface_stat_hash_head(int ifindex)
+{
+	return &iface_stat_hash[hash_32(ifindex, IFACE_STAT_HASH_BITS)];
+}
+
+/*
+ * Move the entry to the hash chain of the ifindex the interface now has.
+ * Caller must hold iface_stat_list_lock.
+ * Entries are never freed, so a lockless reader that gets carried along
+ * to another chain only misses, and falls back to get_iface_entry().
+ */
+static void iface_stat_set_ifindex(struct iface_stat *entry, int ifindex)
+{
+	if (entry->ifindex == ifindex)
+		return;
+	hlist_del_rcu(&entry->ifindex_node);
+	entry->ifindex = ifindex;
+	hlist_add_head_rcu(&entry->ifindex_node, iface_stat_hash_head(ifindex));
+}
+
+/*
+ * Find the entry for tracking the interface a packet went through.
+ * The hash is searched without iface_stat_list_lock. The name is checked
+ * too as an ifindex can be reused once its interface is gone.
+ */
+static struct iface_stat *get_iface_entry_for_dev(
+	const struct net_device *net_dev)
+{
+	struct iface_stat *iface_entry;
+	struct hlist_node *pos;
+
+	rcu_read_lock();
+	hlist_for_each_entry_rcu(iface_entry, pos,
+				 iface_stat_hash_head(net_dev->ifindex),
+				 ifindex_node) {
+		if (iface_entry->ifindex == net_dev->ifindex
+		    && !strcmp(net_dev->name, iface_entry->ifname)) {
+			rcu_read_unlock();
+			return iface_entry;
+		}
+	}
+	rcu_read_unlock();
+
+	spin_lock_bh(&iface_stat_list_lock);
+	iface_entry = get_iface_entry(net_dev->name);
+	if (iface_entry)
+		iface_stat_set_ifindex(iface_entry, net_dev->ifindex);
+	spin_unlock_bh(&iface_stat_list_lock);
+	return iface_entry;
+}
+
 static int iface_stat_all_proc_read(char *page, char **num_items_returned,
 				    off_t items_to_skip, int char_count,
 				    int *eof, void *data)
@@ -923,6 +1134,8 @@ static struct iface_stat *iface_alloc(struct net_device *net_dev)
 	}
 	spin_lock_init(&new_iface->tag_stat_list_lock);
 	new_iface->tag_stat_tree = RB_ROOT;
+	INIT_LIST_HEAD(&new_iface->tag_stat_changed);
+	new_iface->ifindex = net_dev->ifindex;
 	_iface_stat_set_active(new_iface, net_dev, true);
 
 	/*
@@ -942,6 +1155,8 @@ static struct iface_stat *iface_alloc(struct net_device *net_dev)
 	INIT_WORK(&isw->iface_work, iface_create_proc_worker);
 	schedule_work(&isw->iface_work);
 	list_add(&new_iface->list, &iface_stat_list);
+	hlist_add_head_rcu(&new_iface->ifindex_node,
+			   iface_stat_hash_head(new_iface->ifindex));
 	return new_iface;
 }
 
@@ -1041,6 +1256,7 @@ static void iface_stat_create(struct net_device *net_dev,
 		IF_DEBUG("qtaguid: iface_stat: create(%s): entry=%p\n",
 			 ifname, entry);
 		iface_check_stats_reset_and_adjust(net_dev, entry);
+		iface_stat_set_ifindex(entry, net_dev->ifindex);
 		_iface_stat_set_active(entry, net_dev, activate);
 		IF_DEBUG("qtaguid: %s(%s): "
 			 "tracking now %d on ip=%pI4\n", __func__,
@@ -1103,6 +1319,7 @@ static void iface_stat_create_ipv6(struct net_device *net_dev,
 		IF_DEBUG("qtaguid: %s(%s): entry=%p\n", __func__,
 			 ifname, entry);
 		iface_check_stats_reset_and_adjust(net_dev, entry);
+		iface_stat_set_ifindex(entry, net_dev->ifindex);
 		_iface_stat_set_active(entry, net_dev, activate);
 		IF_DEBUG("qtaguid: %s(%s): "
 			 "tracking now %d on ip=%pI6c\n", __func__,
@@ -1131,16 +1348,34 @@ static struct sock_tag *get_sock_stat_nl(const struct sock *sk)
 	return sock_tag_tree_search(&sock_tag_tree, sk);
 }
 
-static struct sock_tag *get_sock_stat(const struct sock *sk)
+/*
+ * Find the tag of a socket for the packet path, without sock_tag_list_lock.
+ * Returns false if the socket is not tagged.
+ */
+static bool get_sock_tag(const struct sock *sk, tag_t *tag)
 {
 	struct sock_tag *sock_tag_entry;
-	MT_DEBUG("qtaguid: get_sock_stat(sk=%p)\n", sk);
+	struct hlist_node *pos;
+	unsigned int seq;
+	bool found = false;
+
+	MT_DEBUG("qtaguid: get_sock_tag(sk=%p)\n", sk);
 	if (!sk)
-		return NULL;
-	spin_lock_bh(&sock_tag_list_lock);
-	sock_tag_entry = get_sock_stat_nl(sk);
-	spin_unlock_bh(&sock_tag_list_lock);
-	return sock_tag_entry;
+		return false;
+	rcu_read_lock();
+	hlist_for_each_entry_rcu(sock_tag_entry, pos, sock_tag_hash_head(sk),
+				 sk_hash_node) {
+		if (sock_tag_entry->sk != sk)
+			continue;
+		do {
+			seq = read_seqcount_begin(&sock_tag_seq);
+			*tag = sock_tag_entry->tag;
+		} while (read_seqcount_retry(&sock_tag_seq, seq));
+		found = true;
+		break;
+	}
+	rcu_read_unlock();
+	return found;
 }
 
 static void
@@ -1216,8 +1451,66 @@ static void iface_stat_update(struct net_device *net_dev, bool stash_only)
 	spin_unlock_bh(&iface_stat_list_lock);
 }
 
+/*
+ * Bump this cpu's slot. The match runs with bottom halves disabled
+ * (see ipt_do_table()), so nothing else can touch the slot meanwhile.
+ */
+static void tag_stat_counters_update(struct tag_stat_counters *counters,
+				     int set, enum ifs_tx_rx direction,
+				     int proto, int bytes)
+{
+	struct tag_stat_counters *tsc = &counters[smp_processor_id()];
+
+	u64_stats_update_begin(&tsc->syncp);
+	data_counters_update(&tsc->dc, set, direction, proto, bytes);
+	u64_stats_update_end(&tsc->syncp);
+}
+
+/*
+ * Stamp the entry with @gen and move it to the end of the changed list.
+ * Only done when the generation changes, to keep the entry's cacheline
+ * clean. iface_entry->tag_stat_list_lock should be held.
+ */
+static inline void tag_stat_set_gen(struct iface_stat *iface_entry,
+				    struct tag_stat *tag_entry, u64 gen)
+{
+	if (tag_entry->gen == gen)
+		return;
+	tag_entry->gen = gen;
+	list_move_tail(&tag_entry->changed_node,
+		       &iface_entry->tag_stat_changed);
+}
+
+/* Stamp the entry and its parent. tag_stat_list_lock should be held. */
+static void tag_stat_stamp(struct iface_stat *iface_entry,
+			   struct tag_stat *tag_entry, u64 gen)
+{
+	tag_stat_set_gen(iface_entry, tag_entry, gen);
+	if (tag_entry->parent)
+		tag_stat_set_gen(iface_entry, tag_entry->parent, gen);
+}
+
+/*
+ * Are the entry and its parent already stamped with @gen? Then their
+ * counters can be updated without tag_stat_list_lock. A stamp torn on
+ * 32bit by a concurrent tag_stat_set_gen() can only read as @gen if it
+ * is being set to @gen or later.
+ */
+static inline bool tag_stat_gen_current(struct tag_stat *tag_entry,
+					u64 gen)
+{
+	return ACCESS_ONCE(tag_entry->gen) == gen
+		&& (!tag_entry->parent
+		    || ACCESS_ONCE(tag_entry->parent->gen) == gen);
+}
+
+/*
+ * Only bumps the counters: the caller either holds
+ * iface_entry->tag_stat_list_lock and stamps the entry with
+ * tag_stat_stamp(), or has found tag_stat_gen_current().
+ */
 static void tag_stat_update(struct tag_stat *tag_entry,
-			enum ifs_tx_rx direction, int proto, int bytes)
+			    enum ifs_tx_rx direction, int proto, int bytes)
 {
 	int active_set;
 	active_set = get_active_counter_set(tag_entry->tn.tag);
@@ -1225,11 +1518,11 @@ static void tag_stat_update(struct tag_stat *tag_entry,
 		 "dir=%d proto=%d bytes=%d)\n",
 		 tag_entry->tn.tag, get_uid_from_tag(tag_entry->tn.tag),
 		 active_set, direction, proto, bytes);
-	data_counters_update(&tag_entry->counters, active_set, direction,
-			     proto, bytes);
-	if (tag_entry->parent_counters)
-		data_counters_update(tag_entry->parent_counters, active_set,
-				     direction, proto, bytes);
+	tag_stat_counters_update(tag_entry->counters, active_set, direction,
+				 proto, bytes);
+	if (tag_entry->parent)
+		tag_stat_counters_update(tag_entry->parent->counters,
+					 active_set, direction, proto, bytes);
 }
 
 /*
@@ -1237,8 +1530,8 @@ static void tag_stat_update(struct tag_stat *tag_entry,
  * the interface.
  * iface_entry->tag_stat_list_lock should be held.
  */
-static struct tag_stat *create_if_tag_stat(struct iface_stat *iface_entry,
-					   tag_t tag)
+static struct tag_stat *create_if_tag_stat(
+	struct iface_stat *iface_entry, tag_t tag, struct tag_stat *parent)
 {
 	struct tag_stat *new_tag_stat_entry = NULL;
 	IF_DEBUG("qtaguid: iface_stat: %s(): ife=%p tag=0x%llx"
@@ -1249,29 +1542,44 @@ static struct tag_stat *create_if_tag_stat(struct iface_stat *iface_entry,
 		pr_err("qtaguid: iface_stat: tag stat alloc failed\n");
 		goto done;
 	}
+	/* alloc_percpu() can sleep, so the slots are kept in an array. */
+	new_tag_stat_entry->counters = kcalloc(nr_cpu_ids,
+					       sizeof(struct tag_stat_counters),
+					       GFP_ATOMIC);
+	if (!new_tag_stat_entry->counters) {
+		pr_err("qtaguid: iface_stat: tag stat counters alloc failed\n");
+		kfree(new_tag_stat_entry);
+		new_tag_stat_entry = NULL;
+		goto done;
+	}
 	new_tag_stat_entry->tn.tag = tag;
+	new_tag_stat_entry->parent = parent;
+	new_tag_stat_entry->gen = atomic64_read(&qtu_stats_gen);
+	list_add_tail(&new_tag_stat_entry->changed_node,
+		      &iface_entry->tag_stat_changed);
 	tag_stat_tree_insert(new_tag_stat_entry, &iface_entry->tag_stat_tree);
 done:
 	return new_tag_stat_entry;
 }
 
-static void if_tag_stat_update(const char *ifname, uid_t uid,
+static void if_tag_stat_update(const struct net_device *net_dev, uid_t uid,
 			       const struct sock *sk, enum ifs_tx_rx direction,
 			       int proto, int bytes)
 {
+	const char *ifname = net_dev->name;
 	struct tag_stat *tag_stat_entry;
 	tag_t tag, acct_tag;
 	tag_t uid_tag;
-	struct data_counters *uid_tag_counters;
-	struct sock_tag *sock_tag_entry;
+	struct tag_stat *uid_tag_stat;
 	struct iface_stat *iface_entry;
-	struct tag_stat *new_tag_stat;
+	struct tag_stat *new_tag_stat = NULL;
+	u64 gen;
 	MT_DEBUG("qtaguid: if_tag_stat_update(ifname=%s "
 		"uid=%u sk=%p dir=%d proto=%d bytes=%d)\n",
 		 ifname, uid, sk, direction, proto, bytes);
 
 
-	iface_entry = get_iface_entry(ifname);
+	iface_entry = get_iface_entry_for_dev(net_dev);
 	if (!iface_entry) {
 		pr_err("qtaguid: iface_stat: stat_update() %s not found\n",
 		       ifname);
@@ -1286,9 +1594,7 @@ static void if_tag_stat_update(const char *ifname, uid_t uid,
 	 * Look for a tagged sock.
 	 * It will have an acct_uid.
 	 */
-	sock_tag_entry = get_sock_stat(sk);
-	if (sock_tag_entry) {
-		tag = sock_tag_entry->tag;
+	if (get_sock_tag(sk, &tag)) {
 		acct_tag = get_atag_from_tag(tag);
 		uid_tag = get_utag_from_tag(tag);
 	} else {
@@ -1299,16 +1605,35 @@ static void if_tag_stat_update(const char *ifname, uid_t uid,
 	MT_DEBUG("qtaguid: iface_stat: stat_update(): "
 		 " looking for tag=0x%llx (uid=%u) in ife=%p\n",
 		 tag, get_uid_from_tag(tag), iface_entry);
-	/* Loop over tag list under this interface for {acct_tag,uid_tag} */
+	/*
+	 * Search the tag tree under this interface for {acct_tag,uid_tag}.
+	 * Once the entry exists, and has been stamped with the current
+	 * stats generation, this is all there is to it, so it is done
+	 * without the lock. Entries are freed after a grace period.
+	 */
+	rcu_read_lock();
+	gen = atomic64_read(&qtu_stats_gen);
+	tag_stat_entry = tag_stat_tree_search_rcu(&iface_entry->tag_stat_tree,
+						  tag);
+	if (tag_stat_entry && tag_stat_gen_current(tag_stat_entry, gen)) {
+		/*
+		 * Updating the {acct_tag, uid_tag} entry handles both stats:
+		 * {0, uid_tag} will also get updated.
+		 */
+		tag_stat_update(tag_stat_entry, direction, proto, bytes);
+		rcu_read_unlock();
+		return;
+	}
+	rcu_read_unlock();
+
+	/* Missed, raced with a change or needs stamping: use the lock. */
 	spin_lock_bh(&iface_entry->tag_stat_list_lock);
+	gen = atomic64_read(&qtu_stats_gen);
 
 	tag_stat_entry = tag_stat_tree_search(&iface_entry->tag_stat_tree,
 					      tag);
 	if (tag_stat_entry) {
-		/*
-		 * Updating the {acct_tag, uid_tag} entry handles both stats:
-		 * {0, uid_tag} will also get updated.
-		 */
+		tag_stat_stamp(iface_entry, tag_stat_entry, gen);
 		tag_stat_update(tag_stat_entry, direction, proto, bytes);
 		spin_unlock_bh(&iface_entry->tag_stat_list_lock);
 		return;
@@ -1323,17 +1648,23 @@ static void if_tag_stat_update(const char *ifname, uid_t uid,
 		 * No parent counters. So
 		 *  - No {0, uid_tag} stats and no {acc_tag, uid_tag} stats.
 		 */
-		new_tag_stat = create_if_tag_stat(iface_entry, uid_tag);
-		uid_tag_counters = &new_tag_stat->counters;
+		new_tag_stat = create_if_tag_stat(iface_entry, uid_tag, NULL);
+		if (!new_tag_stat)
+			goto unlock;
+		uid_tag_stat = new_tag_stat;
 	} else {
-		uid_tag_counters = &tag_stat_entry->counters;
+		uid_tag_stat = tag_stat_entry;
 	}
 
 	if (acct_tag) {
-		new_tag_stat = create_if_tag_stat(iface_entry, tag);
-		new_tag_stat->parent_counters = uid_tag_counters;
+		new_tag_stat = create_if_tag_stat(iface_entry, tag,
+						  uid_tag_stat);
+		if (!new_tag_stat)
+			goto unlock;
 	}
+	tag_stat_stamp(iface_entry, new_tag_stat, gen);
 	tag_stat_update(new_tag_stat, direction, proto, bytes);
+unlock:
 	spin_unlock_bh(&iface_entry->tag_stat_list_lock);
 }
 
@@ -1566,7 +1897,7 @@ static void account_for_uid(const struct sk_buff *skb,
 			 el_dev->name,
 			 el_dev->type);
 
-		if_tag_stat_update(el_dev->name, uid,
+		if_tag_stat_update(el_dev, uid,
 				skb->sk ? skb->sk : alternate_sk,
 				par->in ? IFS_RX : IFS_TX,
 				ip_hdr(skb)->protocol, skb->len);
@@ -1870,6 +2201,7 @@ static int ctrl_cmd_delete(const char *input)
 	struct tag_counter_set *tcs_entry;
 	struct tag_ref *tr_entry;
 	struct uid_tag_data *utd_entry;
+	bool stats_deleted = false;
 
 	argc = sscanf(input, "%c %llu %u", &cmd, &acct_tag, &uid);
 	CT_DEBUG("qtaguid: ctrl_delete(%s): argc=%d cmd=%c "
@@ -1914,6 +2246,7 @@ static int ctrl_cmd_delete(const char *input)
 
 		if (!acct_tag || st_entry->tag == tag) {
 			rb_erase(&st_entry->sock_node, &sock_tag_tree);
+			hlist_del_rcu(&st_entry->sk_hash_node);
 			/* Can't sockfd_put() within spinlock, do it later. */
 			sock_tag_tree_insert(st_entry, &st_to_free_tree);
 			tr_entry = lookup_tag_ref(st_entry->tag, NULL);
@@ -1945,8 +2278,10 @@ static int ctrl_cmd_delete(const char *input)
 			 tcs_entry->tn.tag,
 			 get_uid_from_tag(tcs_entry->tn.tag),
 			 tcs_entry->active_set);
+		write_seqcount_begin(&tag_counter_set_seq);
 		rb_erase(&tcs_entry->tn.node, &tag_counter_set_tree);
-		kfree(tcs_entry);
+		write_seqcount_end(&tag_counter_set_seq);
+		kfree_rcu(tcs_entry, rcu);
 	}
 	spin_unlock_bh(&tag_counter_set_list_lock);
 
@@ -1977,12 +2312,18 @@ static int ctrl_cmd_delete(const char *input)
 					 entry_uid);
 				rb_erase(&ts_entry->tn.node,
 					 &iface_entry->tag_stat_tree);
-				kfree(ts_entry);
+				list_del(&ts_entry->changed_node);
+				call_rcu(&ts_entry->rcu, tag_stat_free_rcu);
+				stats_deleted = true;
 			}
 		}
 		spin_unlock_bh(&iface_entry->tag_stat_list_lock);
 	}
 	spin_unlock_bh(&iface_stat_list_lock);
+	/* Binary stats readers that may have seen them must start over. */
+	if (stats_deleted)
+		atomic64_set(&qtu_stats_delete_gen,
+			     atomic64_inc_return(&qtu_stats_gen));
 
 	/* Cleanup the uid_tag_data */
 	spin_lock_bh(&uid_tag_data_tree_lock);
@@ -2059,7 +2400,10 @@ static int ctrl_cmd_counter_set(const char *input)
 			goto err;
 		}
 		tcs->tn.tag = tag;
+		tcs->active_set = counter_set;
+		write_seqcount_begin(&tag_counter_set_seq);
 		tag_counter_set_tree_insert(tcs, &tag_counter_set_tree);
+		write_seqcount_end(&tag_counter_set_seq);
 		CT_DEBUG("qtaguid: ctrl_counterset(%s): added tcs tag=0x%llx "
 			 "(uid=%u) set=%d\n",
 			 input, tag, get_uid_from_tag(tag), counter_set);
@@ -2158,7 +2502,9 @@ static int ctrl_cmd_tag(const char *input)
 		BUG_ON(IS_ERR_OR_NULL(prev_tag_ref_entry));
 		BUG_ON(prev_tag_ref_entry->num_sock_tags <= 0);
 		prev_tag_ref_entry->num_sock_tags--;
+		write_seqcount_begin(&sock_tag_seq);
 		sock_tag_entry->tag = full_tag;
+		write_seqcount_end(&sock_tag_seq);
 	} else {
 		CT_DEBUG("qtaguid: ctrl_tag(%s): newtag for sk=%p\n",
 			 input, el_socket->sk);
@@ -2198,6 +2544,8 @@ static int ctrl_cmd_tag(const char *input)
 		spin_unlock_bh(&uid_tag_data_tree_lock);
 
 		sock_tag_tree_insert(sock_tag_entry, &sock_tag_tree);
+		hlist_add_head_rcu(&sock_tag_entry->sk_hash_node,
+				   sock_tag_hash_head(sock_tag_entry->sk));
 		atomic64_inc(&qtu_events.sockets_tagged);
 	}
 	spin_unlock_bh(&sock_tag_list_lock);
@@ -2262,6 +2610,7 @@ static int ctrl_cmd_untag(const char *input)
 	 * so it can do whatever it wants to it.
 	 */
 	rb_erase(&sock_tag_entry->sock_node, &sock_tag_tree);
+	hlist_del_rcu(&sock_tag_entry->sk_hash_node);
 
 	tag_ref_entry = lookup_tag_ref(sock_tag_entry->tag, &utd_entry);
 	BUG_ON(!tag_ref_entry);
@@ -2298,7 +2647,7 @@ static int ctrl_cmd_untag(const char *input)
 		 atomic_long_read(&el_socket->file->f_count) - 1);
 	sockfd_put(el_socket);
 
-	kfree(sock_tag_entry);
+	kfree_rcu(sock_tag_entry, rcu);
 	atomic64_inc(&qtu_events.sockets_untagged);
 
 	return 0;
@@ -2382,7 +2731,7 @@ struct proc_print_info {
 static int pp_stats_line(struct proc_print_info *ppi, int cnt_set)
 {
 	int len;
-	struct data_counters *cnts;
+	struct data_counters cnts;
 
 	if (!ppi->item_index) {
 		if (ppi->item_index++ < ppi->items_to_skip)
@@ -2412,7 +2761,7 @@ static int pp_stats_line(struct proc_print_info *ppi, int cnt_set)
 		}
 		if (ppi->item_index++ < ppi->items_to_skip)
 			return 0;
-		cnts = &ppi->ts_entry->counters;
+		tag_stat_get_counters(ppi->ts_entry, &cnts);
 		len = snprintf(
 			ppi->outp, ppi->char_count,
 			"%d %s 0x%llx %u %u "
@@ -2429,22 +2778,22 @@ static int pp_stats_line(struct proc_print_info *ppi, int cnt_set)
 			get_atag_from_tag(tag),
 			stat_uid,
 			cnt_set,
-			dc_sum_bytes(cnts, cnt_set, IFS_RX),
-			dc_sum_packets(cnts, cnt_set, IFS_RX),
-			dc_sum_bytes(cnts, cnt_set, IFS_TX),
-			dc_sum_packets(cnts, cnt_set, IFS_TX),
-			cnts->bpc[cnt_set][IFS_RX][IFS_TCP].bytes,
-			cnts->bpc[cnt_set][IFS_RX][IFS_TCP].packets,
-			cnts->bpc[cnt_set][IFS_RX][IFS_UDP].bytes,
-			cnts->bpc[cnt_set][IFS_RX][IFS_UDP].packets,
-			cnts->bpc[cnt_set][IFS_RX][IFS_PROTO_OTHER].bytes,
-			cnts->bpc[cnt_set][IFS_RX][IFS_PROTO_OTHER].packets,
-			cnts->bpc[cnt_set][IFS_TX][IFS_TCP].bytes,
-			cnts->bpc[cnt_set][IFS_TX][IFS_TCP].packets,
-			cnts->bpc[cnt_set][IFS_TX][IFS_UDP].bytes,
-			cnts->bpc[cnt_set][IFS_TX][IFS_UDP].packets,
-			cnts->bpc[cnt_set][IFS_TX][IFS_PROTO_OTHER].bytes,
-			cnts->bpc[cnt_set][IFS_TX][IFS_PROTO_OTHER].packets);
+			dc_sum_bytes(&cnts, cnt_set, IFS_RX),
+			dc_sum_packets(&cnts, cnt_set, IFS_RX),
+			dc_sum_bytes(&cnts, cnt_set, IFS_TX),
+			dc_sum_packets(&cnts, cnt_set, IFS_TX),
+			cnts.bpc[cnt_set][IFS_RX][IFS_TCP].bytes,
+			cnts.bpc[cnt_set][IFS_RX][IFS_TCP].packets,
+			cnts.bpc[cnt_set][IFS_RX][IFS_UDP].bytes,
+			cnts.bpc[cnt_set][IFS_RX][IFS_UDP].packets,
+			cnts.bpc[cnt_set][IFS_RX][IFS_PROTO_OTHER].bytes,
+			cnts.bpc[cnt_set][IFS_RX][IFS_PROTO_OTHER].packets,
+			cnts.bpc[cnt_set][IFS_TX][IFS_TCP].bytes,
+			cnts.bpc[cnt_set][IFS_TX][IFS_TCP].packets,
+			cnts.bpc[cnt_set][IFS_TX][IFS_UDP].bytes,
+			cnts.bpc[cnt_set][IFS_TX][IFS_UDP].packets,
+			cnts.bpc[cnt_set][IFS_TX][IFS_PROTO_OTHER].bytes,
+			cnts.bpc[cnt_set][IFS_TX][IFS_PROTO_OTHER].packets);
 	}
 	return len;
 }
@@ -2539,6 +2888,269 @@ static int qtaguid_stats_proc_read(char *page, char **num_items_returned,
 	return ppi.outp - page;
 }
 
+/*
+ * Binary stats export, see include/linux/netfilter/xt_qtaguid.h.
+ * The reply is built on the first read after open or after a request
+ * is written, and then read out from that snapshot.
+ */
+struct stats_bin_data {
+	struct mutex lock;
+	u64 since_gen;
+	void *buf;
+	size_t len;
+};
+
+struct stats_bin_fill {
+	bool full;
+	u64 since_gen;
+	struct xt_qtaguid_iface_rec *iface_recs;
+	/* NULL to only count, assuming every counter set of a tag is used */
+	struct xt_qtaguid_tag_rec *tag_recs;
+	/* Entries only get stored while there is room, but all get counted */
+	unsigned int max_ifaces, max_tags;
+	unsigned int num_ifaces, num_tags;
+};
+
+static void stats_bin_fill_counts(struct xt_qtaguid_stats_counts *dst,
+				  struct byte_packet_counters *src)
+{
+	dst->bytes = src->bytes;
+	dst->packets = src->packets;
+}
+
+static void stats_bin_add_tags(struct stats_bin_fill *sbf,
+			       struct iface_stat *iface_entry,
+			       struct tag_stat *ts_entry)
+{
+	struct data_counters cnts;
+	struct xt_qtaguid_tag_rec *rec;
+	tag_t tag = ts_entry->tn.tag;
+	int cnt_set, proto;
+
+	if (!sbf->tag_recs) {
+		sbf->num_tags += IFS_MAX_COUNTER_SETS;
+		return;
+	}
+	if (!can_read_other_uid_stats(get_uid_from_tag(tag)))
+		return;
+
+	tag_stat_get_counters(ts_entry, &cnts);
+	for (cnt_set = 0; cnt_set < IFS_MAX_COUNTER_SETS; cnt_set++) {
+		/* Counters only grow, so a set that is 0 was never used. */
+		if (!dc_sum_packets(&cnts, cnt_set, IFS_RX)
+		    && !dc_sum_packets(&cnts, cnt_set, IFS_TX))
+			continue;
+		if (sbf->num_tags++ >= sbf->max_tags)
+			continue;
+		rec = &sbf->tag_recs[sbf->num_tags - 1];
+		strncpy(rec->ifname, iface_entry->ifname, IFNAMSIZ);
+		rec->acct_tag = get_atag_from_tag(tag);
+		rec->uid = get_uid_from_tag(tag);
+		rec->cnt_set = cnt_set;
+		for (proto = 0; proto < IFS_MAX_PROTOS; proto++) {
+			stats_bin_fill_counts(
+				&rec->counts[XT_QTAGUID_RX][proto],
+				&cnts.bpc[cnt_set][IFS_RX][proto]);
+			stats_bin_fill_counts(
+				&rec->counts[XT_QTAGUID_TX][proto],
+				&cnts.bpc[cnt_set][IFS_TX][proto]);
+		}
+	}
+}
+
+static void stats_bin_add_iface(struct stats_bin_fill *sbf,
+				struct iface_stat *iface_entry)
+{
+	struct xt_qtaguid_iface_rec *rec;
+	struct rtnl_link_stats64 dev_stats, *stats;
+
+	if (sbf->num_ifaces++ >= sbf->max_ifaces)
+		return;
+	rec = &sbf->iface_recs[sbf->num_ifaces - 1];
+	strncpy(rec->ifname, iface_entry->ifname, IFNAMSIZ);
+	rec->active = iface_entry->active;
+	stats_bin_fill_counts(&rec->totals[XT_QTAGUID_RX],
+			      &iface_entry->totals[IFS_RX]);
+	stats_bin_fill_counts(&rec->totals[XT_QTAGUID_TX],
+			      &iface_entry->totals[IFS_TX]);
+	if (iface_entry->active) {
+		stats = dev_get_stats(iface_entry->net_dev, &dev_stats);
+		rec->dev[XT_QTAGUID_RX].bytes = stats->rx_bytes;
+		rec->dev[XT_QTAGUID_RX].packets = stats->rx_packets;
+		rec->dev[XT_QTAGUID_TX].bytes = stats->tx_bytes;
+		rec->dev[XT_QTAGUID_TX].packets = stats->tx_packets;
+	}
+}
+
+static void stats_bin_fill(struct stats_bin_fill *sbf)
+{
+	struct iface_stat *iface_entry;
+	struct tag_stat *ts_entry;
+	struct rb_node *node;
+
+	sbf->num_ifaces = 0;
+	sbf->num_tags = 0;
+	if (unlikely(module_passive))
+		return;
+
+	spin_lock_bh(&iface_stat_list_lock);
+	list_for_each_entry(iface_entry, &iface_stat_list, list) {
+		stats_bin_add_iface(sbf, iface_entry);
+		spin_lock_bh(&iface_entry->tag_stat_list_lock);
+		if (sbf->full) {
+			for (node = rb_first(&iface_entry->tag_stat_tree);
+			     node;
+			     node = rb_next(node))
+				stats_bin_add_tags(sbf, iface_entry,
+						   rb_entry(node,
+							    struct tag_stat,
+							    tn.node));
+		} else {
+			/* Newest first, up to the first one not changed */
+			list_for_each_entry_reverse(ts_entry,
+					&iface_entry->tag_stat_changed,
+					changed_node) {
+				if (ts_entry->gen < sbf->since_gen)
+					break;
+				stats_bin_add_tags(sbf, iface_entry, ts_entry);
+			}
+		}
+		spin_unlock_bh(&iface_entry->tag_stat_list_lock);
+	}
+	spin_unlock_bh(&iface_stat_list_lock);
+}
+
+static int stats_bin_build(struct stats_bin_data *sbd)
+{
+	struct stats_bin_fill sbf = {
+		.since_gen = sbd->since_gen,
+	};
+	struct xt_qtaguid_stats_hdr *hdr;
+	size_t iface_size, tag_size;
+	u64 gen;
+	void *buf;
+
+	/* Updates from here on are stamped with the next generation. */
+	gen = atomic64_inc_return(&qtu_stats_gen) - 1;
+	sbf.full = !sbf.since_gen
+		|| sbf.since_gen < atomic64_read(&qtu_stats_delete_gen);
+
+	/*
+	 * Count the changed entries, without summing their counters, then
+	 * fill. Retry if entries were added in between.
+	 */
+	stats_bin_fill(&sbf);
+	for (;;) {
+		sbf.max_ifaces = sbf.num_ifaces + 4;
+		sbf.max_tags = sbf.num_tags + sbf.num_tags / 8 + 16;
+		iface_size = sbf.max_ifaces * sizeof(*sbf.iface_recs);
+		tag_size = sbf.max_tags * sizeof(*sbf.tag_recs);
+		buf = vzalloc(sizeof(*hdr) + iface_size + tag_size);
+		if (!buf)
+			return -ENOMEM;
+		sbf.iface_recs = buf + sizeof(*hdr);
+		sbf.tag_recs = buf + sizeof(*hdr) + iface_size;
+		stats_bin_fill(&sbf);
+		if (sbf.num_ifaces <= sbf.max_ifaces
+		    && sbf.num_tags <= sbf.max_tags)
+			break;
+		vfree(buf);
+	}
+
+	/* Close the gap left after the iface records. */
+	iface_size = sbf.num_ifaces * sizeof(*sbf.iface_recs);
+	tag_size = sbf.num_tags * sizeof(*sbf.tag_recs);
+	memmove(buf + sizeof(*hdr) + iface_size, sbf.tag_recs, tag_size);
+
+	hdr = buf;
+	hdr->version = XT_QTAGUID_STATS_VERSION;
+	hdr->flags = sbf.full ? XT_QTAGUID_STATS_F_FULL : 0;
+	hdr->generation = gen;
+	hdr->num_ifaces = sbf.num_ifaces;
+	hdr->num_tags = sbf.num_tags;
+
+	sbd->buf = buf;
+	sbd->len = sizeof(*hdr) + iface_size + tag_size;
+	CT_DEBUG("qtaguid: stats_bin: since=%llu gen=%llu full=%d "
+		 "ifaces=%u tags=%u\n", sbf.since_gen, gen, sbf.full,
+		 sbf.num_ifaces, sbf.num_tags);
+	return 0;
+}
+
+static int qtaguid_stats_bin_open(struct inode *inode, struct file *file)
+{
+	struct stats_bin_data *sbd;
+
+	sbd = kzalloc(sizeof(*sbd), GFP_KERNEL);
+	if (!sbd)
+		return -ENOMEM;
+	mutex_init(&sbd->lock);
+	file->private_data = sbd;
+	return 0;
+}
+
+static ssize_t qtaguid_stats_bin_read(struct file *file, char __user *buffer,
+				      size_t count, loff_t *ppos)
+{
+	struct stats_bin_data *sbd = file->private_data;
+	ssize_t res;
+
+	mutex_lock(&sbd->lock);
+	if (!sbd->buf) {
+		res = stats_bin_build(sbd);
+		if (res)
+			goto out;
+	}
+	res = simple_read_from_buffer(buffer, count, ppos, sbd->buf,
+				      sbd->len);
+out:
+	mutex_unlock(&sbd->lock);
+	return res;
+}
+
+static ssize_t qtaguid_stats_bin_write(struct file *file,
+				       const char __user *buffer,
+				       size_t count, loff_t *ppos)
+{
+	struct stats_bin_data *sbd = file->private_data;
+	struct xt_qtaguid_stats_req req;
+
+	if (count != sizeof(req))
+		return -EINVAL;
+	if (copy_from_user(&req, buffer, sizeof(req)))
+		return -EFAULT;
+	if (req.version != XT_QTAGUID_STATS_VERSION)
+		return -EINVAL;
+
+	mutex_lock(&sbd->lock);
+	sbd->since_gen = req.since_gen;
+	vfree(sbd->buf);
+	sbd->buf = NULL;
+	sbd->len = 0;
+	/* The next read returns the reply from its start. */
+	*ppos = 0;
+	mutex_unlock(&sbd->lock);
+	return count;
+}
+
+static int qtaguid_stats_bin_release(struct inode *inode, struct file *file)
+{
+	struct stats_bin_data *sbd = file->private_data;
+
+	vfree(sbd->buf);
+	kfree(sbd);
+	return 0;
+}
+
+static const struct file_operations qtaguid_stats_bin_fops = {
+	.owner = THIS_MODULE,
+	.open = qtaguid_stats_bin_open,
+	.read = qtaguid_stats_bin_read,
+	.write = qtaguid_stats_bin_write,
+	.llseek = default_llseek,
+	.release = qtaguid_stats_bin_release,
+};
+
 /*------------------------------------------*/
 static int qtudev_open(struct inode *inode, struct file *file)
 {
@@ -2657,6 +3269,7 @@ static int qtudev_release(struct inode *inode, struct file *file)
 		free_tag_ref_from_utd_entry(tr, utd_entry);
 
 		rb_erase(&st_entry->sock_node, &sock_tag_tree);
+		hlist_del_rcu(&st_entry->sk_hash_node);
 		list_del(&st_entry->list);
 		/* Can't sockfd_put() within spinlock, do it later. */
 		sock_tag_tree_insert(st_entry, &st_to_free_tree);
@@ -2736,8 +3349,21 @@ static int __init qtaguid_proc_register(struct proc_dir_entry **res_procdir)
 	 * TODO: add support counter hacking
 	 * xt_qtaguid_stats_file->write_proc = qtaguid_stats_proc_write;
 	 */
+
+	xt_qtaguid_stats_bin_file = proc_create("stats_bin",
+						proc_stats_bin_perms,
+						*res_procdir,
+						&qtaguid_stats_bin_fops);
+	if (!xt_qtaguid_stats_bin_file) {
+		pr_err("qtaguid: failed to create xt_qtaguid/stats_bin "
+			"file\n");
+		ret = -ENOMEM;
+		goto no_stats_bin_entry;
+	}
 	return 0;
 
+no_stats_bin_entry:
+	remove_proc_entry("stats", *res_procdir);
 no_stats_entry:
 	remove_proc_entry("ctrl", *res_procdir);
 no_ctrl_entry:
@@ -11,8 +11,12 @@
 #define __XT_QTAGUID_INTERNAL_H__
 
 #include <linux/types.h>
+#include <linux/cache.h>
+#include <linux/list.h>
 #include <linux/rbtree.h>
+#include <linux/rcupdate.h>
 #include <linux/spinlock_types.h>
+#include <linux/u64_stats_sync.h>
 #include <linux/workqueue.h>
 
 /* Iface handling */
@@ -185,18 +189,43 @@ struct tag_node {
 	tag_t tag;
 };
 
+/*
+ * One slot of a tag_stat's counters. Each cpu only ever bumps its own slot,
+ * with bottom halves disabled, so no lock is needed on the packet path.
+ * The syncp lets readers get consistent 64bit values on 32bit machines.
+ */
+struct tag_stat_counters {
+	struct data_counters dc;
+	struct u64_stats_sync syncp;
+} ____cacheline_aligned_in_smp;
+
 struct tag_stat {
 	struct tag_node tn;
-	struct data_counters counters;
+	/*
+	 * nr_cpu_ids slots, indexed by cpu. They are only summed up when
+	 * the stats are read, see tag_stat_get_counters().
+	 */
+	struct tag_stat_counters *counters;
 	/*
 	 * If this tag is acct_tag based, we need to count against the
 	 * matching parent uid_tag.
 	 */
-	struct data_counters *parent_counters;
+	struct tag_stat *parent;
+	/*
+	 * Stats generation of the last update, for the binary export, and
+	 * place in iface_stat->tag_stat_changed. Both change together,
+	 * under tag_stat_list_lock.
+	 */
+	u64 gen;
+	struct list_head changed_node;
+	struct rcu_head rcu;
 };
 
 struct iface_stat {
 	struct list_head list;  /* in iface_stat_list */
+	/* in iface_stat_hash[], keyed by ifindex */
+	struct hlist_node ifindex_node;
+	int ifindex;
 	char *ifname;
 	bool active;
 	/* net_dev is only valid for active iface_stat */
@@ -217,7 +246,16 @@ struct iface_stat {
 
 	struct proc_dir_entry *proc_ptr;
 
+	/*
+	 * Changed under tag_stat_list_lock. The packet path first searches
+	 * it under RCU only, and takes the lock when that misses.
+	 */
 	struct rb_root tag_stat_tree;
+	/*
+	 * All the tag_stats in tag_stat_tree, oldest generation first, so
+	 * the binary export only visits those updated since its last read.
+	 */
+	struct list_head tag_stat_changed;
 	spinlock_t tag_stat_list_lock;
 };
 
@@ -235,6 +273,8 @@ struct iface_stat_work {
  */
 struct sock_tag {
 	struct rb_node sock_node;
+	/* in sock_tag_hash[], for the packet path */
+	struct hlist_node sk_hash_node;
 	struct sock *sk;  /* Only used as a number, never dereferenced */
 	/* The socket is needed for sockfd_put() */
 	struct socket *socket;
@@ -243,6 +283,7 @@ struct sock_tag {
 	pid_t pid;
 
 	tag_t tag;
+	struct rcu_head rcu;
 };
 
 struct qtaguid_event_counts {
@@ -279,6 +320,7 @@ struct qtaguid_event_counts {
 struct tag_counter_set {
 	struct tag_node tn;
 	int active_set;
+	struct rcu_head rcu;
 };
 
 /*----------------------------------------------*/
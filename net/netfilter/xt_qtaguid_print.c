@@ -152,8 +152,6 @@ char *pp_tag_ref(struct tag_ref *tr)
 char *pp_tag_stat(struct tag_stat *ts)
 {
 	char *tn_str;
-	char *counters_str;
-	char *parent_counters_str;
 	char *res;
 
 	if (!ts) {
@@ -162,15 +160,13 @@ char *pp_tag_stat(struct tag_stat *ts)
 		return res;
 	}
 	tn_str = pp_tag_node(&ts->tn);
-	counters_str = pp_data_counters(&ts->counters, true);
-	parent_counters_str = pp_data_counters(ts->parent_counters, false);
 	res = kasprintf(GFP_ATOMIC,
-			"tag_stat@%p{%s, counters=%s, parent_counters=%s}",
-			ts, tn_str, counters_str, parent_counters_str);
+			"tag_stat@%p{%s, counters=tag_stat_counters@%p[%d], "
+			"parent=tag_stat@%p, gen=%llu}",
+			ts, tn_str, ts->counters, nr_cpu_ids,
+			ts->parent, ts->gen);
 	_bug_on_err_or_null(res);
 	kfree(tn_str);
-	kfree(counters_str);
-	kfree(parent_counters_str);
 	return res;
 }
 
@@ -0,0 +1,602 @@
+/*
+ * cprofile: aggregate continuous profiling samples
+ *
+ * Drains /proc/cprofile/samples (CONFIG_PERF_CPROFILE), once or every
+ * few seconds with -i, or reads a saved copy of it with -f, and prints
+ * the sampled stacks in folded form, one line per distinct stack:
+ *
+ *	comm;outermost frame;...;innermost frame count
+ *
+ * most frequent first, which is what flamegraph.pl takes as input.  With
+ * -s it prints the samples per process instead.
+ *
+ * Kernel addresses are named from /proc/kallsyms, or the file given with
+ * -k.  User addresses are shown as library+offset, looked up in
+ * /proc/<pid>/maps when reading live, and as plain addresses otherwise.
+ * A saved file is read in the byte order of the machine that wrote it;
+ * that must be the byte order of this one.
+ *
+ * Licensed under the terms of the GNU GPL License version 2.
+ */
+
+#include <errno.h>
+#include <fcntl.h>
+#include <inttypes.h>
+#include <signal.h>
+#include <stdarg.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+/* From include/linux/cprofile.h */
+#define CPROFILE_SAMPLE		1
+#define CPROFILE_COMM		2
+#define CPROFILE_LOST		3
+
+struct cprofile_header {
+	uint16_t	type;
+	uint16_t	size;
+	uint32_t	pid;
+	uint64_t	time;
+};
+
+struct cprofile_sample {
+	struct cprofile_header	h;
+	uint32_t	tgid;
+	uint16_t	nr_kernel;
+	uint16_t	nr_user;
+	uint64_t	ips[0];
+};
+
+struct cprofile_comm {
+	struct cprofile_header	h;
+	uint32_t	tgid;
+	char		comm[16];
+	uint32_t	pad;
+};
+
+struct cprofile_lost {
+	struct cprofile_header	h;
+	uint32_t	cpu;
+	uint32_t	pad;
+	uint64_t	count;
+};
+
+#define SAMPLES_PATH	"/proc/cprofile/samples"
+#define HASH_SIZE	4096
+#define READ_SIZE	65536
+#define STACK_LEN	8192
+
+static const char *prog;
+static int live = 1;
+static int only_tgid;
+static volatile sig_atomic_t stop;
+
+static unsigned long long total_samples, total_lost;
+
+static void die(const char *msg)
+{
+	fprintf(stderr, "%s: %s\n", prog, msg);
+	exit(1);
+}
+
+static void *xcalloc(size_t n, size_t size)
+{
+	void *p = calloc(n, size);
+
+	if (!p)
+		die("out of memory");
+	return p;
+}
+
+static char *xstrdup(const char *s)
+{
+	char *p = strdup(s);
+
+	if (!p)
+		die("out of memory");
+	return p;
+}
+
+static unsigned int hash_str(const char *s)
+{
+	unsigned int h = 2166136261u;
+
+	while (*s)
+		h = (h ^ (unsigned char)*s++) * 16777619u;
+	return h;
+}
+
+/* Kernel symbols, sorted by address. */
+struct ksym {
+	uint64_t addr;
+	char *name;
+};
+
+static struct ksym *ksyms;
+static size_t nr_ksyms;
+
+static int ksym_cmp(const void *a, const void *b)
+{
+	const struct ksym *x = a, *y = b;
+
+	return x->addr < y->addr ? -1 : x->addr > y->addr;
+}
+
+static void load_kallsyms(const char *path)
+{
+	char line[512], type, name[256];
+	unsigned long long addr;
+	size_t alloc = 0;
+	FILE *f;
+
+	f = fopen(path, "r");
+	if (!f)
+		return;
+	while (fgets(line, sizeof(line), f)) {
+		if (sscanf(line, "%llx %c %255s", &addr, &type, name) != 3)
+			continue;
+		if (type != 't' && type != 'T' && type != 'w' && type != 'W')
+			continue;
+		/* kallsyms shows zeros to readers without CAP_SYSLOG */
+		if (!addr)
+			continue;
+		if (nr_ksyms == alloc) {
+			alloc = alloc ? 2 * alloc : 4096;
+			ksyms = realloc(ksyms, alloc * sizeof(*ksyms));
+			if (!ksyms)
+				die("out of memory");
+		}
+		ksyms[nr_ksyms].addr = addr;
+		ksyms[nr_ksyms].name = xstrdup(name);
+		nr_ksyms++;
+	}
+	fclose(f);
+	qsort(ksyms, nr_ksyms, sizeof(*ksyms), ksym_cmp);
+}
+
+static const char *ksym_name(uint64_t addr)
+{
+	size_t lo = 0, hi = nr_ksyms;
+
+	if (!nr_ksyms || addr < ksyms[0].addr)
+		return NULL;
+	while (hi - lo > 1) {
+		size_t mid = (lo + hi) / 2;
+
+		if (ksyms[mid].addr <= addr)
+			lo = mid;
+		else
+			hi = mid;
+	}
+	return ksyms[lo].name;
+}
+
+/* Executable mappings of one process, read when it is first seen. */
+struct map {
+	uint64_t start, end, offset;
+	char *name;
+};
+
+struct proc {
+	struct proc *next;
+	uint32_t tgid;
+	struct map *maps;
+	size_t nr_maps;
+	unsigned long long samples;
+};
+
+static struct proc *procs[HASH_SIZE];
+
+static void load_maps(struct proc *p)
+{
+	unsigned long long start, end, offset;
+	char path[64], line[1024], perms[8], *name;
+	size_t alloc = 0;
+	FILE *f;
+
+	snprintf(path, sizeof(path), "/proc/%u/maps", p->tgid);
+	f = fopen(path, "r");
+	if (!f)
+		return;
+	while (fgets(line, sizeof(line), f)) {
+		int n = 0;
+
+		if (sscanf(line, "%llx-%llx %7s %llx %*s %*s %n", &start, &end,
+			   perms, &offset, &n) < 4 || !n || perms[2] != 'x')
+			continue;
+		name = line + n;
+		name[strcspn(name, "\n")] = 0;
+		if (strrchr(name, '/'))
+			name = strrchr(name, '/') + 1;
+		if (!*name)
+			name = "[anon]";
+		if (p->nr_maps == alloc) {
+			alloc = alloc ? 2 * alloc : 32;
+			p->maps = realloc(p->maps, alloc * sizeof(*p->maps));
+			if (!p->maps)
+				die("out of memory");
+		}
+		p->maps[p->nr_maps].start = start;
+		p->maps[p->nr_maps].end = end;
+		p->maps[p->nr_maps].offset = offset;
+		p->maps[p->nr_maps].name = xstrdup(name);
+		p->nr_maps++;
+	}
+	fclose(f);
+}
+
+static struct proc *find_proc(uint32_t tgid)
+{
+	struct proc **pp = &procs[tgid % HASH_SIZE], *p;
+
+	for (p = *pp; p; p = p->next)
+		if (p->tgid == tgid)
+			return p;
+	p = xcalloc(1, sizeof(*p));
+	p->tgid = tgid;
+	p->next = *pp;
+	*pp = p;
+	if (live)
+		load_maps(p);
+	return p;
+}
+
+/* Thread names, from CPROFILE_COMM records. */
+struct thread {
+	struct thread *next;
+	uint32_t pid, tgid;
+	char comm[17];
+};
+
+static struct thread *threads[HASH_SIZE];
+
+static struct thread *find_thread(uint32_t pid, int create)
+{
+	struct thread **tp = &threads[pid % HASH_SIZE], *t;
+
+	for (t = *tp; t; t = t->next)
+		if (t->pid == pid)
+			return t;
+	if (!create)
+		return NULL;
+	t = xcalloc(1, sizeof(*t));
+	t->pid = pid;
+	t->next = *tp;
+	*tp = t;
+	return t;
+}
+
+/* Distinct folded stacks and their counts. */
+struct stack {
+	struct stack *next;
+	char *text;
+	unsigned long long count;
+};
+
+static struct stack *stacks[HASH_SIZE];
+static size_t nr_stacks;
+
+static void add_stack(const char *text)
+{
+	struct stack **sp = &stacks[hash_str(text) % HASH_SIZE], *s;
+
+	for (s = *sp; s; s = s->next) {
+		if (!strcmp(s->text, text)) {
+			s->count++;
+			return;
+		}
+	}
+	s = xcalloc(1, sizeof(*s));
+	s->text = xstrdup(text);
+	s->count = 1;
+	s->next = *sp;
+	*sp = s;
+	nr_stacks++;
+}
+
+static size_t append(char *buf, size_t len, const char *fmt, ...)
+	__attribute__((format(printf, 3, 4)));
+
+static size_t append(char *buf, size_t len, const char *fmt, ...)
+{
+	va_list ap;
+	int n;
+
+	if (len >= STACK_LEN)
+		return len;
+	va_start(ap, fmt);
+	n = vsnprintf(buf + len, STACK_LEN - len, fmt, ap);
+	va_end(ap);
+	return n < 0 ? len : len + n;
+}
+
+static size_t append_user(char *buf, size_t len, struct proc *p,
+			  uint64_t ip)
+{
+	size_t i;
+
+	for (i = 0; i < p->nr_maps; i++) {
+		struct map *m = &p->maps[i];
+
+		if (ip >= m->start && ip < m->end)
+			return append(buf, len, ";%s+0x%" PRIx64, m->name,
+				      ip - m->start + m->offset);
+	}
+	return append(buf, len, ";0x%" PRIx64, ip);
+}
+
+static void add_sample(const struct cprofile_sample *s)
+{
+	static char buf[STACK_LEN];
+	struct thread *t = find_thread(s->h.pid, 0);
+	struct proc *p;
+	size_t len;
+	int i;
+
+	if (only_tgid && s->tgid != (uint32_t)only_tgid)
+		return;
+	total_samples++;
+	p = find_proc(s->tgid);
+	p->samples++;
+
+	if (t)
+		len = append(buf, 0, "%s", t->comm);
+	else
+		len = append(buf, 0, "%u", s->h.pid);
+
+	/* the chain is innermost first; folded stacks start at the root */
+	for (i = s->nr_kernel + s->nr_user - 1; i >= s->nr_kernel; i--)
+		len = append_user(buf, len, p, s->ips[i]);
+	for (i = s->nr_kernel - 1; i >= 0; i--) {
+		const char *name = ksym_name(s->ips[i]);
+
+		if (name)
+			len = append(buf, len, ";%s", name);
+		else
+			len = append(buf, len, ";0x%" PRIx64, s->ips[i]);
+	}
+	add_stack(buf);
+}
+
+/* Parse whole records at the start of buf; return the bytes used. */
+static size_t parse(const unsigned char *buf, size_t len)
+{
+	const struct cprofile_header *h;
+	size_t pos = 0;
+
+	while (len - pos >= sizeof(*h)) {
+		h = (const void *)(buf + pos);
+		if (h->size < sizeof(*h))
+			die("corrupt record");
+		if (h->size > len - pos)
+			break;
+
+		switch (h->type) {
+		case CPROFILE_SAMPLE: {
+			const struct cprofile_sample *s = (const void *)h;
+
+			if (h->size < sizeof(*s) || h->size != sizeof(*s) +
+			    (s->nr_kernel + s->nr_user) * sizeof(uint64_t))
+				die("corrupt sample");
+			add_sample(s);
+			break;
+		}
+		case CPROFILE_COMM: {
+			const struct cprofile_comm *c = (const void *)h;
+			struct thread *t;
+
+			if (h->size < sizeof(*c))
+				die("corrupt comm record");
+			t = find_thread(h->pid, 1);
+			t->tgid = c->tgid;
+			memcpy(t->comm, c->comm, sizeof(c->comm));
+			/* separators of the folded format */
+			t->comm[strcspn(t->comm, "; ")] = 0;
+			break;
+		}
+		case CPROFILE_LOST: {
+			const struct cprofile_lost *l = (const void *)h;
+
+			if (h->size < sizeof(*l))
+				die("corrupt lost record");
+			total_lost += l->count;
+			break;
+		}
+		default:
+			break;
+		}
+		pos += h->size;
+	}
+	return pos;
+}
+
+static void read_samples(const char *path)
+{
+	static unsigned char buf[2 * READ_SIZE];
+	size_t have = 0, used;
+	ssize_t n;
+	int fd;
+
+	fd = open(path, O_RDONLY);
+	if (fd < 0)
+		die(strerror(errno));
+
+	for (;;) {
+		n = read(fd, buf + have, READ_SIZE);
+		if (n < 0) {
+			if (errno == EINTR)
+				continue;
+			die(strerror(errno));
+		}
+		if (!n)
+			break;
+		have += n;
+		used = parse(buf, have);
+		have -= used;
+		memmove(buf, buf + used, have);
+		if (have > READ_SIZE)
+			die("corrupt record");
+	}
+	if (have)
+		fprintf(stderr, "%s: %zu bytes of truncated record ignored\n",
+			prog, have);
+	close(fd);
+}
+
+static int stack_cmp(const void *a, const void *b)
+{
+	const struct stack *x = *(struct stack * const *)a;
+	const struct stack *y = *(struct stack * const *)b;
+
+	if (x->count != y->count)
+		return x->count < y->count ? 1 : -1;
+	return strcmp(x->text, y->text);
+}
+
+static void print_stacks(size_t top)
+{
+	struct stack **all, *s;
+	size_t i, n = 0;
+
+	all = xcalloc(nr_stacks + 1, sizeof(*all));
+	for (i = 0; i < HASH_SIZE; i++)
+		for (s = stacks[i]; s; s = s->next)
+			all[n++] = s;
+	qsort(all, n, sizeof(*all), stack_cmp);
+	if (top && top < n)
+		n = top;
+	for (i = 0; i < n; i++)
+		printf("%s %llu\n", all[i]->text, all[i]->count);
+	free(all);
+}
+
+static int proc_cmp(const void *a, const void *b)
+{
+	const struct proc *x = *(struct proc * const *)a;
+	const struct proc *y = *(struct proc * const *)b;
+
+	if (x->samples != y->samples)
+		return x->samples < y->samples ? 1 : -1;
+	return x->tgid < y->tgid ? -1 : x->tgid > y->tgid;
+}
+
+static void print_procs(size_t top)
+{
+	struct proc **all, *p;
+	struct thread *t;
+	size_t i, n = 0, alloc = 64;
+
+	all = xcalloc(alloc, sizeof(*all));
+	for (i = 0; i < HASH_SIZE; i++) {
+		for (p = procs[i]; p; p = p->next) {
+			if (n == alloc) {
+				alloc *= 2;
+				all = realloc(all, alloc * sizeof(*all));
+				if (!all)
+					die("out of memory");
+			}
+			all[n++] = p;
+		}
+	}
+	qsort(all, n, sizeof(*all), proc_cmp);
+	if (top && top < n)
+		n = top;
+
+	printf("%10s %6s %7s  %s\n", "SAMPLES", "%", "PID", "COMMAND");
+	for (i = 0; i < n; i++) {
+		p = all[i];
+		t = find_thread(p->tgid, 0);
+		printf("%10llu %6.2f %7u  %s\n", p->samples,
+		       100.0 * p->samples / (total_samples ? total_samples : 1),
+		       p->tgid, t ? t->comm : "?");
+	}
+	free(all);
+}
+
+static void on_signal(int sig)
+{
+	(void)sig;
+	stop = 1;
+}
+
+static void usage(void)
+{
+	fprintf(stderr,
+		"usage: %s [-s] [-t top] [-p pid] [-i secs [-n count]] "
+		"[-k kallsyms] [-f file]\n"
+		"  -f file      read saved samples instead of "
+		SAMPLES_PATH "\n"
+		"  -i secs      keep reading every secs seconds until "
+		"interrupted\n"
+		"  -k kallsyms  kernel symbols (default /proc/kallsyms)\n"
+		"  -n count     stop after count reads with -i\n"
+		"  -p pid       only count samples of process pid\n"
+		"  -s           print samples per process, not stacks\n"
+		"  -t top       print only the top entries\n", prog);
+	exit(2);
+}
+
+int main(int argc, char **argv)
+{
+	const char *path = SAMPLES_PATH, *kallsyms = "/proc/kallsyms";
+	unsigned int interval = 0, rounds = 0, round;
+	size_t top = 0;
+	int summary = 0;
+	int opt;
+
+	prog = argv[0];
+	while ((opt = getopt(argc, argv, "f:i:k:n:p:st:h")) != -1) {
+		switch (opt) {
+		case 'f':
+			path = optarg;
+			live = 0;
+			break;
+		case 'i':
+			interval = strtoul(optarg, NULL, 0);
+			break;
+		case 'k':
+			kallsyms = optarg;
+			break;
+		case 'n':
+			rounds = strtoul(optarg, NULL, 0);
+			break;
+		case 'p':
+			only_tgid = strtol(optarg, NULL, 0);
+			break;
+		case 's':
+			summary = 1;
+			break;
+		case 't':
+			top = strtoul(optarg, NULL, 0);
+			break;
+		default:
+			usage();
+		}
+	}
+	if (optind != argc || (interval && !live))
+		usage();
+
+	load_kallsyms(kallsyms);
+	signal(SIGINT, on_signal);
+	signal(SIGTERM, on_signal);
+
+	for (round = 1; ; round++) {
+		read_samples(path);
+		if (!interval || stop || (rounds && round >= rounds))
+			break;
+		sleep(interval);
+		if (stop)
+			break;
+	}
+
+	if (summary)
+		print_procs(top);
+	else
+		print_stacks(top);
+	fprintf(stderr, "%s: %llu samples, %zu stacks, %llu lost\n", prog,
+		total_samples, nr_stacks, total_lost);
+	return 0;
+}
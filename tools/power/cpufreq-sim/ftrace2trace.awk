@@ -0,0 +1,28 @@
+#!/usr/bin/awk -f
+#
+# Convert the cpu_idle events of an ftrace capture into a cpufreq-sim
+# trace.  Capture with:
+#
+#   echo 1 > /sys/kernel/debug/tracing/events/power/cpu_idle/enable
+#   cat /sys/kernel/debug/tracing/trace_pipe > idle.txt
+#
+# then run: awk -f ftrace2trace.awk idle.txt > idle.trace
+#
+# Idle exit is logged with state=4294967295 (PWR_EVENT_EXIT); any other
+# state is an idle entry.  Times are rebased to start at zero.
+
+/ cpu_idle: / {
+	for (i = 1; i <= NF; i++) {
+		if ($i ~ /^[0-9]+\.[0-9]+:$/)
+			ts = substr($i, 1, length($i) - 1)
+		else if ($i ~ /^state=/)
+			state = substr($i, 7)
+		else if ($i ~ /^cpu_id=/)
+			cpu = substr($i, 8)
+	}
+	us = int(ts * 1000000 + 0.5)
+	if (start == "")
+		start = us
+	printf "%d %d %s\n", us - start, cpu,
+		state == "4294967295" ? "busy" : "idle"
+}
@@ -0,0 +1,122 @@
+/*
+ * The parts of <linux/cpufreq.h> used by governors, backed by the
+ * simulator's mock cpufreq core and driver.
+ *
+ * Licensed under the terms of the GNU GPL License version 2.
+ */
+
+#ifndef SIM_LINUX_CPUFREQ_H
+#define SIM_LINUX_CPUFREQ_H
+
+#include <sim/kernel.h>
+
+#define CPUFREQ_NAME_LEN		16
+#define CPUFREQ_ETERNAL			(-1)
+
+#define CPUFREQ_TRANSITION_NOTIFIER	(0)
+#define CPUFREQ_POLICY_NOTIFIER		(1)
+
+#define CPUFREQ_PRECHANGE		(0)
+#define CPUFREQ_POSTCHANGE		(1)
+
+#define CPUFREQ_GOV_START		1
+#define CPUFREQ_GOV_STOP		2
+#define CPUFREQ_GOV_LIMITS		3
+
+#define CPUFREQ_RELATION_L		0
+#define CPUFREQ_RELATION_H		1
+
+#define CPUFREQ_SHARED_TYPE_NONE	(0)
+#define CPUFREQ_SHARED_TYPE_HW		(1)
+#define CPUFREQ_SHARED_TYPE_ALL		(2)
+#define CPUFREQ_SHARED_TYPE_ANY		(3)
+
+#define CPUFREQ_ENTRY_INVALID		~0
+#define CPUFREQ_TABLE_END		~1
+
+struct cpufreq_governor;
+
+extern struct kobject *cpufreq_global_kobject;
+
+struct cpufreq_cpuinfo {
+	unsigned int		max_freq;
+	unsigned int		min_freq;
+	unsigned int		transition_latency;
+};
+
+struct cpufreq_policy {
+	cpumask_var_t		cpus;
+	cpumask_var_t		related_cpus;
+	unsigned int		shared_type;
+	unsigned int		cpu;
+	struct cpufreq_cpuinfo	cpuinfo;
+	unsigned int		min;
+	unsigned int		max;
+	unsigned int		cur;
+	unsigned int		policy;
+	struct cpufreq_governor	*governor;
+	struct kobject		kobj;
+};
+
+struct cpufreq_freqs {
+	unsigned int cpu;
+	unsigned int old;
+	unsigned int new;
+	u8 flags;
+};
+
+struct cpufreq_governor {
+	char	name[CPUFREQ_NAME_LEN];
+	int	(*governor)(struct cpufreq_policy *policy, unsigned int event);
+	ssize_t	(*show_setspeed)(struct cpufreq_policy *policy, char *buf);
+	int	(*store_setspeed)(struct cpufreq_policy *policy,
+				  unsigned int freq);
+	unsigned int max_transition_latency;
+	void	*owner;
+	struct cpufreq_governor *next;
+};
+
+struct cpufreq_frequency_table {
+	unsigned int	index;
+	unsigned int	frequency;
+};
+
+struct global_attr {
+	struct attribute attr;
+	ssize_t (*show)(struct kobject *kobj,
+			struct attribute *attr, char *buf);
+	ssize_t (*store)(struct kobject *a, struct attribute *b,
+			 const char *c, size_t count);
+};
+
+#define define_one_global_ro(_name)		\
+static struct global_attr _name =		\
+__ATTR(_name, 0444, show_##_name, NULL)
+
+#define define_one_global_rw(_name)		\
+static struct global_attr _name =		\
+__ATTR(_name, 0644, show_##_name, store_##_name)
+
+int cpufreq_register_governor(struct cpufreq_governor *governor);
+void cpufreq_unregister_governor(struct cpufreq_governor *governor);
+int cpufreq_register_notifier(struct notifier_block *nb, unsigned int list);
+int cpufreq_unregister_notifier(struct notifier_block *nb, unsigned int list);
+
+int __cpufreq_driver_target(struct cpufreq_policy *policy,
+			    unsigned int target_freq, unsigned int relation);
+#define cpufreq_driver_target(p, f, r)	__cpufreq_driver_target(p, f, r)
+int __cpufreq_driver_getavg(struct cpufreq_policy *policy, unsigned int cpu);
+
+struct cpufreq_policy *cpufreq_cpu_get(unsigned int cpu);
+#define cpufreq_cpu_put(p)	do { (void)(p); } while (0)
+unsigned int cpufreq_get(unsigned int cpu);
+#define cpufreq_quick_get(cpu)	cpufreq_get(cpu)
+
+struct cpufreq_frequency_table *cpufreq_frequency_get_table(unsigned int cpu);
+int cpufreq_frequency_table_target(struct cpufreq_policy *policy,
+				   struct cpufreq_frequency_table *table,
+				   unsigned int target_freq,
+				   unsigned int relation,
+				   unsigned int *index);
+
+#endif /* SIM_LINUX_CPUFREQ_H */
@@ -0,0 +1,475 @@
+/*
+ * Userspace stand-ins for the kernel interfaces used by cpufreq governors,
+ * so that drivers/cpufreq/cpufreq_*.c build unmodified against the
+ * simulator.  Every <linux/...> and <asm/...> header a governor includes
+ * resolves to a stub that includes this file.
+ *
+ * Licensed under the terms of the GNU GPL License version 2.
+ */
+
+#ifndef SIM_KERNEL_H
+#define SIM_KERNEL_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <limits.h>
+#include <errno.h>
+#include <assert.h>
+
+/* types */
+
+typedef uint8_t u8;
+typedef uint16_t u16;
+typedef uint32_t u32;
+typedef uint64_t u64;
+typedef int8_t s8;
+typedef int16_t s16;
+typedef int32_t s32;
+typedef int64_t s64;
+typedef u64 cputime64_t;
+typedef long long ktime_t;		/* nanoseconds */
+
+#define __init
+#define __exit
+#define __user
+#define __percpu
+#define __read_mostly
+#define __cpuinit
+#define __devinit
+#define __force
+
+#define likely(x)	__builtin_expect(!!(x), 1)
+#define unlikely(x)	__builtin_expect(!!(x), 0)
+#define uninitialized_var(x)	x = x
+#define ACCESS_ONCE(x)	(*(volatile __typeof__(x) *)&(x))
+
+#define ARRAY_SIZE(a)	(sizeof(a) / sizeof((a)[0]))
+#define container_of(ptr, type, member) \
+	((type *)((char *)(ptr) - offsetof(type, member)))
+
+#define min(x, y)	({ __typeof__(x) _x = (x); __typeof__(y) _y = (y); \
+			   _x < _y ? _x : _y; })
+#define max(x, y)	({ __typeof__(x) _x = (x); __typeof__(y) _y = (y); \
+			   _x > _y ? _x : _y; })
+#define min_t(t, x, y)	({ t _x = (x); t _y = (y); _x < _y ? _x : _y; })
+#define max_t(t, x, y)	({ t _x = (x); t _y = (y); _x > _y ? _x : _y; })
+#define clamp(v, lo, hi)	min(max(v, lo), hi)
+#define clamp_t(t, v, lo, hi)	min_t(t, max_t(t, v, lo), hi)
+#define DIV_ROUND_UP(n, d)	(((n) + (d) - 1) / (d))
+
+#define BUG_ON(c)	assert(!(c))
+#define WARN_ON(c)	({ int _c = !!(c); if (_c) fprintf(stderr, \
+			   "WARN_ON %s:%d\n", __FILE__, __LINE__); _c; })
+
+static inline s64 div64_s64(s64 a, s64 b) { return a / b; }
+static inline u64 div64_u64(u64 a, u64 b) { return a / b; }
+static inline u64 div_u64(u64 a, u32 b) { return a / b; }
+#define do_div(n, base)	({ u32 _rem = (n) % (base); (n) /= (base); _rem; })
+
+/* printk */
+
+#define KERN_EMERG	""
+#define KERN_ALERT	""
+#define KERN_CRIT	""
+#define KERN_ERR	""
+#define KERN_WARNING	""
+#define KERN_NOTICE	""
+#define KERN_INFO	""
+#define KERN_DEBUG	""
+extern int sim_verbose;
+#define printk(fmt, ...) \
+	({ if (sim_verbose) fprintf(stderr, fmt, ##__VA_ARGS__); 0; })
+#define pr_err(fmt, ...)	printk(fmt, ##__VA_ARGS__)
+#define pr_warning(fmt, ...)	printk(fmt, ##__VA_ARGS__)
+#define pr_warn(fmt, ...)	printk(fmt, ##__VA_ARGS__)
+#define pr_info(fmt, ...)	printk(fmt, ##__VA_ARGS__)
+#define pr_debug(fmt, ...)	printk(fmt, ##__VA_ARGS__)
+#define pr_warn_once(fmt, ...)	printk(fmt, ##__VA_ARGS__)
+
+static inline int strict_strtoul(const char *cp, unsigned int base,
+				 unsigned long *res)
+{
+	char *end;
+
+	errno = 0;
+	*res = strtoul(cp, &end, base);
+	if (errno || end == cp || (*end && *end != '\n'))
+		return -EINVAL;
+	return 0;
+}
+
+static inline int strict_strtol(const char *cp, unsigned int base, long *res)
+{
+	char *end;
+
+	errno = 0;
+	*res = strtol(cp, &end, base);
+	if (errno || end == cp || (*end && *end != '\n'))
+		return -EINVAL;
+	return 0;
+}
+
+/* modules and initcalls: governors register through a linker section */
+
+typedef int (*initcall_t)(void);
+#define THIS_MODULE		NULL
+#define EXPORT_SYMBOL(s)
+#define EXPORT_SYMBOL_GPL(s)
+#define MODULE_AUTHOR(s)
+#define MODULE_DESCRIPTION(s)
+#define MODULE_LICENSE(s)
+#define MODULE_PARM_DESC(p, s)
+#define module_param(n, t, p)
+#define module_exit(fn)
+#define module_init(fn) \
+	static initcall_t __sim_initcall_##fn \
+	__attribute__((used, section("sim_initcall"))) = fn
+#define fs_initcall(fn)		module_init(fn)
+#define late_initcall(fn)	module_init(fn)
+
+/* memory barriers and atomics: the simulator runs one context at a time */
+
+#define smp_mb()	__sync_synchronize()
+#define smp_rmb()	__sync_synchronize()
+#define smp_wmb()	__sync_synchronize()
+#define barrier()	__asm__ __volatile__("" ::: "memory")
+
+typedef struct { int counter; } atomic_t;
+#define ATOMIC_INIT(i)		{ (i) }
+#define atomic_read(v)		((v)->counter)
+#define atomic_set(v, i)	((v)->counter = (i))
+#define atomic_inc(v)		((v)->counter++)
+#define atomic_dec(v)		((v)->counter--)
+#define atomic_inc_return(v)	(++(v)->counter)
+#define atomic_dec_return(v)	(--(v)->counter)
+
+struct mutex { int locked; };
+#define DEFINE_MUTEX(m)		struct mutex m = { 0 }
+#define mutex_init(m)		((m)->locked = 0)
+#define mutex_destroy(m)	do { } while (0)
+#define mutex_lock(m)		((m)->locked++)
+#define mutex_unlock(m)		((m)->locked--)
+#define mutex_trylock(m)	((m)->locked ? 0 : ++(m)->locked)
+
+typedef struct { int locked; } spinlock_t;
+#define DEFINE_SPINLOCK(l)	spinlock_t l = { 0 }
+#define spin_lock_init(l)	((l)->locked = 0)
+#define spin_lock(l)		((l)->locked++)
+#define spin_unlock(l)		((l)->locked--)
+#define spin_lock_irqsave(l, f)	((f) = 0, (l)->locked++)
+#define spin_unlock_irqrestore(l, f)	((void)(f), (l)->locked--)
+#define spin_lock_irq(l)	spin_lock(l)
+#define spin_unlock_irq(l)	spin_unlock(l)
+#define local_irq_save(f)	((f) = 0)
+#define local_irq_restore(f)	((void)(f))
+
+/* cpus and cpumasks */
+
+#ifndef NR_CPUS
+#define NR_CPUS		8
+#endif
+
+extern int sim_nr_cpus;
+extern int sim_current_cpu;
+
+struct cpumask { unsigned long bits; };
+typedef struct cpumask cpumask_t;
+typedef struct cpumask cpumask_var_t[1];
+
+#define cpumask_set_cpu(cpu, m)		((m)->bits |= 1UL << (cpu))
+#define cpumask_clear_cpu(cpu, m)	((m)->bits &= ~(1UL << (cpu)))
+#define cpumask_test_cpu(cpu, m)	(!!((m)->bits & (1UL << (cpu))))
+#define cpumask_clear(m)		((m)->bits = 0)
+#define cpumask_empty(m)		(!(m)->bits)
+#define cpumask_weight(m)		__builtin_popcountl((m)->bits)
+#define cpumask_copy(d, s)		((d)->bits = (s)->bits)
+#define cpumask_first(m)		((m)->bits ? __builtin_ctzl((m)->bits) \
+						   : NR_CPUS)
+static inline int cpumask_test_and_clear_cpu(int cpu, struct cpumask *m)
+{
+	int ret = cpumask_test_cpu(cpu, m);
+
+	cpumask_clear_cpu(cpu, m);
+	return ret;
+}
+
+#define for_each_cpu(cpu, m) \
+	for ((cpu) = 0; (cpu) < NR_CPUS; (cpu)++) \
+		if (cpumask_test_cpu(cpu, m))
+/* governors initialise before -n is parsed, so every cpu is possible */
+#define for_each_possible_cpu(cpu) \
+	for ((cpu) = 0; (cpu) < NR_CPUS; (cpu)++)
+#define for_each_online_cpu(cpu) \
+	for ((cpu) = 0; (cpu) < sim_nr_cpus; (cpu)++)
+#define for_each_present_cpu(cpu)	for_each_online_cpu(cpu)
+
+#define cpu_online(cpu)		((cpu) < sim_nr_cpus)
+#define num_online_cpus()	sim_nr_cpus
+#define num_possible_cpus()	NR_CPUS
+#define smp_processor_id()	sim_current_cpu
+#define raw_smp_processor_id()	sim_current_cpu
+#define get_cpu()		sim_current_cpu
+#define put_cpu()		do { } while (0)
+#define preempt_disable()	do { } while (0)
+#define preempt_enable()	do { } while (0)
+#define get_online_cpus()	do { } while (0)
+#define put_online_cpus()	do { } while (0)
+
+#define DEFINE_PER_CPU(type, name)	__typeof__(type) name[NR_CPUS]
+#define per_cpu(name, cpu)		((name)[cpu])
+#define __get_cpu_var(name)		((name)[sim_current_cpu])
+#define alloc_percpu(type)		((type *)calloc(NR_CPUS, sizeof(type)))
+#define per_cpu_ptr(p, cpu)		(&(p)[cpu])
+#define free_percpu(p)			free(p)
+
+/* time: the simulator drives a virtual clock */
+
+#ifndef HZ
+#define HZ		100
+#endif
+#define USEC_PER_SEC	1000000L
+#define NSEC_PER_USEC	1000L
+#define NSEC_PER_MSEC	1000000L
+#define NSEC_PER_SEC	1000000000L
+
+extern volatile unsigned long jiffies;
+extern u64 sim_now_us;
+
+#define time_after(a, b)	((long)((b) - (a)) < 0)
+#define time_before(a, b)	time_after(b, a)
+#define time_after_eq(a, b)	((long)((a) - (b)) >= 0)
+#define time_before_eq(a, b)	time_after_eq(b, a)
+
+static inline u64 get_jiffies_64(void) { return jiffies; }
+static inline unsigned long usecs_to_jiffies(unsigned long us)
+{
+	return DIV_ROUND_UP(us, USEC_PER_SEC / HZ);
+}
+static inline unsigned long msecs_to_jiffies(unsigned long ms)
+{
+	return usecs_to_jiffies(ms * 1000);
+}
+static inline unsigned int jiffies_to_usecs(unsigned long j)
+{
+	return j * (USEC_PER_SEC / HZ);
+}
+static inline unsigned int jiffies_to_msecs(unsigned long j)
+{
+	return j * (1000 / HZ);
+}
+
+#define cputime64_add(a, b)		((a) + (b))
+#define cputime64_sub(a, b)		((a) - (b))
+#define cputime64_to_jiffies64(c)	(c)
+#define jiffies64_to_cputime64(j)	(j)
+#define cputime_to_usecs(c)		jiffies_to_usecs(c)
+
+static inline ktime_t ktime_get(void) { return sim_now_us * NSEC_PER_USEC; }
+#define ktime_to_us(kt)		((kt) / NSEC_PER_USEC)
+#define ktime_to_ns(kt)		(kt)
+#define ktime_sub(a, b)		((a) - (b))
+static inline s64 ktime_us_delta(ktime_t a, ktime_t b)
+{
+	return (a - b) / NSEC_PER_USEC;
+}
+
+u64 get_cpu_idle_time_us(int cpu, u64 *last_update_time);
+u64 get_cpu_iowait_time_us(int cpu, u64 *last_update_time);
+
+/* /proc/stat style counters are never consulted: idle time is exact */
+struct cpu_usage_stat {
+	cputime64_t user, nice, system, softirq, irq, idle, iowait, steal,
+		    guest, guest_nice;
+};
+struct kernel_stat { struct cpu_usage_stat cpustat; };
+extern struct kernel_stat sim_kstat[NR_CPUS];
+#define kstat_cpu(cpu)		(sim_kstat[cpu])
+
+unsigned long nr_running(void);
+unsigned long nr_iowait(void);
+
+/* timers */
+
+struct timer_list {
+	unsigned long expires;
+	void (*function)(unsigned long);
+	unsigned long data;
+	int cpu;
+	int deferrable;
+	int pending;
+	struct timer_list *next;
+};
+
+void init_timer(struct timer_list *timer);
+void init_timer_deferrable(struct timer_list *timer);
+#define setup_timer(t, fn, d) \
+	do { init_timer(t); (t)->function = (fn); (t)->data = (d); } while (0)
+void add_timer(struct timer_list *timer);
+void add_timer_on(struct timer_list *timer, int cpu);
+int mod_timer(struct timer_list *timer, unsigned long expires);
+#define mod_timer_pinned(t, e)	mod_timer(t, e)
+int del_timer(struct timer_list *timer);
+#define del_timer_sync(t)	del_timer(t)
+#define timer_pending(t)	((t)->pending)
+
+/* workqueues: work runs as soon as the current event has been handled */
+
+struct work_struct;
+typedef void (*work_func_t)(struct work_struct *work);
+
+struct work_struct {
+	work_func_t func;
+	int pending;
+	int cpu;
+	struct work_struct *next;
+};
+
+struct delayed_work {
+	struct work_struct work;
+	struct timer_list timer;
+};
+
+struct workqueue_struct { const char *name; };
+
+#define WQ_NON_REENTRANT	(1 << 0)
+#define WQ_UNBOUND		(1 << 1)
+#define WQ_FREEZABLE		(1 << 2)
+#define WQ_HIGHPRI		(1 << 4)
+
+#define INIT_WORK(w, f) \
+	do { (w)->func = (f); (w)->pending = 0; (w)->next = NULL; } while (0)
+void __init_delayed_work(struct delayed_work *dw, work_func_t f, int defer);
+#define INIT_DELAYED_WORK(dw, f)		__init_delayed_work(dw, f, 0)
+#define INIT_DELAYED_WORK_DEFERRABLE(dw, f)	__init_delayed_work(dw, f, 1)
+#define to_delayed_work(w)	container_of(w, struct delayed_work, work)
+
+struct workqueue_struct *alloc_workqueue(const char *name, unsigned int flags,
+					 int max_active);
+#define create_workqueue(name)		alloc_workqueue(name, 0, 1)
+#define create_singlethread_workqueue(name)	alloc_workqueue(name, 0, 1)
+#define create_rt_workqueue(name)	alloc_workqueue(name, 0, 1)
+void destroy_workqueue(struct workqueue_struct *wq);
+int queue_work(struct workqueue_struct *wq, struct work_struct *work);
+#define queue_work_on(cpu, wq, w)	queue_work(wq, w)
+#define schedule_work(w)		queue_work(NULL, w)
+#define schedule_work_on(cpu, w)	queue_work(NULL, w)
+int queue_delayed_work_on(int cpu, struct workqueue_struct *wq,
+			  struct delayed_work *dw, unsigned long delay);
+#define queue_delayed_work(wq, dw, d) \
+	queue_delayed_work_on(sim_current_cpu, wq, dw, d)
+#define schedule_delayed_work(dw, d) \
+	queue_delayed_work_on(sim_current_cpu, NULL, dw, d)
+#define schedule_delayed_work_on(cpu, dw, d) \
+	queue_delayed_work_on(cpu, NULL, dw, d)
+int cancel_delayed_work_sync(struct delayed_work *dw);
+#define cancel_delayed_work(dw)	cancel_delayed_work_sync(dw)
+int cancel_work_sync(struct work_struct *work);
+#define flush_work(w)		do { (void)(w); } while (0)
+#define flush_workqueue(wq)	do { (void)(wq); } while (0)
+#define work_pending(w)		((w)->pending)
+
+/* kernel threads: each runs in its own pthread, one context at a time */
+
+#define TASK_RUNNING		0
+#define TASK_INTERRUPTIBLE	1
+#define TASK_UNINTERRUPTIBLE	2
+
+#define MAX_RT_PRIO		100
+#ifndef SCHED_FIFO
+#define SCHED_FIFO		1
+#define SCHED_RR		2
+#endif
+#define SCHED_NORMAL		0
+
+/* sim.c also sees the libc one through <pthread.h> */
+#define sched_param		sim_sched_param
+struct sched_param { int sched_priority; };
+
+struct task_struct {
+	const char *comm;
+	int state;
+	int started;
+	int should_stop;
+	int running;
+	int (*threadfn)(void *data);
+	void *data;
+	void *thread;
+};
+
+extern __thread struct task_struct *sim_current_task;
+#define current			sim_current_task
+
+struct task_struct *kthread_create(int (*threadfn)(void *data), void *data,
+				   const char *namefmt, ...);
+int wake_up_process(struct task_struct *tsk);
+int kthread_stop(struct task_struct *tsk);
+int kthread_should_stop(void);
+void kthread_bind(struct task_struct *tsk, unsigned int cpu);
+void schedule(void);
+#define set_current_state(s)	(current->state = (s))
+#define __set_current_state(s)	(current->state = (s))
+#define get_task_struct(t)	do { (void)(t); } while (0)
+#define put_task_struct(t)	do { (void)(t); } while (0)
+static inline int sched_setscheduler_nocheck(struct task_struct *p,
+		int policy, const struct sched_param *param)
+{
+	return 0;
+}
+#define sched_setscheduler(t, p, s)	sched_setscheduler_nocheck(t, p, s)
+#define set_user_nice(t, n)			do { (void)(t); } while (0)
+#define IS_ERR(p)		((unsigned long)(p) >= (unsigned long)-4095)
+#define PTR_ERR(p)		((long)(p))
+#define ERR_PTR(e)		((void *)(long)(e))
+
+/* notifiers */
+
+struct notifier_block {
+	int (*notifier_call)(struct notifier_block *nb, unsigned long val,
+			     void *data);
+	struct notifier_block *next;
+	int priority;
+};
+#define NOTIFY_DONE	0
+#define NOTIFY_OK	1
+
+#define IDLE_START	1
+#define IDLE_END	2
+void idle_notifier_register(struct notifier_block *n);
+void idle_notifier_unregister(struct notifier_block *n);
+
+struct early_suspend {
+	int level;
+	void (*suspend)(struct early_suspend *h);
+	void (*resume)(struct early_suspend *h);
+};
+#define EARLY_SUSPEND_LEVEL_DISABLE_FB	100
+#define register_early_suspend(h)	do { (void)(h); } while (0)
+#define unregister_early_suspend(h)	do { (void)(h); } while (0)
+
+/* sysfs: attribute groups are kept so tunables can be set by name */
+
+struct attribute {
+	const char *name;
+	unsigned short mode;
+};
+
+struct attribute_group {
+	const char *name;
+	struct attribute **attrs;
+};
+
+struct kobject { const char *name; };
+
+#define __ATTR(_name, _mode, _show, _store) { \
+	.attr = { .name = #_name, .mode = _mode }, \
+	.show = _show, .store = _store }
+#define __ATTR_RO(_name)	__ATTR(_name, 0444, _name##_show, NULL)
+
+int sysfs_create_group(struct kobject *kobj, const struct attribute_group *grp);
+void sysfs_remove_group(struct kobject *kobj, const struct attribute_group *grp);
+
+#endif /* SIM_KERNEL_H */
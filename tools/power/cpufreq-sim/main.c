@@ -0,0 +1,506 @@
+/*
+ * cpufreq-sim: replay a per-cpu idle/busy trace through an unmodified
+ * cpufreq governor and report frequency residency, ramp latency to the
+ * maximum speed and an energy estimate.
+ *
+ * Trace lines are "<time_us> <cpu> busy|idle|iowait", in time order.
+ * Power table lines are "<freq_khz> <busy_mW> <idle_mW>"; the frequencies
+ * listed also make up the mock driver's frequency table.  '#' starts a
+ * comment in both files.
+ *
+ * Licensed under the terms of the GNU GPL License version 2.
+ */
+
+#include <ctype.h>
+#include <getopt.h>
+#include <stdarg.h>
+
+#include "sim.h"
+
+#define MAX_FREQS	32
+
+struct power_entry {
+	unsigned int freq;
+	double busy_mw;
+	double idle_mw;
+};
+
+static struct power_entry power[MAX_FREQS];
+static struct cpufreq_frequency_table freq_table[MAX_FREQS + 1];
+static int nr_freqs;
+
+static struct cpufreq_policy policies[NR_CPUS];
+static int nr_policies;
+
+/* statistics, per cpu */
+static struct {
+	u64 residency_us[MAX_FREQS];
+	u64 busy_us;
+	u64 busy_khz_us;		/* busy time weighted by speed */
+	double energy_uj;
+
+	u64 burst_start;		/* start of the current busy burst */
+	u64 ramp_us;			/* time to max in the current burst */
+	int in_burst;
+	int reached_max;
+
+	unsigned long bursts;
+	unsigned long missed;
+	u64 ramp_total_us;
+	u64 ramp_max_us;
+} stats[NR_CPUS];
+
+static unsigned long transitions;
+static u64 last_account_us;
+static u64 burst_min_us = 50000;
+
+static int freq_index(unsigned int freq)
+{
+	int i;
+
+	for (i = 0; i < nr_freqs; i++)
+		if (power[i].freq == freq)
+			return i;
+	return -1;
+}
+
+/* Charge the time since the last call to each cpu's state and speed */
+void sim_account(void)
+{
+	u64 delta = sim_now_us - last_account_us;
+	int cpu;
+
+	if (!delta)
+		return;
+
+	for (cpu = 0; cpu < sim_nr_cpus; cpu++) {
+		struct cpufreq_policy *policy = sim_cpu_policy[cpu];
+		int i = freq_index(policy->cur);
+
+		if (i < 0)
+			continue;
+
+		stats[cpu].residency_us[i] += delta;
+		if (sim_get_cpu_state(cpu) == SIM_CPU_BUSY) {
+			stats[cpu].busy_us += delta;
+			stats[cpu].busy_khz_us += delta * policy->cur;
+			stats[cpu].energy_uj += delta * power[i].busy_mw / 1000;
+		} else {
+			stats[cpu].energy_uj += delta * power[i].idle_mw / 1000;
+		}
+	}
+	last_account_us = sim_now_us;
+}
+
+void sim_freq_changed(struct cpufreq_policy *policy, unsigned int old_freq,
+		      unsigned int new_freq)
+{
+	unsigned int cpu;
+
+	transitions++;
+	if (sim_verbose)
+		fprintf(stderr, "%llu: cpu%u %u -> %u kHz\n",
+			(unsigned long long)sim_now_us, policy->cpu,
+			old_freq, new_freq);
+
+	if (new_freq < policy->max)
+		return;
+
+	for_each_cpu(cpu, policy->cpus) {
+		if (stats[cpu].in_burst && !stats[cpu].reached_max) {
+			stats[cpu].reached_max = 1;
+			stats[cpu].ramp_us = sim_now_us - stats[cpu].burst_start;
+		}
+	}
+}
+
+static void burst_begin(int cpu)
+{
+	stats[cpu].in_burst = 1;
+	stats[cpu].burst_start = sim_now_us;
+	stats[cpu].ramp_us = 0;
+	stats[cpu].reached_max = sim_cpu_policy[cpu]->cur >=
+				 sim_cpu_policy[cpu]->max;
+}
+
+static void burst_end(int cpu)
+{
+	if (!stats[cpu].in_burst)
+		return;
+	stats[cpu].in_burst = 0;
+
+	if (sim_now_us - stats[cpu].burst_start < burst_min_us)
+		return;
+
+	stats[cpu].bursts++;
+	if (!stats[cpu].reached_max) {
+		stats[cpu].missed++;
+		return;
+	}
+	stats[cpu].ramp_total_us += stats[cpu].ramp_us;
+	if (stats[cpu].ramp_us > stats[cpu].ramp_max_us)
+		stats[cpu].ramp_max_us = stats[cpu].ramp_us;
+}
+
+static void set_state(int cpu, enum sim_cpu_state state)
+{
+	enum sim_cpu_state old = sim_get_cpu_state(cpu);
+
+	if (state == old)
+		return;
+
+	/* idle entry and exit look like they do from cpu_idle() */
+	if (old == SIM_CPU_BUSY) {
+		burst_end(cpu);
+		sim_set_cpu_state(cpu, state);
+		sim_idle_notify(cpu, IDLE_START);
+	} else if (state == SIM_CPU_BUSY) {
+		sim_idle_notify(cpu, IDLE_END);
+		sim_set_cpu_state(cpu, state);
+		burst_begin(cpu);
+		/* the wakeup runs deferrable timers that expired while idle */
+		sim_run_timers();
+	} else {
+		sim_set_cpu_state(cpu, state);
+	}
+	sim_run_work();
+}
+
+/* Advance the clock to @us, running each tick on the way */
+static void advance(u64 us)
+{
+	static const u64 tick_us = USEC_PER_SEC / HZ;
+	u64 next_tick = (u64)(jiffies + 1) * tick_us;
+
+	while (next_tick <= us) {
+		sim_now_us = next_tick;
+		sim_account();
+		jiffies++;
+		sim_run_timers();
+		sim_run_work();
+		next_tick += tick_us;
+	}
+	sim_now_us = us;
+	sim_account();
+}
+
+static char *skip_comment(char *line)
+{
+	char *p = strchr(line, '#');
+
+	if (p)
+		*p = '\0';
+	while (isspace((unsigned char)*line))
+		line++;
+	return line;
+}
+
+static void die(const char *fmt, ...)
+{
+	va_list ap;
+
+	va_start(ap, fmt);
+	vfprintf(stderr, fmt, ap);
+	va_end(ap);
+	exit(1);
+}
+
+static int cmp_power(const void *a, const void *b)
+{
+	const struct power_entry *pa = a, *pb = b;
+
+	return pa->freq < pb->freq ? -1 : pa->freq > pb->freq;
+}
+
+static void load_power(const char *path)
+{
+	char buf[256], *line;
+	FILE *f = fopen(path, "r");
+	int lineno = 0;
+	int i;
+
+	if (!f)
+		die("%s: %s\n", path, strerror(errno));
+
+	while (fgets(buf, sizeof(buf), f)) {
+		lineno++;
+		line = skip_comment(buf);
+		if (!*line)
+			continue;
+		if (nr_freqs == MAX_FREQS)
+			die("%s:%d: more than %d frequencies\n", path, lineno,
+			    MAX_FREQS);
+		if (sscanf(line, "%u %lf %lf", &power[nr_freqs].freq,
+			   &power[nr_freqs].busy_mw,
+			   &power[nr_freqs].idle_mw) != 3)
+			die("%s:%d: expected <freq_khz> <busy_mW> <idle_mW>\n",
+			    path, lineno);
+		nr_freqs++;
+	}
+	fclose(f);
+
+	if (!nr_freqs)
+		die("%s: no frequencies\n", path);
+
+	qsort(power, nr_freqs, sizeof(power[0]), cmp_power);
+	for (i = 0; i < nr_freqs; i++) {
+		freq_table[i].index = i;
+		freq_table[i].frequency = power[i].freq;
+	}
+	freq_table[i].index = i;
+	freq_table[i].frequency = CPUFREQ_TABLE_END;
+	sim_freq_table = freq_table;
+}
+
+static void setup_policies(int separate, unsigned int start_freq)
+{
+	int cpu;
+
+	nr_policies = separate ? sim_nr_cpus : 1;
+	for (cpu = 0; cpu < nr_policies; cpu++) {
+		struct cpufreq_policy *policy = &policies[cpu];
+
+		policy->cpu = cpu;
+		policy->cpuinfo.min_freq = power[0].freq;
+		policy->cpuinfo.max_freq = power[nr_freqs - 1].freq;
+		policy->cpuinfo.transition_latency = 100000;
+		policy->min = policy->cpuinfo.min_freq;
+		policy->max = policy->cpuinfo.max_freq;
+		policy->cur = start_freq ? start_freq : policy->min;
+		policy->shared_type = separate ? CPUFREQ_SHARED_TYPE_NONE :
+						 CPUFREQ_SHARED_TYPE_ANY;
+	}
+
+	for (cpu = 0; cpu < sim_nr_cpus; cpu++) {
+		struct cpufreq_policy *policy = &policies[separate ? cpu : 0];
+
+		cpumask_set_cpu(cpu, policy->cpus);
+		cpumask_set_cpu(cpu, policy->related_cpus);
+		sim_cpu_policy[cpu] = policy;
+	}
+}
+
+static void governor_event(struct cpufreq_governor *gov, unsigned int event)
+{
+	int i, ret;
+
+	for (i = 0; i < nr_policies; i++) {
+		sim_current_cpu = policies[i].cpu;
+		ret = gov->governor(&policies[i], event);
+		if (ret)
+			die("%s: governor event %u failed: %d\n", gov->name,
+			    event, ret);
+		sim_run_work();
+	}
+	sim_current_cpu = 0;
+}
+
+static u64 replay(const char *path)
+{
+	char buf[256], *line;
+	FILE *f = strcmp(path, "-") ? fopen(path, "r") : stdin;
+	unsigned long long t;
+	u64 now = 0;
+	int lineno = 0;
+	char state[16];
+	int cpu;
+
+	if (!f)
+		die("%s: %s\n", path, strerror(errno));
+
+	while (fgets(buf, sizeof(buf), f)) {
+		lineno++;
+		line = skip_comment(buf);
+		if (!*line)
+			continue;
+		if (sscanf(line, "%llu %d %15s", &t, &cpu, state) != 3)
+			die("%s:%d: expected <time_us> <cpu> <state>\n",
+			    path, lineno);
+		if (t < now)
+			die("%s:%d: time goes backwards\n", path, lineno);
+		if (cpu < 0 || cpu >= sim_nr_cpus)
+			die("%s:%d: cpu %d out of range (-n %d)\n", path,
+			    lineno, cpu, sim_nr_cpus);
+
+		advance(t);
+		now = t;
+
+		if (!strcmp(state, "busy"))
+			set_state(cpu, SIM_CPU_BUSY);
+		else if (!strcmp(state, "idle"))
+			set_state(cpu, SIM_CPU_IDLE);
+		else if (!strcmp(state, "iowait"))
+			set_state(cpu, SIM_CPU_IOWAIT);
+		else
+			die("%s:%d: unknown state '%s'\n", path, lineno, state);
+	}
+	if (f != stdin)
+		fclose(f);
+
+	for (cpu = 0; cpu < sim_nr_cpus; cpu++)
+		burst_end(cpu);
+	return now;
+}
+
+static void report(struct cpufreq_governor *gov, u64 total_us)
+{
+	double energy_uj = 0;
+	u64 busy_us = 0, busy_khz_us = 0, ramp_total_us = 0, ramp_max_us = 0;
+	unsigned long bursts = 0, missed = 0;
+	int i, cpu;
+
+	printf("governor: %s\n", gov->name);
+	printf("duration: %llu us, %d cpu(s), %d policy(ies), HZ=%d\n",
+	       (unsigned long long)total_us, sim_nr_cpus, nr_policies, HZ);
+	if (sim_verbose) {
+		printf("tunables:\n");
+		sim_show_tunables(stdout);
+	}
+
+	printf("\nresidency (%% of time):\n%10s", "kHz");
+	for (i = 0; i < nr_policies; i++)
+		printf("   policy%d", policies[i].cpu);
+	printf("\n");
+	for (i = 0; i < nr_freqs; i++) {
+		printf("%10u", power[i].freq);
+		for (cpu = 0; cpu < nr_policies; cpu++) {
+			u64 us = stats[policies[cpu].cpu].residency_us[i];
+
+			printf("  %8.2f", total_us ? 100.0 * us / total_us : 0);
+		}
+		printf("\n");
+	}
+
+	for (cpu = 0; cpu < sim_nr_cpus; cpu++) {
+		energy_uj += stats[cpu].energy_uj;
+		busy_us += stats[cpu].busy_us;
+		busy_khz_us += stats[cpu].busy_khz_us;
+		bursts += stats[cpu].bursts;
+		missed += stats[cpu].missed;
+		ramp_total_us += stats[cpu].ramp_total_us;
+		if (stats[cpu].ramp_max_us > ramp_max_us)
+			ramp_max_us = stats[cpu].ramp_max_us;
+	}
+
+	printf("\ntransitions: %lu\n", transitions);
+	printf("ramp to max: %lu burst(s) >= %llu us", bursts,
+	       (unsigned long long)burst_min_us);
+	if (bursts > missed)
+		printf(", mean %llu us, max %llu us",
+		       (unsigned long long)(ramp_total_us / (bursts - missed)),
+		       (unsigned long long)ramp_max_us);
+	printf(", %lu never reached max\n", missed);
+	printf("busy speed: %llu kHz average while busy\n",
+	       (unsigned long long)(busy_us ? busy_khz_us / busy_us : 0));
+	printf("energy: %.1f mJ, %.1f mW average\n", energy_uj / 1000,
+	       total_us ? energy_uj / total_us * 1000 : 0);
+}
+
+static void usage(const char *prog)
+{
+	fprintf(stderr,
+		"usage: %s -g governor -p power_table [options] [trace|-]\n"
+		"  -g name        governor to run\n"
+		"  -p file        power table: <freq_khz> <busy_mW> <idle_mW>\n"
+		"  -n cpus        number of cpus in the trace (default 1)\n"
+		"  -s             one policy per cpu instead of one shared\n"
+		"  -f freq        starting frequency (default lowest)\n"
+		"  -t name=value  set a governor tunable after it starts\n"
+		"  -b us          shortest burst counted for ramp latency "
+		"(default 50000)\n"
+		"  -l             list the governors built in\n"
+		"  -v             trace frequency changes and governor output\n",
+		prog);
+	exit(2);
+}
+
+int main(int argc, char **argv)
+{
+	const char *gov_name = NULL, *power_path = NULL, *trace_path = "-";
+	char *tunables[64];
+	int nr_tunables = 0;
+	unsigned int start_freq = 0;
+	struct cpufreq_governor *gov;
+	int separate = 0;
+	u64 total_us;
+	int opt, i;
+
+	sim_init_governors();
+
+	while ((opt = getopt(argc, argv, "g:p:n:sf:t:b:lv")) != -1) {
+		switch (opt) {
+		case 'g':
+			gov_name = optarg;
+			break;
+		case 'p':
+			power_path = optarg;
+			break;
+		case 'n':
+			sim_nr_cpus = atoi(optarg);
+			if (sim_nr_cpus < 1 || sim_nr_cpus > NR_CPUS)
+				die("-n: 1 to %d cpus\n", NR_CPUS);
+			break;
+		case 's':
+			separate = 1;
+			break;
+		case 'f':
+			start_freq = strtoul(optarg, NULL, 0);
+			break;
+		case 't':
+			if (nr_tunables == ARRAY_SIZE(tunables))
+				die("too many tunables\n");
+			tunables[nr_tunables++] = optarg;
+			break;
+		case 'b':
+			burst_min_us = strtoull(optarg, NULL, 0);
+			break;
+		case 'l':
+			sim_list_governors(stdout);
+			return 0;
+		case 'v':
+			sim_verbose = 1;
+			break;
+		default:
+			usage(argv[0]);
+		}
+	}
+	if (optind < argc)
+		trace_path = argv[optind++];
+	if (!gov_name || !power_path || optind != argc)
+		usage(argv[0]);
+
+	gov = sim_find_governor(gov_name);
+	if (!gov)
+		die("no governor '%s' (try -l)\n", gov_name);
+
+	load_power(power_path);
+	if (start_freq && freq_index(start_freq) < 0)
+		die("-f: %u kHz is not in the power table\n", start_freq);
+	setup_policies(separate, start_freq);
+
+	for (i = 0; i < nr_policies; i++)
+		policies[i].governor = gov;
+	governor_event(gov, CPUFREQ_GOV_START);
+
+	for (i = 0; i < nr_tunables; i++) {
+		char *value = strchr(tunables[i], '=');
+		int ret;
+
+		if (!value)
+			die("-t %s: expected name=value\n", tunables[i]);
+		*value++ = '\0';
+		ret = sim_set_tunable(tunables[i], value);
+		if (ret == -ENOENT)
+			die("-t %s: no such tunable in %s\n", tunables[i],
+			    gov->name);
+		if (ret)
+			die("-t %s=%s: %s\n", tunables[i], value,
+			    strerror(-ret));
+	}
+
+	total_us = replay(trace_path);
+	report(gov, total_us);
+
+	governor_event(gov, CPUFREQ_GOV_STOP);
+	return 0;
+}
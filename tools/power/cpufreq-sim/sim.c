@@ -0,0 +1,744 @@
+/*
+ * cpufreq-sim: a mock of the kernel runtime seen by cpufreq governors.
+ *
+ * Time is virtual: jiffies and the microsecond clock only move when the
+ * trace replay in main.c advances them.  Timers fire from the replay's
+ * tick, work items run as soon as the current event has been handled,
+ * and kernel threads run in their own pthreads, but only one context
+ * ever runs at a time, handing a baton back and forth, so the governors
+ * see no real concurrency and runs are deterministic.
+ *
+ * Licensed under the terms of the GNU GPL License version 2.
+ */
+
+#include <pthread.h>
+#include <stdarg.h>
+
+#include "sim.h"
+
+int sim_verbose;
+int sim_nr_cpus = 1;
+int sim_current_cpu;
+
+volatile unsigned long jiffies;
+u64 sim_now_us;
+
+struct kernel_stat sim_kstat[NR_CPUS];
+
+struct cpufreq_policy *sim_cpu_policy[NR_CPUS];
+struct cpufreq_frequency_table *sim_freq_table;
+
+static struct kobject sim_global_kobject = { .name = "cpufreq" };
+struct kobject *cpufreq_global_kobject = &sim_global_kobject;
+
+/* cpu idle accounting */
+
+static struct {
+	enum sim_cpu_state state;
+	u64 since;		/* when state was entered */
+	u64 idle_us;		/* idle and iowait time before since */
+	u64 iowait_us;		/* iowait time before since */
+} sim_cpu[NR_CPUS];
+
+void sim_set_cpu_state(int cpu, enum sim_cpu_state state)
+{
+	u64 delta = sim_now_us - sim_cpu[cpu].since;
+
+	if (sim_cpu[cpu].state != SIM_CPU_BUSY)
+		sim_cpu[cpu].idle_us += delta;
+	if (sim_cpu[cpu].state == SIM_CPU_IOWAIT)
+		sim_cpu[cpu].iowait_us += delta;
+	sim_cpu[cpu].state = state;
+	sim_cpu[cpu].since = sim_now_us;
+}
+
+enum sim_cpu_state sim_get_cpu_state(int cpu)
+{
+	return sim_cpu[cpu].state;
+}
+
+/* Like the kernel, iowait time is also counted as idle time */
+u64 get_cpu_idle_time_us(int cpu, u64 *last_update_time)
+{
+	u64 idle = sim_cpu[cpu].idle_us;
+
+	if (sim_cpu[cpu].state != SIM_CPU_BUSY)
+		idle += sim_now_us - sim_cpu[cpu].since;
+	if (last_update_time)
+		*last_update_time = sim_now_us;
+	return idle;
+}
+
+u64 get_cpu_iowait_time_us(int cpu, u64 *last_update_time)
+{
+	u64 iowait = sim_cpu[cpu].iowait_us;
+
+	if (sim_cpu[cpu].state == SIM_CPU_IOWAIT)
+		iowait += sim_now_us - sim_cpu[cpu].since;
+	if (last_update_time)
+		*last_update_time = sim_now_us;
+	return iowait;
+}
+
+unsigned long nr_running(void)
+{
+	unsigned long nr = 0;
+	int cpu;
+
+	for (cpu = 0; cpu < sim_nr_cpus; cpu++)
+		nr += sim_cpu[cpu].state == SIM_CPU_BUSY;
+	return nr;
+}
+
+unsigned long nr_iowait(void)
+{
+	unsigned long nr = 0;
+	int cpu;
+
+	for (cpu = 0; cpu < sim_nr_cpus; cpu++)
+		nr += sim_cpu[cpu].state == SIM_CPU_IOWAIT;
+	return nr;
+}
+
+/* timers */
+
+static struct timer_list *sim_timers;
+
+void init_timer(struct timer_list *timer)
+{
+	timer->pending = 0;
+	timer->deferrable = 0;
+	timer->cpu = -1;
+	timer->next = NULL;
+}
+
+void init_timer_deferrable(struct timer_list *timer)
+{
+	init_timer(timer);
+	timer->deferrable = 1;
+}
+
+int del_timer(struct timer_list *timer)
+{
+	struct timer_list **p;
+
+	for (p = &sim_timers; *p; p = &(*p)->next) {
+		if (*p == timer) {
+			*p = timer->next;
+			timer->pending = 0;
+			return 1;
+		}
+	}
+	return 0;
+}
+
+void add_timer_on(struct timer_list *timer, int cpu)
+{
+	del_timer(timer);
+	timer->cpu = cpu;
+	timer->pending = 1;
+	timer->next = sim_timers;
+	sim_timers = timer;
+}
+
+void add_timer(struct timer_list *timer)
+{
+	add_timer_on(timer, sim_current_cpu);
+}
+
+int mod_timer(struct timer_list *timer, unsigned long expires)
+{
+	int was_pending = timer->pending;
+
+	timer->expires = expires;
+	add_timer_on(timer, sim_current_cpu);
+	return was_pending;
+}
+
+/*
+ * Run the expired timers.  As with NOHZ, a deferrable timer does not
+ * wake an idle cpu: it runs at the first tick after the cpu goes busy.
+ */
+void sim_run_timers(void)
+{
+	struct timer_list **p, *timer;
+	int saved_cpu = sim_current_cpu;
+
+restart:
+	for (p = &sim_timers; (timer = *p); p = &timer->next) {
+		if (!time_after_eq(jiffies, timer->expires))
+			continue;
+		if (timer->deferrable &&
+		    sim_cpu[timer->cpu].state != SIM_CPU_BUSY)
+			continue;
+
+		*p = timer->next;
+		timer->pending = 0;
+		sim_current_cpu = timer->cpu;
+		timer->function(timer->data);
+		sim_run_work();
+		goto restart;
+	}
+	sim_current_cpu = saved_cpu;
+}
+
+/* workqueues */
+
+static struct work_struct *sim_work_head, **sim_work_tail = &sim_work_head;
+
+struct workqueue_struct *alloc_workqueue(const char *name, unsigned int flags,
+					 int max_active)
+{
+	struct workqueue_struct *wq = calloc(1, sizeof(*wq));
+
+	if (wq)
+		wq->name = name;
+	return wq;
+}
+
+void destroy_workqueue(struct workqueue_struct *wq)
+{
+	free(wq);
+}
+
+int queue_work(struct workqueue_struct *wq, struct work_struct *work)
+{
+	if (work->pending)
+		return 0;
+	work->pending = 1;
+	work->cpu = sim_current_cpu;
+	work->next = NULL;
+	*sim_work_tail = work;
+	sim_work_tail = &work->next;
+	return 1;
+}
+
+static void sim_dequeue_work(struct work_struct *work)
+{
+	struct work_struct **p;
+
+	for (p = &sim_work_head; *p; p = &(*p)->next) {
+		if (*p == work) {
+			*p = work->next;
+			if (!*p)
+				sim_work_tail = p;
+			break;
+		}
+	}
+	work->pending = 0;
+}
+
+int cancel_work_sync(struct work_struct *work)
+{
+	int was_pending = work->pending;
+
+	if (was_pending)
+		sim_dequeue_work(work);
+	return was_pending;
+}
+
+void sim_run_work(void)
+{
+	struct work_struct *work;
+	int saved_cpu = sim_current_cpu;
+
+	while ((work = sim_work_head)) {
+		sim_work_head = work->next;
+		if (!sim_work_head)
+			sim_work_tail = &sim_work_head;
+		work->pending = 0;
+		sim_current_cpu = work->cpu;
+		work->func(work);
+	}
+	sim_current_cpu = saved_cpu;
+}
+
+static void sim_delayed_work_timer(unsigned long data)
+{
+	struct delayed_work *dw = (struct delayed_work *)data;
+
+	dw->work.pending = 0;
+	queue_work(NULL, &dw->work);
+}
+
+void __init_delayed_work(struct delayed_work *dw, work_func_t f, int defer)
+{
+	INIT_WORK(&dw->work, f);
+	if (defer)
+		init_timer_deferrable(&dw->timer);
+	else
+		init_timer(&dw->timer);
+	dw->timer.function = sim_delayed_work_timer;
+	dw->timer.data = (unsigned long)dw;
+}
+
+int queue_delayed_work_on(int cpu, struct workqueue_struct *wq,
+			  struct delayed_work *dw, unsigned long delay)
+{
+	if (dw->work.pending)
+		return 0;
+	if (!delay) {
+		int saved_cpu = sim_current_cpu;
+
+		sim_current_cpu = cpu;
+		queue_work(wq, &dw->work);
+		sim_current_cpu = saved_cpu;
+		return 1;
+	}
+	dw->work.pending = 1;
+	dw->timer.expires = jiffies + delay;
+	add_timer_on(&dw->timer, cpu);
+	return 1;
+}
+
+int cancel_delayed_work_sync(struct delayed_work *dw)
+{
+	int ret = del_timer(&dw->timer);
+
+	ret |= cancel_work_sync(&dw->work);
+	dw->work.pending = 0;
+	return ret;
+}
+
+/* kernel threads */
+
+static struct task_struct sim_main_task = {
+	.comm = "sim", .state = TASK_RUNNING, .started = 1, .running = 1,
+};
+__thread struct task_struct *sim_current_task = &sim_main_task;
+
+static pthread_mutex_t sim_baton_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t sim_baton_cond = PTHREAD_COND_INITIALIZER;
+static struct task_struct *sim_baton = &sim_main_task;
+
+struct sim_thread {
+	pthread_t pthread;
+	struct task_struct *waker;
+	int exited;
+};
+
+/* Hand the baton to @next and wait until it comes back to @prev */
+static void sim_switch(struct task_struct *prev, struct task_struct *next)
+{
+	pthread_mutex_lock(&sim_baton_lock);
+	sim_baton = next;
+	pthread_cond_broadcast(&sim_baton_cond);
+	while (sim_baton != prev)
+		pthread_cond_wait(&sim_baton_cond, &sim_baton_lock);
+	pthread_mutex_unlock(&sim_baton_lock);
+}
+
+static void *sim_thread_fn(void *arg)
+{
+	struct task_struct *tsk = arg;
+	struct sim_thread *st = tsk->thread;
+
+	pthread_mutex_lock(&sim_baton_lock);
+	while (sim_baton != tsk)
+		pthread_cond_wait(&sim_baton_cond, &sim_baton_lock);
+	pthread_mutex_unlock(&sim_baton_lock);
+
+	sim_current_task = tsk;
+	tsk->threadfn(tsk->data);
+
+	st->exited = 1;
+	pthread_mutex_lock(&sim_baton_lock);
+	sim_baton = st->waker;
+	pthread_cond_broadcast(&sim_baton_cond);
+	pthread_mutex_unlock(&sim_baton_lock);
+	return NULL;
+}
+
+struct task_struct *kthread_create(int (*threadfn)(void *data), void *data,
+				   const char *namefmt, ...)
+{
+	struct task_struct *tsk = calloc(1, sizeof(*tsk));
+	struct sim_thread *st = calloc(1, sizeof(*st));
+
+	if (!tsk || !st) {
+		free(tsk);
+		free(st);
+		return ERR_PTR(-ENOMEM);
+	}
+	tsk->comm = namefmt;
+	tsk->state = TASK_UNINTERRUPTIBLE;
+	tsk->threadfn = threadfn;
+	tsk->data = data;
+	tsk->thread = st;
+	return tsk;
+}
+
+int wake_up_process(struct task_struct *tsk)
+{
+	struct sim_thread *st = tsk->thread;
+
+	if (st->exited || tsk == current || tsk->state == TASK_RUNNING)
+		return 0;
+
+	tsk->state = TASK_RUNNING;
+	st->waker = current;
+	if (!tsk->started) {
+		tsk->started = 1;
+		if (pthread_create(&st->pthread, NULL, sim_thread_fn, tsk)) {
+			perror("pthread_create");
+			exit(1);
+		}
+	}
+	sim_switch(current, tsk);
+	return 1;
+}
+
+void schedule(void)
+{
+	struct task_struct *tsk = current;
+
+	if (tsk == &sim_main_task || tsk->state == TASK_RUNNING)
+		return;
+	sim_switch(tsk, ((struct sim_thread *)tsk->thread)->waker);
+}
+
+int kthread_should_stop(void)
+{
+	return current->should_stop;
+}
+
+int kthread_stop(struct task_struct *tsk)
+{
+	struct sim_thread *st = tsk->thread;
+
+	tsk->should_stop = 1;
+	if (!tsk->started)
+		return 0;
+	tsk->state = TASK_INTERRUPTIBLE;
+	wake_up_process(tsk);
+	pthread_join(st->pthread, NULL);
+	return 0;
+}
+
+void kthread_bind(struct task_struct *tsk, unsigned int cpu)
+{
+}
+
+/* notifiers */
+
+static struct notifier_block *sim_idle_chain;
+static struct notifier_block *sim_transition_chain;
+
+static void sim_notifier_add(struct notifier_block **chain,
+			     struct notifier_block *n)
+{
+	n->next = *chain;
+	*chain = n;
+}
+
+static void sim_notifier_del(struct notifier_block **chain,
+			     struct notifier_block *n)
+{
+	for (; *chain; chain = &(*chain)->next) {
+		if (*chain == n) {
+			*chain = n->next;
+			return;
+		}
+	}
+}
+
+static void sim_notifier_call(struct notifier_block *chain, unsigned long val,
+			      void *data)
+{
+	for (; chain; chain = chain->next)
+		chain->notifier_call(chain, val, data);
+}
+
+void idle_notifier_register(struct notifier_block *n)
+{
+	sim_notifier_add(&sim_idle_chain, n);
+}
+
+void idle_notifier_unregister(struct notifier_block *n)
+{
+	sim_notifier_del(&sim_idle_chain, n);
+}
+
+void sim_idle_notify(int cpu, unsigned long val)
+{
+	int saved_cpu = sim_current_cpu;
+
+	sim_current_cpu = cpu;
+	sim_notifier_call(sim_idle_chain, val, NULL);
+	sim_current_cpu = saved_cpu;
+}
+
+int cpufreq_register_notifier(struct notifier_block *nb, unsigned int list)
+{
+	if (list == CPUFREQ_TRANSITION_NOTIFIER)
+		sim_notifier_add(&sim_transition_chain, nb);
+	return 0;
+}
+
+int cpufreq_unregister_notifier(struct notifier_block *nb, unsigned int list)
+{
+	if (list == CPUFREQ_TRANSITION_NOTIFIER)
+		sim_notifier_del(&sim_transition_chain, nb);
+	return 0;
+}
+
+/* sysfs: tunables are set through the governor's own store() */
+
+#define SIM_MAX_GROUPS 8
+static const struct attribute_group *sim_groups[SIM_MAX_GROUPS];
+
+int sysfs_create_group(struct kobject *kobj, const struct attribute_group *grp)
+{
+	int i;
+
+	for (i = 0; i < SIM_MAX_GROUPS; i++) {
+		if (!sim_groups[i]) {
+			sim_groups[i] = grp;
+			return 0;
+		}
+	}
+	return -ENOMEM;
+}
+
+void sysfs_remove_group(struct kobject *kobj, const struct attribute_group *grp)
+{
+	int i;
+
+	for (i = 0; i < SIM_MAX_GROUPS; i++)
+		if (sim_groups[i] == grp)
+			sim_groups[i] = NULL;
+}
+
+static struct global_attr *sim_find_attr(const char *name)
+{
+	struct attribute **attr;
+	int i;
+
+	for (i = 0; i < SIM_MAX_GROUPS; i++) {
+		if (!sim_groups[i])
+			continue;
+		for (attr = sim_groups[i]->attrs; *attr; attr++)
+			if (!strcmp((*attr)->name, name))
+				return container_of(*attr, struct global_attr,
+						    attr);
+	}
+	return NULL;
+}
+
+int sim_set_tunable(const char *name, const char *value)
+{
+	struct global_attr *ga = sim_find_attr(name);
+	ssize_t ret;
+
+	if (!ga || !ga->store)
+		return -ENOENT;
+	ret = ga->store(cpufreq_global_kobject, &ga->attr, value,
+			strlen(value));
+	return ret < 0 ? ret : 0;
+}
+
+void sim_show_tunables(FILE *f)
+{
+	struct attribute **attr;
+	char buf[4096];
+	int i;
+
+	for (i = 0; i < SIM_MAX_GROUPS; i++) {
+		if (!sim_groups[i])
+			continue;
+		for (attr = sim_groups[i]->attrs; *attr; attr++) {
+			struct global_attr *ga =
+				container_of(*attr, struct global_attr, attr);
+
+			if (!ga->show)
+				continue;
+			buf[0] = '\0';
+			ga->show(cpufreq_global_kobject, &ga->attr, buf);
+			fprintf(f, "  %s/%s: %s", sim_groups[i]->name,
+				(*attr)->name, buf);
+		}
+	}
+}
+
+/* cpufreq core and driver */
+
+static struct cpufreq_governor *sim_governors;
+
+int cpufreq_register_governor(struct cpufreq_governor *governor)
+{
+	governor->next = sim_governors;
+	sim_governors = governor;
+	return 0;
+}
+
+void cpufreq_unregister_governor(struct cpufreq_governor *governor)
+{
+	struct cpufreq_governor **p;
+
+	for (p = &sim_governors; *p; p = &(*p)->next) {
+		if (*p == governor) {
+			*p = governor->next;
+			return;
+		}
+	}
+}
+
+struct cpufreq_governor *sim_find_governor(const char *name)
+{
+	struct cpufreq_governor *gov;
+
+	for (gov = sim_governors; gov; gov = gov->next)
+		if (!strcmp(gov->name, name))
+			return gov;
+	return NULL;
+}
+
+void sim_list_governors(FILE *f)
+{
+	struct cpufreq_governor *gov;
+
+	for (gov = sim_governors; gov; gov = gov->next)
+		fprintf(f, "%s\n", gov->name);
+}
+
+extern initcall_t __start_sim_initcall[], __stop_sim_initcall[];
+
+void sim_init_governors(void)
+{
+	initcall_t *fn;
+
+	for (fn = __start_sim_initcall; fn < __stop_sim_initcall; fn++)
+		(*fn)();
+}
+
+struct cpufreq_policy *cpufreq_cpu_get(unsigned int cpu)
+{
+	return cpu < NR_CPUS ? sim_cpu_policy[cpu] : NULL;
+}
+
+unsigned int cpufreq_get(unsigned int cpu)
+{
+	return sim_cpu_policy[cpu] ? sim_cpu_policy[cpu]->cur : 0;
+}
+
+struct cpufreq_frequency_table *cpufreq_frequency_get_table(unsigned int cpu)
+{
+	return sim_freq_table;
+}
+
+/* Same choice as drivers/cpufreq/freq_table.c */
+int cpufreq_frequency_table_target(struct cpufreq_policy *policy,
+				   struct cpufreq_frequency_table *table,
+				   unsigned int target_freq,
+				   unsigned int relation,
+				   unsigned int *index)
+{
+	struct cpufreq_frequency_table optimal = {
+		.index = ~0,
+		.frequency = 0,
+	};
+	struct cpufreq_frequency_table suboptimal = {
+		.index = ~0,
+		.frequency = 0,
+	};
+	unsigned int i;
+
+	switch (relation) {
+	case CPUFREQ_RELATION_H:
+		suboptimal.frequency = ~0;
+		break;
+	case CPUFREQ_RELATION_L:
+		optimal.frequency = ~0;
+		break;
+	}
+
+	for (i = 0; (table[i].frequency != CPUFREQ_TABLE_END); i++) {
+		unsigned int freq = table[i].frequency;
+		if (freq == CPUFREQ_ENTRY_INVALID)
+			continue;
+		if ((freq < policy->min) || (freq > policy->max))
+			continue;
+		switch (relation) {
+		case CPUFREQ_RELATION_H:
+			if (freq <= target_freq) {
+				if (freq >= optimal.frequency) {
+					optimal.frequency = freq;
+					optimal.index = i;
+				}
+			} else {
+				if (freq <= suboptimal.frequency) {
+					suboptimal.frequency = freq;
+					suboptimal.index = i;
+				}
+			}
+			break;
+		case CPUFREQ_RELATION_L:
+			if (freq >= target_freq) {
+				if (freq <= optimal.frequency) {
+					optimal.frequency = freq;
+					optimal.index = i;
+				}
+			} else {
+				if (freq >= suboptimal.frequency) {
+					suboptimal.frequency = freq;
+					suboptimal.index = i;
+				}
+			}
+			break;
+		}
+	}
+	if (optimal.index > i) {
+		if (suboptimal.index > i)
+			return -EINVAL;
+		*index = suboptimal.index;
+	} else
+		*index = optimal.index;
+
+	return 0;
+}
+
+/* The mock driver switches instantly to the chosen table frequency */
+int __cpufreq_driver_target(struct cpufreq_policy *policy,
+			    unsigned int target_freq, unsigned int relation)
+{
+	struct cpufreq_freqs freqs;
+	unsigned int index;
+	unsigned int cpu;
+
+	if (target_freq > policy->max)
+		target_freq = policy->max;
+	if (target_freq < policy->min)
+		target_freq = policy->min;
+
+	if (cpufreq_frequency_table_target(policy, sim_freq_table, target_freq,
+					   relation, &index))
+		return -EINVAL;
+
+	freqs.old = policy->cur;
+	freqs.new = sim_freq_table[index].frequency;
+	freqs.flags = 0;
+	if (freqs.new == freqs.old)
+		return 0;
+
+	for_each_cpu(cpu, policy->cpus) {
+		freqs.cpu = cpu;
+		sim_notifier_call(sim_transition_chain, CPUFREQ_PRECHANGE,
+				  &freqs);
+	}
+
+	sim_account();
+	policy->cur = freqs.new;
+	sim_freq_changed(policy, freqs.old, freqs.new);
+
+	for_each_cpu(cpu, policy->cpus) {
+		freqs.cpu = cpu;
+		sim_notifier_call(sim_transition_chain, CPUFREQ_POSTCHANGE,
+				  &freqs);
+	}
+	return 0;
+}
+
+int __cpufreq_driver_getavg(struct cpufreq_policy *policy, unsigned int cpu)
+{
+	return 0;
+}
@@ -0,0 +1,41 @@
+/*
+ * cpufreq-sim: interface between the mock kernel runtime (sim.c) and the
+ * trace replay driver (main.c).
+ *
+ * Licensed under the terms of the GNU GPL License version 2.
+ */
+
+#ifndef CPUFREQ_SIM_H
+#define CPUFREQ_SIM_H
+
+#include <linux/cpufreq.h>
+
+enum sim_cpu_state {
+	SIM_CPU_IDLE,
+	SIM_CPU_IOWAIT,
+	SIM_CPU_BUSY,
+};
+
+/* runtime, sim.c */
+extern struct cpufreq_policy *sim_cpu_policy[NR_CPUS];
+extern struct cpufreq_frequency_table *sim_freq_table;
+
+void sim_init_governors(void);
+struct cpufreq_governor *sim_find_governor(const char *name);
+void sim_list_governors(FILE *f);
+
+int sim_set_tunable(const char *name, const char *value);
+void sim_show_tunables(FILE *f);
+
+void sim_set_cpu_state(int cpu, enum sim_cpu_state state);
+enum sim_cpu_state sim_get_cpu_state(int cpu);
+void sim_run_timers(void);
+void sim_run_work(void);
+void sim_idle_notify(int cpu, unsigned long val);
+
+/* hooks called by the runtime, main.c */
+void sim_account(void);
+void sim_freq_changed(struct cpufreq_policy *policy, unsigned int old_freq,
+		      unsigned int new_freq);
+
+#endif /* CPUFREQ_SIM_H */
@@ -0,0 +1,178 @@
+/*
+ * getdents-stat-bench.c -- compare readdir() + lstat() with getdents_stat()
+ *
+ * Fills a directory with files if asked to, then scans it repeatedly
+ * both ways and prints the time per pass and per entry, e.g.
+ *
+ *	./getdents-stat-bench -c 100000 /data/bench
+ *	./getdents-stat-bench -r 5 /tmp/bench
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2.
+ */
+
+/* $(CROSS_COMPILE)cc -Wall -Wextra -O2 -o getdents-stat-bench getdents-stat-bench.c */
+
+#define _GNU_SOURCE
+#include <dirent.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+
+#include "../../../include/linux/dirent_stat.h"
+
+#ifndef __NR_getdents_stat
+# if defined(__arm__) && defined(__ARM_EABI__)
+#  define __NR_getdents_stat	376
+# else
+#  error "getdents_stat is not wired up for this architecture"
+# endif
+#endif
+
+#define BUF_SIZE	(64 * 1024)
+
+static double now(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static void die(const char *what)
+{
+	perror(what);
+	exit(1);
+}
+
+static void create_files(const char *dir, long count)
+{
+	char name[32];
+	long i;
+	int dfd, fd;
+
+	mkdir(dir, 0755);
+	dfd = open(dir, O_RDONLY | O_DIRECTORY);
+	if (dfd < 0)
+		die(dir);
+	for (i = 0; i < count; i++) {
+		snprintf(name, sizeof(name), "file-%08ld", i);
+		fd = openat(dfd, name, O_CREAT | O_WRONLY, 0644);
+		if (fd < 0)
+			die(name);
+		close(fd);
+	}
+	close(dfd);
+}
+
+/* the usual way: readdir, then one lstat per entry */
+static long scan_readdir(const char *dir, unsigned long long *bytes)
+{
+	struct dirent *de;
+	struct stat st;
+	long n = 0;
+	DIR *d;
+
+	d = opendir(dir);
+	if (!d)
+		die(dir);
+	while ((de = readdir(d))) {
+		if (fstatat(dirfd(d), de->d_name, &st,
+			    AT_SYMLINK_NOFOLLOW) < 0)
+			die(de->d_name);
+		*bytes += st.st_size;
+		n++;
+	}
+	closedir(d);
+	return n;
+}
+
+static long scan_getdents_stat(const char *dir, unsigned long long *bytes)
+{
+	static char buf[BUF_SIZE];
+	struct linux_dirent_stat *de;
+	long n = 0, len, pos;
+	int fd;
+
+	fd = open(dir, O_RDONLY | O_DIRECTORY);
+	if (fd < 0)
+		die(dir);
+	while ((len = syscall(__NR_getdents_stat, fd, buf, sizeof(buf), 0))) {
+		if (len < 0)
+			die("getdents_stat");
+		for (pos = 0; pos < len; pos += de->d_reclen) {
+			de = (struct linux_dirent_stat *)(buf + pos);
+			if (de->d_stat_err) {
+				errno = -de->d_stat_err;
+				die(de->d_name);
+			}
+			*bytes += de->d_stat.st_size;
+			n++;
+		}
+	}
+	close(fd);
+	return n;
+}
+
+static void run(const char *label, const char *dir, int rounds,
+		long (*scan)(const char *, unsigned long long *))
+{
+	unsigned long long bytes = 0;
+	double t, best = 0;
+	long n = 0;
+	int i;
+
+	for (i = 0; i < rounds; i++) {
+		t = now();
+		n = scan(dir, &bytes);
+		t = now() - t;
+		if (!i || t < best)
+			best = t;
+	}
+	printf("%-16s %8ld entries  best %9.3f ms  %7.0f ns/entry\n",
+	       label, n, best * 1e3, n ? best * 1e9 / n : 0.0);
+}
+
+static void usage(const char *prog)
+{
+	fprintf(stderr, "usage: %s [-c count] [-r rounds] dir\n"
+		"  -c count   create count empty files in dir first\n"
+		"  -r rounds  passes of each scan, the best is shown (3)\n",
+		prog);
+	exit(2);
+}
+
+int main(int argc, char **argv)
+{
+	long create = 0;
+	int rounds = 3;
+	int opt;
+
+	while ((opt = getopt(argc, argv, "c:r:")) != -1) {
+		switch (opt) {
+		case 'c':
+			create = atol(optarg);
+			break;
+		case 'r':
+			rounds = atoi(optarg);
+			break;
+		default:
+			usage(argv[0]);
+		}
+	}
+	if (optind != argc - 1 || rounds < 1)
+		usage(argv[0]);
+
+	if (create)
+		create_files(argv[optind], create);
+
+	run("readdir+lstat", argv[optind], rounds, scan_readdir);
+	run("getdents_stat", argv[optind], rounds, scan_getdents_stat);
+	return 0;
+}
@@ -0,0 +1,284 @@
+/*
+ * tracedump-ram: decode a persistent RAM trace dump
+ *
+ * Reads a copy of /proc/last_tracedump, as written by the kernel's
+ * tracedump on panic (CONFIG_TRACEDUMP_RAM), and writes the raw ring
+ * buffer pages back out.  By default the output is the uncompressed form
+ * of a raw /proc/tracedump read: the pages of each CPU followed by
+ * "CPU_END", then the saved cmdlines.  With -d, each CPU's pages go to
+ * <dir>/cpuN and the cmdlines to <dir>/cmdlines instead.
+ *
+ * The dump is read in the byte order of the machine that wrote it; that
+ * must be the byte order of this one.
+ *
+ * Licensed under the terms of the GNU GPL License version 2.
+ */
+
+#include <errno.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+/* From include/linux/tracedump.h */
+#define TD_RAM_SIG		0x4d524454	/* TDRM */
+#define TD_RAM_VERSION		1
+
+#define TD_RAM_REC_PAGE		1
+#define TD_RAM_REC_CMDLINES	2
+
+struct tracedump_ram_header {
+	uint32_t	sig;
+	uint32_t	version;
+	uint32_t	size;
+	uint32_t	head;
+	uint32_t	tail;
+	uint32_t	wrap;
+	uint32_t	count;
+	uint32_t	page_size;
+};
+
+struct tracedump_ram_record {
+	uint16_t	type;
+	uint16_t	cpu;
+	uint32_t	len;
+	uint32_t	clen;
+};
+
+#define MAX_CPUS	64
+#define ALIGN4(x)	(((x) + 3) & ~3u)
+
+static const char cpu_delim[7] = { 'C', 'P', 'U', '_', 'E', 'N', 'D' };
+
+static const char *prog;
+static int verbose;
+
+/* Pages of one CPU, or the cmdlines, collected in record order. */
+struct stream {
+	unsigned char *buf;
+	size_t len;
+	size_t alloc;
+	unsigned int records;
+};
+
+static struct stream cpus[MAX_CPUS];
+static struct stream cmdlines;
+static int max_cpu = -1;
+
+static void die(const char *msg)
+{
+	fprintf(stderr, "%s: %s\n", prog, msg);
+	exit(1);
+}
+
+static unsigned char *stream_reserve(struct stream *s, size_t len)
+{
+	if (s->len + len > s->alloc) {
+		s->alloc = 2 * (s->len + len);
+		s->buf = realloc(s->buf, s->alloc);
+		if (!s->buf)
+			die("out of memory");
+	}
+	return s->buf + s->len;
+}
+
+/*
+ * LZ4 block decoder.  Returns the decoded length, or -1 if the block
+ * is malformed or does not decode to exactly @dst_len bytes.
+ */
+static long lz4_decode(const unsigned char *src, size_t src_len,
+		       unsigned char *dst, size_t dst_len)
+{
+	const unsigned char *ip = src, *ip_end = src + src_len;
+	unsigned char *op = dst, *op_end = dst + dst_len;
+	size_t len, offset;
+
+	while (ip < ip_end) {
+		unsigned int token = *ip++;
+
+		len = token >> 4;
+		if (len == 15) {
+			do {
+				if (ip >= ip_end)
+					return -1;
+				len += *ip;
+			} while (*ip++ == 255);
+		}
+		if ((size_t)(ip_end - ip) < len ||
+		    (size_t)(op_end - op) < len)
+			return -1;
+		memcpy(op, ip, len);
+		op += len;
+		ip += len;
+		if (ip == ip_end)
+			break;
+
+		if (ip_end - ip < 2)
+			return -1;
+		offset = ip[0] | ip[1] << 8;
+		ip += 2;
+		if (!offset || offset > (size_t)(op - dst))
+			return -1;
+
+		len = (token & 15) + 4;
+		if ((token & 15) == 15) {
+			do {
+				if (ip >= ip_end)
+					return -1;
+				len += *ip;
+			} while (*ip++ == 255);
+		}
+		if ((size_t)(op_end - op) < len)
+			return -1;
+		/* byte by byte: the match may overlap its own output */
+		for (; len; len--, op++)
+			*op = *(op - offset);
+	}
+	return op == op_end ? op - dst : -1;
+}
+
+static void decode(const unsigned char *dump, size_t dump_len)
+{
+	const struct tracedump_ram_header *hdr = (const void *)dump;
+	const unsigned char *data = dump + sizeof(*hdr);
+	const struct tracedump_ram_record *rec;
+	struct tracedump_ram_record r;
+	struct stream *s;
+	uint32_t off, i;
+
+	if (dump_len < sizeof(*hdr) || hdr->sig != TD_RAM_SIG)
+		die("not a tracedump RAM image");
+	if (hdr->version != TD_RAM_VERSION)
+		die("unknown tracedump RAM version");
+	if (hdr->size > dump_len - sizeof(*hdr) || hdr->tail >= hdr->size ||
+	    hdr->wrap > hdr->size)
+		die("corrupt header");
+	if (verbose)
+		fprintf(stderr, "%u records in %u bytes, page size %u\n",
+			hdr->count, hdr->size, hdr->page_size);
+
+	for (i = 0, off = hdr->tail; i < hdr->count; i++) {
+		if (off + sizeof(r) > hdr->size)
+			die("record header out of bounds");
+		rec = (const void *)(data + off);
+		memcpy(&r, rec, sizeof(r));
+		if (r.clen > hdr->size - off - sizeof(r))
+			die("record data out of bounds");
+
+		if (r.type == TD_RAM_REC_PAGE) {
+			if (r.cpu >= MAX_CPUS)
+				die("cpu number out of range");
+			s = &cpus[r.cpu];
+			if (r.cpu > max_cpu)
+				max_cpu = r.cpu;
+		} else if (r.type == TD_RAM_REC_CMDLINES) {
+			s = &cmdlines;
+		} else {
+			die("unknown record type");
+		}
+
+		if (lz4_decode((const unsigned char *)(rec + 1), r.clen,
+			       stream_reserve(s, r.len), r.len) < 0)
+			fprintf(stderr, "%s: record %u at %u is corrupt, "
+				"skipped\n", prog, i, off);
+		else {
+			s->len += r.len;
+			s->records++;
+		}
+
+		off += ALIGN4(sizeof(r) + r.clen);
+		if (hdr->wrap && off == hdr->wrap)
+			off = 0;
+	}
+}
+
+static void write_all(FILE *f, const void *buf, size_t len)
+{
+	if (len && fwrite(buf, 1, len, f) != len)
+		die(strerror(errno));
+}
+
+static void write_file(const char *dir, const char *name,
+		       const struct stream *s)
+{
+	char path[4096];
+	FILE *f;
+
+	snprintf(path, sizeof(path), "%s/%s", dir, name);
+	f = fopen(path, "wb");
+	if (!f)
+		die(strerror(errno));
+	write_all(f, s->buf, s->len);
+	if (fclose(f))
+		die(strerror(errno));
+}
+
+static void usage(void)
+{
+	fprintf(stderr, "usage: %s [-v] [-d dir] last_tracedump\n", prog);
+	exit(2);
+}
+
+int main(int argc, char **argv)
+{
+	const char *dir = NULL;
+	unsigned char *dump = NULL;
+	size_t len = 0, n;
+	FILE *f;
+	int opt, cpu;
+
+	prog = argv[0];
+	while ((opt = getopt(argc, argv, "vd:")) != -1) {
+		switch (opt) {
+		case 'v':
+			verbose = 1;
+			break;
+		case 'd':
+			dir = optarg;
+			break;
+		default:
+			usage();
+		}
+	}
+	if (optind != argc - 1)
+		usage();
+
+	/* /proc files have no useful size, so read until EOF */
+	f = fopen(argv[optind], "rb");
+	if (!f)
+		die(strerror(errno));
+	do {
+		dump = realloc(dump, len + 65536);
+		if (!dump)
+			die("out of memory");
+		n = fread(dump + len, 1, 65536, f);
+		len += n;
+	} while (n);
+	fclose(f);
+
+	decode(dump, len);
+
+	for (cpu = 0; cpu <= max_cpu; cpu++) {
+		if (verbose)
+			fprintf(stderr, "cpu%d: %u pages\n", cpu,
+				cpus[cpu].records);
+		if (dir) {
+			char name[16];
+
+			snprintf(name, sizeof(name), "cpu%d", cpu);
+			write_file(dir, name, &cpus[cpu]);
+		} else {
+			write_all(stdout, cpus[cpu].buf, cpus[cpu].len);
+			write_all(stdout, cpu_delim, sizeof(cpu_delim));
+		}
+	}
+	if (dir)
+		write_file(dir, "cmdlines", &cmdlines);
+	else
+		write_all(stdout, cmdlines.buf, cmdlines.len);
+	if (verbose)
+		fprintf(stderr, "cmdlines: %zu bytes\n", cmdlines.len);
+
+	return 0;
+}